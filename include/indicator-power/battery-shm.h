@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_BATTERY_SHM_H__
+#define __INDICATOR_POWER_BATTERY_SHM_H__
+
+/**
+ * indicator-power publishes its device list in a small file in
+ * $XDG_RUNTIME_DIR, for local processes that want the battery state
+ * without D-Bus. This header is all a reader needs: map the segment
+ * once with indicator_power_shm_open(), then indicator_power_shm_read()
+ * as often as you like -- reads don't make any syscalls.
+ *
+ * The segment is a seqlock: the writer makes seq odd while it's
+ * updating and even when it's done, and a reader retries if seq was
+ * odd or changed while it was copying.
+ *
+ * When the service exits or restarts, it sets INDICATOR_POWER_SHM_RETIRED
+ * in the old segment's flags. Readers that see it should close and reopen.
+ *
+ * Needs GCC or clang for the __atomic builtins. In strict ISO C modes,
+ * define _POSIX_C_SOURCE as 200809L or later before including it.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INDICATOR_POWER_SHM_MAGIC       0x50574249u /* "IBWP" */
+#define INDICATOR_POWER_SHM_VERSION     2u
+#define INDICATOR_POWER_SHM_BASENAME    "indicator-power/battery-state"
+#define INDICATOR_POWER_SHM_MAX_DEVICES 16
+#define INDICATOR_POWER_SHM_PATH_LEN    128
+
+/* flags */
+#define INDICATOR_POWER_SHM_RETIRED     (1u<<0)
+
+/* how many times indicator_power_shm_read() tries before giving up */
+#define INDICATOR_POWER_SHM_MAX_TRIES   1000
+
+struct indicator_power_shm_device
+{
+  uint32_t kind;         /* UpDeviceKind */
+  uint32_t state;        /* UpDeviceState */
+  double percentage;
+  int64_t time;          /* seconds until empty or full, or 0 if unknown */
+  uint32_t power_supply;
+  uint32_t reserved;
+  char object_path[INDICATOR_POWER_SHM_PATH_LEN];
+};
+
+/* the state, as copied out by indicator_power_shm_read() */
+struct indicator_power_shm_state
+{
+  uint32_t flags;
+  uint32_t n_devices;
+  int32_t primary;       /* index into devices, or -1 if it isn't one of them */
+  uint32_t has_primary;  /* 1 if primary_device is set */
+  uint64_t generation;   /* incremented on each update */
+  struct indicator_power_shm_device devices[INDICATOR_POWER_SHM_MAX_DEVICES];
+
+  /* the device the indicator shows. With more than one battery,
+     it's their total, which isn't in devices */
+  struct indicator_power_shm_device primary_device;
+};
+
+struct indicator_power_shm
+{
+  /* set once when the segment's created */
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;         /* sizeof(struct indicator_power_shm) */
+  uint32_t seq;
+
+  struct indicator_power_shm_state state;
+};
+
+/* Returns the segment's path in buf, or NULL if XDG_RUNTIME_DIR isn't set */
+static inline const char *
+indicator_power_shm_get_path (char * buf, size_t buflen)
+{
+  const char * dir = getenv ("XDG_RUNTIME_DIR");
+  int n;
+
+  if ((dir == NULL) || (*dir == '\0'))
+    return NULL;
+
+  n = snprintf (buf, buflen, "%s/%s", dir, INDICATOR_POWER_SHM_BASENAME);
+  return (n > 0) && ((size_t)n < buflen) ? buf : NULL;
+}
+
+/* Returns 0 on success, or a negative errno */
+static inline int
+indicator_power_shm_open (const char * path, const struct indicator_power_shm ** setme)
+{
+  const struct indicator_power_shm * shm;
+  struct stat st;
+  void * map;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -errno;
+
+  if ((fstat (fd, &st) < 0) || ((size_t)st.st_size < sizeof (struct indicator_power_shm)))
+    {
+      close (fd);
+      return -EINVAL;
+    }
+
+  map = mmap (NULL, sizeof (struct indicator_power_shm), PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return -errno;
+
+  shm = (const struct indicator_power_shm *) map;
+  if ((shm->magic != INDICATOR_POWER_SHM_MAGIC) ||
+      (shm->version != INDICATOR_POWER_SHM_VERSION) ||
+      (shm->size != sizeof (struct indicator_power_shm)))
+    {
+      munmap (map, sizeof (struct indicator_power_shm));
+      return -EPROTO;
+    }
+
+  *setme = shm;
+  return 0;
+}
+
+static inline void
+indicator_power_shm_close (const struct indicator_power_shm * shm)
+{
+  if (shm != NULL)
+    munmap ((void *) shm, sizeof (struct indicator_power_shm));
+}
+
+/* Copy out a consistent snapshot.
+   Returns 0 on success, or -EAGAIN if the writer kept it busy */
+static inline int
+indicator_power_shm_read (const struct indicator_power_shm * shm,
+                          struct indicator_power_shm_state * setme)
+{
+  int i;
+
+  for (i=0; i<INDICATOR_POWER_SHM_MAX_TRIES; ++i)
+    {
+      const uint32_t begin = __atomic_load_n (&shm->seq, __ATOMIC_ACQUIRE);
+
+      if (begin & 1u) /* mid-update */
+        continue;
+
+      memcpy (setme, &shm->state, sizeof (*setme));
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n (&shm->seq, __ATOMIC_RELAXED) == begin)
+        {
+          if (setme->n_devices > INDICATOR_POWER_SHM_MAX_DEVICES)
+            setme->n_devices = INDICATOR_POWER_SHM_MAX_DEVICES;
+          return 0;
+        }
+    }
+
+  return -EAGAIN;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INDICATOR_POWER_BATTERY_SHM_H__ */
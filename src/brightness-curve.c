@@ -0,0 +1,124 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "brightness-curve.h"
+
+#include <math.h> /* pow(), cbrt() */
+
+/* CIE 1976: L* = 116 * cbrt(Y) - 16, or 903.3 * Y in the linear segment near black */
+#define CIE_KAPPA   903.3
+#define CIE_EPSILON 0.008856
+
+static gdouble
+position_to_luminance (IndicatorPowerBrightnessCurveType type, gdouble gamma, gdouble p)
+{
+  switch (type)
+    {
+      case BRIGHTNESS_CURVE_GAMMA:
+        return pow (p, gamma);
+
+      case BRIGHTNESS_CURVE_CIE_LIGHTNESS:
+        {
+          const gdouble lightness = p * 100.0;
+          if (lightness > CIE_KAPPA * CIE_EPSILON)
+            return pow ((lightness + 16.0) / 116.0, 3.0);
+          return lightness / CIE_KAPPA;
+        }
+
+      default:
+        return p;
+    }
+}
+
+static gdouble
+luminance_to_position (IndicatorPowerBrightnessCurveType type, gdouble gamma, gdouble y)
+{
+  switch (type)
+    {
+      case BRIGHTNESS_CURVE_GAMMA:
+        return pow (y, 1.0/gamma);
+
+      case BRIGHTNESS_CURVE_CIE_LIGHTNESS:
+        if (y > CIE_EPSILON)
+          return (116.0 * cbrt (y) - 16.0) / 100.0;
+        return (y * CIE_KAPPA) / 100.0;
+
+      default:
+        return y;
+    }
+}
+
+void
+indicator_power_brightness_curve_init (IndicatorPowerBrightnessCurve     * self,
+                                       IndicatorPowerBrightnessCurveType   type,
+                                       gdouble                             gamma,
+                                       gint                                lo,
+                                       gint                                hi)
+{
+  int i;
+
+  g_return_if_fail (gamma > 0);
+
+  self->type = type;
+  self->gamma = gamma;
+  self->lo = lo;
+  self->hi = hi;
+
+  for (i=0; i<=BRIGHTNESS_CURVE_STEPS; ++i)
+    {
+      const gdouble x = i / (gdouble)BRIGHTNESS_CURVE_STEPS;
+      self->luminance[i] = (gfloat) CLAMP (position_to_luminance (type, gamma, x), 0.0, 1.0);
+      self->position[i] = (gfloat) CLAMP (luminance_to_position (type, gamma, x), 0.0, 1.0);
+    }
+}
+
+/* linear interpolation into a table of STEPS+1 entries */
+static gdouble
+lookup (const gfloat * table, gdouble x)
+{
+  gdouble pos;
+  gdouble a, b;
+  int i;
+
+  pos = CLAMP (x, 0.0, 1.0) * BRIGHTNESS_CURVE_STEPS;
+  i = (int) pos;
+  if (i >= BRIGHTNESS_CURVE_STEPS)
+    return (gdouble) table[BRIGHTNESS_CURVE_STEPS];
+
+  a = (gdouble) table[i];
+  b = (gdouble) table[i+1];
+  return a + (b - a) * (pos - i);
+}
+
+gint
+indicator_power_brightness_curve_to_level (const IndicatorPowerBrightnessCurve * self,
+                                           gdouble                               percentage)
+{
+  if (self->hi <= self->lo)
+    return self->lo;
+
+  return self->lo + (gint) (lookup (self->luminance, percentage) * (self->hi - self->lo) + 0.5);
+}
+
+gdouble
+indicator_power_brightness_curve_to_percentage (const IndicatorPowerBrightnessCurve * self,
+                                                gint                                  level)
+{
+  if (self->hi <= self->lo)
+    return 0;
+
+  return lookup (self->position, (level - self->lo) / (gdouble)(self->hi - self->lo));
+}
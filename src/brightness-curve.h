@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_BRIGHTNESS_CURVE_H__
+#define __INDICATOR_POWER_BRIGHTNESS_CURVE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* these match the brightness-curve-enum nicks in our gschema */
+typedef enum
+{
+  BRIGHTNESS_CURVE_LINEAR,
+  BRIGHTNESS_CURVE_GAMMA,
+  BRIGHTNESS_CURVE_CIE_LIGHTNESS
+}
+IndicatorPowerBrightnessCurveType;
+
+#define BRIGHTNESS_CURVE_STEPS 1024
+
+/**
+ * Maps between the slider's position and backlight levels along a
+ * perceptual curve, so that equal slider movements look like equal
+ * changes in brightness.
+ *
+ * Both directions are precomputed into tables when the range or curve
+ * changes, so each conversion is a lookup and a linear interpolation.
+ */
+typedef struct
+{
+  IndicatorPowerBrightnessCurveType type;
+  gdouble gamma;
+  gint lo;
+  gint hi;
+
+  /* slider position i/STEPS --> luminance in [0..1] */
+  gfloat luminance[BRIGHTNESS_CURVE_STEPS+1];
+
+  /* luminance i/STEPS --> slider position in [0..1] */
+  gfloat position[BRIGHTNESS_CURVE_STEPS+1];
+}
+IndicatorPowerBrightnessCurve;
+
+void    indicator_power_brightness_curve_init         (IndicatorPowerBrightnessCurve     * self,
+                                                       IndicatorPowerBrightnessCurveType   type,
+                                                       gdouble                             gamma,
+                                                       gint                                lo,
+                                                       gint                                hi);
+
+/* the backlight level for a slider position in [0..1] */
+gint    indicator_power_brightness_curve_to_level      (const IndicatorPowerBrightnessCurve * self,
+                                                        gdouble                               percentage);
+
+/* the slider position in [0..1] for a backlight level */
+gdouble indicator_power_brightness_curve_to_percentage (const IndicatorPowerBrightnessCurve * self,
+                                                        gint                                  level);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_BRIGHTNESS_CURVE_H__ */
@@ -18,9 +18,14 @@
  */
 
 #include "brightness.h"
+#include "brightness-curve.h"
+#include "clock.h"
 #include "dbus-powerd.h"
+#include "metrics.h"
+#include "recorder.h"
 
 #include <gio/gio.h>
+#include <gudev/gudev.h>
 
 #define SCHEMA_NAME "com.ubuntu.touch.system"
 #define KEY_AUTO "auto-brightness"
@@ -28,6 +33,15 @@
 #define KEY_BRIGHTNESS "brightness"
 #define KEY_NEED_DEFAULT "brightness-needs-hardware-default"
 
+/* our own schema, for the keys we can't add to the system one */
+#define CACHE_SCHEMA_NAME "com.canonical.indicator.power"
+#define KEY_POWERD_PARAMS "powerd-brightness-params"
+#define KEY_CURVE "brightness-curve"
+#define KEY_GAMMA "brightness-gamma"
+
+/* how long the slider has to sit still before we write it to dconf */
+#define SETTLE_MSEC 500
+
 enum
 {
   PROP_0,
@@ -44,13 +58,36 @@ typedef struct
   GDBusConnection * system_bus;
   GCancellable * cancellable;
 
-  GSettings * settings;
+  GSettings * settings; /* in delay-apply mode; see settings_apply_later() */
+  IndicatorPowerClock * clock;
+  guint settle_timer;
+
+  /* at most one brightness write is in flight at a time.
+     If the slider moves while it is, we remember the latest value
+     and send that when the call returns. */
+  gboolean write_pending;
+  gboolean write_dirty;
+  int write_wanted;
+
+  /* the sysfs backlight, if we found one. If so, and as long as logind
+     lets us write to it by name, it supplies the brightness range.
+     backlight_name is also set for a backlight that tests made up */
+  GUdevClient * udev_client;
+  GUdevDevice * backlight;
+  gchar * backlight_name;
+  gint backlight_max;
+  gboolean logind_unsupported;
 
   DbusPowerd * powerd_proxy;
   char * powerd_name_owner;
+  GSettings * cache_settings;
 
   double percentage;
 
+  /* maps between the slider and the current range; see get_curve() */
+  IndicatorPowerBrightnessCurve curve;
+  gboolean curve_dirty;
+
   /* powerd brightness params */
   gint powerd_dim;
   gint powerd_min;
@@ -73,6 +110,8 @@ G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerBrightness,
 ****  GObject virtual functions
 ***/
 
+static void settings_apply_now(IndicatorPowerBrightness * self);
+
 static void
 my_get_property(GObject     * o,
                 guint         property_id,
@@ -118,7 +157,10 @@ my_set_property(GObject       * o,
 
       case PROP_AUTO:
         if (p->settings != NULL)
-          g_settings_set_boolean (p->settings, KEY_AUTO, g_value_get_boolean(value));
+          {
+            g_settings_set_boolean (p->settings, KEY_AUTO, g_value_get_boolean(value));
+            settings_apply_now (self);
+          }
         break;
 
       default:
@@ -144,7 +186,25 @@ my_dispose(GObject * o)
       g_clear_object(&p->powerd_proxy);
     }
 
+  /* don't lose the last value if the slider was still moving */
+  if (p->settings != NULL)
+    settings_apply_now(self);
+
+  if (p->udev_client != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->udev_client, o);
+      g_clear_object(&p->udev_client);
+    }
+
+  g_clear_object(&p->backlight);
+  g_clear_pointer(&p->backlight_name, g_free);
   g_clear_object(&p->settings);
+  if (p->cache_settings != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->cache_settings, o);
+      g_clear_object(&p->cache_settings);
+    }
+  g_clear_object(&p->clock);
   g_clear_object(&p->system_bus);
   g_clear_pointer(&p->powerd_name_owner, g_free);
 
@@ -155,46 +215,81 @@ my_dispose(GObject * o)
 ****  Percentage <-> Brightness Int conversion helpers
 ***/
 
-static gdouble
-brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
+/* whether we're writing to the sysfs backlight, and so in its units */
+static gboolean
+using_backlight(const priv_t * p)
 {
-  const priv_t * p;
-  gdouble percentage;
+  return (p->backlight_name != NULL) && !p->logind_unsupported;
+}
+
+/* the sysfs backlight's range if we're using it, else powerd's */
+static gboolean
+get_brightness_range(IndicatorPowerBrightness * self, int * lo, int * hi)
+{
+  const priv_t * p = get_priv(self);
+
+  if (using_backlight(p))
+    {
+      /* don't let the slider turn the screen off */
+      *lo = MAX(1, p->backlight_max / 20);
+      *hi = p->backlight_max;
+      return TRUE;
+    }
 
-  p = get_priv(self);
   if (p->have_powerd_params)
     {
-      const int lo = p->powerd_min;
-      const int hi = p->powerd_max;
-      percentage = (brightness-lo) / (double)(hi-lo);
+      *lo = p->powerd_min;
+      *hi = p->powerd_max;
+      return TRUE;
     }
-  else
+
+  return FALSE;
+}
+
+/* rebuild the curve's tables if the range or the settings have changed */
+static const IndicatorPowerBrightnessCurve*
+get_curve(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+  int lo = 0;
+  int hi = 0;
+
+  get_brightness_range(self, &lo, &hi);
+
+  if (p->curve_dirty || (p->curve.lo != lo) || (p->curve.hi != hi))
     {
-      percentage = 0;
+      indicator_power_brightness_curve_init(&p->curve,
+                                            (IndicatorPowerBrightnessCurveType) g_settings_get_enum(p->cache_settings, KEY_CURVE),
+                                            g_settings_get_double(p->cache_settings, KEY_GAMMA),
+                                            lo,
+                                            hi);
+      p->curve_dirty = FALSE;
     }
 
-  return percentage;
+  return &p->curve;
+}
+
+static gdouble
+brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
+{
+  return indicator_power_brightness_curve_to_percentage(get_curve(self), brightness);
 }
 
 static int
 percentage_to_brightness(IndicatorPowerBrightness * self, double percentage)
 {
-  const priv_t * p;
-  int brightness;
+  int lo, hi;
 
-  p = get_priv(self);
-  if (p->have_powerd_params)
-    {
-      const int lo = p->powerd_min;
-      const int hi = p->powerd_max;
-      brightness = (int)(lo + (percentage*(hi-lo)));
-    }
-  else
-    {
-      brightness = 0;
-    }
+  if (!get_brightness_range(self, &lo, &hi))
+    return 0;
 
-  return brightness;
+  return indicator_power_brightness_curve_to_level(get_curve(self), percentage);
+}
+
+static void
+on_curve_changed_in_schema(IndicatorPowerBrightness * self)
+{
+  get_priv(self)->curve_dirty = TRUE;
 }
 
 /**
@@ -206,6 +301,29 @@ percentage_to_brightness(IndicatorPowerBrightness * self, double percentage)
 
 static void set_brightness_global(IndicatorPowerBrightness*, int);
 static void set_brightness_local(IndicatorPowerBrightness*, int);
+static void write_flush(IndicatorPowerBrightness*);
+static void settings_apply_later(IndicatorPowerBrightness*);
+
+/* params is a (dim, min, max, default, ab_supported) tuple */
+static gboolean
+set_powerd_params(IndicatorPowerBrightness * self, GVariant * params)
+{
+  priv_t * p = get_priv(self);
+  gint dim, lo, hi, default_value;
+  gboolean ab_supported;
+
+  g_variant_get(params, "(iiiib)", &dim, &lo, &hi, &default_value, &ab_supported);
+  if (hi <= lo)
+    return FALSE;
+
+  p->have_powerd_params = TRUE;
+  p->powerd_dim = dim;
+  p->powerd_min = lo;
+  p->powerd_max = hi;
+  p->powerd_default_value = default_value;
+  p->powerd_ab_supported = ab_supported;
+  return TRUE;
+}
 
 static void
 on_powerd_brightness_params_ready(GObject      * oproxy,
@@ -223,19 +341,31 @@ on_powerd_brightness_params_ready(GObject      * oproxy,
       priv_t * p = get_priv(self);
       const gboolean old_ab_supported = p->powerd_ab_supported;
 
-      p->have_powerd_params = TRUE;
-      g_variant_get(v, "(iiiib)", &p->powerd_dim,
-                                  &p->powerd_min,
-                                  &p->powerd_max,
-                                  &p->powerd_default_value,
-                                  &p->powerd_ab_supported);
+      if (!set_powerd_params(self, v))
+        {
+          gchar * str = g_variant_print(v, FALSE);
+          g_warning("Ignoring invalid powerd brightness params %s", str);
+          g_free(str);
+          g_variant_unref(v);
+          return;
+        }
+
       g_debug("powerd brightness settings: dim=%d, min=%d, max=%d, default=%d, ab_supported=%d",
               p->powerd_dim,
               p->powerd_min,
               p->powerd_max,
               p->powerd_default_value,
               (int)p->powerd_ab_supported);
- 
+
+      /* remember them for next time, if they've changed */
+      if (p->cache_settings != NULL)
+        {
+          GVariant * cached = g_settings_get_value(p->cache_settings, KEY_POWERD_PARAMS);
+          if (!g_variant_equal(cached, v))
+            g_settings_set_value(p->cache_settings, KEY_POWERD_PARAMS, v);
+          g_variant_unref(cached);
+        }
+
       if (old_ab_supported != p->powerd_ab_supported)
         g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_AUTO_SUPPORTED]);
 
@@ -248,6 +378,7 @@ on_powerd_brightness_params_ready(GObject      * oproxy,
               g_debug("%s is true, so initializing brightness to powerd default '%d'", KEY_NEED_DEFAULT, p->powerd_default_value);
               set_brightness_global(self, p->powerd_default_value);
               g_settings_set_boolean(p->settings, KEY_NEED_DEFAULT, FALSE);
+              settings_apply_now(self);
             }
           else
             {
@@ -278,8 +409,8 @@ on_powerd_name_owner_changed(GDBusProxy * powerd_proxy,
 
   if (g_strcmp0(p->powerd_name_owner, owner))
     {
-      p->have_powerd_params = FALSE;
-
+      /* keep using the params we have (maybe from the cache)
+         until the new owner tells us otherwise */
       if (owner != NULL)
         {
           dbus_powerd_call_get_brightness_params(DBUS_POWERD(powerd_proxy),
@@ -320,6 +451,7 @@ on_powerd_proxy_ready(GObject      * source_object G_GNUC_UNUSED,
       /* keep a handle to the system bus */
       g_clear_object(&p->system_bus);
       p->system_bus = g_object_ref(g_dbus_proxy_get_connection(G_DBUS_PROXY(powerd_proxy)));
+      write_flush(INDICATOR_POWER_BRIGHTNESS(gself));
 
       /* keep the proxy and listen to owner changes */
       p->powerd_proxy = powerd_proxy;
@@ -339,52 +471,273 @@ on_powerd_proxy_ready(GObject      * source_object G_GNUC_UNUSED,
 }
 
 /**
- * DBus Chatter: com.canonical.Unity.Screen
+ * Writing the brightness
  *
- * Used to set the backlight brightness via setUserBrightness
+ * If we found a sysfs backlight, we write to it with logind's
+ * Session.SetBrightness. Otherwise, or if logind doesn't support
+ * that, we fall back to com.canonical.Unity.Screen's setUserBrightness.
  */
 
-/* setUserBrightness doesn't return anything,
-   so this function is just to check for bus error messages */
+static void
+on_write_done(IndicatorPowerBrightness * self, GError * error, const char * method)
+{
+  if (error != NULL)
+    {
+      const gboolean cancelled = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+      if (!cancelled)
+        g_warning("Unable to call %s: %s", method, error->message);
+
+      if (cancelled)
+        return;
+    }
+
+  get_priv(self)->write_pending = FALSE;
+  write_flush(self);
+}
+
+/* setUserBrightness doesn't return anything, so this function
+   just checks for errors and sends the next value if there is one */
 static void
 on_set_uscreen_user_brightness_result(GObject      * system_bus,
                                       GAsyncResult * res,
-                                      gpointer       gself        G_GNUC_UNUSED)
+                                      gpointer       gself)
 {
   GError * error;
   GVariant * v;
 
   error = NULL;
   v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(system_bus), res, &error);
-  if (error != NULL)
+  on_write_done(gself, error, "uscreen.setBrightness");
+  g_clear_error(&error);
+  g_clear_pointer(&v, g_variant_unref);
+}
+
+static void
+on_set_logind_brightness_result(GObject      * system_bus,
+                                GAsyncResult * res,
+                                gpointer       gself)
+{
+  GError * error;
+  GVariant * v;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(system_bus), res, &error);
+
+  /* Whatever the reason -- no logind, a logind older than 243 without
+     session/auto, or we're not in a session it'll let us use -- it's
+     not going to work next time either, so resend through Unity.Screen */
+  if ((error != NULL) && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     {
-      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning("Unable to call uscreen.setBrightness: %s", error->message);
+      IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+      priv_t * p = get_priv(self);
+      const double percentage = brightness_to_percentage(self, p->write_wanted);
+      int lo, hi;
 
-      g_error_free(error);
+      g_debug("logind can't set the brightness (%s); falling back to Unity.Screen", error->message);
+      p->logind_unsupported = TRUE;
+
+      /* From here on the range is powerd's. The latest value, and the
+         one we may have saved, are in sysfs units, so convert them */
+      if (get_brightness_range(self, &lo, &hi))
+        {
+          p->write_wanted = percentage_to_brightness(self, percentage);
+          p->write_dirty = TRUE;
+
+          if (p->settings != NULL)
+            {
+              g_settings_set_int(p->settings, KEY_BRIGHTNESS, p->write_wanted);
+              settings_apply_later(self);
+            }
+        }
+      else
+        {
+          g_debug("no powerd brightness range yet, so not resending");
+        }
+
+      g_clear_error(&error);
     }
 
+  on_write_done(gself, error, "logind.SetBrightness");
+  g_clear_error(&error);
   g_clear_pointer(&v, g_variant_unref);
 }
 
 static void
-set_uscreen_user_brightness(IndicatorPowerBrightness * self,
-                            int                        value)
+write_flush(IndicatorPowerBrightness * self)
 {
   priv_t * p = get_priv(self);
 
-  g_dbus_connection_call(p->system_bus,
-                         "com.canonical.Unity.Screen",
-                         "/com/canonical/Unity/Screen",
-                         "com.canonical.Unity.Screen",
-                         "setUserBrightness",
-                         g_variant_new("(i)", value),
-                         NULL, /* no return args */
-                         G_DBUS_CALL_FLAGS_NONE,
-                         -1, /* default timeout */
-                         p->cancellable,
-                         on_set_uscreen_user_brightness_result,
-                         self);
+  if (p->write_pending || !p->write_dirty || (p->system_bus == NULL))
+    return;
+
+  p->write_pending = TRUE;
+  p->write_dirty = FALSE;
+
+  if (using_backlight(p))
+    {
+      g_dbus_connection_call(p->system_bus,
+                             "org.freedesktop.login1",
+                             "/org/freedesktop/login1/session/auto",
+                             "org.freedesktop.login1.Session",
+                             "SetBrightness",
+                             g_variant_new("(ssu)",
+                                           "backlight",
+                                           p->backlight_name,
+                                           (guint32) MAX(p->write_wanted, 0)),
+                             NULL, /* no return args */
+                             G_DBUS_CALL_FLAGS_NONE,
+                             -1, /* default timeout */
+                             p->cancellable,
+                             on_set_logind_brightness_result,
+                             self);
+    }
+  else
+    {
+      g_dbus_connection_call(p->system_bus,
+                             "com.canonical.Unity.Screen",
+                             "/com/canonical/Unity/Screen",
+                             "com.canonical.Unity.Screen",
+                             "setUserBrightness",
+                             g_variant_new("(i)", p->write_wanted),
+                             NULL, /* no return args */
+                             G_DBUS_CALL_FLAGS_NONE,
+                             -1, /* default timeout */
+                             p->cancellable,
+                             on_set_uscreen_user_brightness_result,
+                             self);
+    }
+}
+
+static void
+set_hardware_brightness(IndicatorPowerBrightness * self,
+                        int                        value)
+{
+  priv_t * p = get_priv(self);
+
+  p->write_wanted = value;
+  p->write_dirty = TRUE;
+  write_flush(self);
+}
+
+/**
+ * sysfs backlight discovery
+ */
+
+/* in order of preference; see the kernel's sysfs-class-backlight ABI doc */
+static const char * const backlight_types[] = { "firmware", "platform", "raw" };
+
+static GUdevDevice*
+find_backlight(GUdevClient * client)
+{
+  GList * devices = g_udev_client_query_by_subsystem(client, "backlight");
+  GUdevDevice * best = NULL;
+  GList * l;
+  guint i;
+
+  for (i=0; (best==NULL) && (i<G_N_ELEMENTS(backlight_types)); ++i)
+    for (l=devices; (best==NULL) && (l!=NULL); l=l->next)
+      if (!g_strcmp0(g_udev_device_get_sysfs_attr(l->data, "type"), backlight_types[i]))
+        if (g_udev_device_get_sysfs_attr_as_int(l->data, "max_brightness") > 0)
+          best = g_object_ref(l->data);
+
+  g_list_free_full(devices, g_object_unref);
+  return best;
+}
+
+static void
+backlight_rescan(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  g_clear_object(&p->backlight);
+  g_clear_pointer(&p->backlight_name, g_free);
+  p->backlight_max = 0;
+
+  if ((p->backlight = find_backlight(p->udev_client)))
+    {
+      p->backlight_name = g_strdup(g_udev_device_get_name(p->backlight));
+      p->backlight_max = g_udev_device_get_sysfs_attr_as_int(p->backlight, "max_brightness");
+      g_debug("using backlight \"%s\" with max_brightness %d",
+              g_udev_device_get_sysfs_path(p->backlight),
+              p->backlight_max);
+    }
+}
+
+static void
+on_backlight_uevent(GUdevClient * client  G_GNUC_UNUSED,
+                    const gchar * action,
+                    GUdevDevice * device,
+                    gpointer      gself)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+  priv_t * p = get_priv(self);
+
+  if (!g_strcmp0(action, "change"))
+    {
+      /* someone else, e.g. a hotkey, changed the brightness.
+         Ignore the echoes of our own writes while the slider's moving */
+      if ((p->backlight != NULL)
+          && using_backlight(p)
+          && !g_strcmp0(g_udev_device_get_sysfs_path(device), g_udev_device_get_sysfs_path(p->backlight))
+          && !p->write_pending
+          && !p->write_dirty)
+        set_brightness_local(self, g_udev_device_get_sysfs_attr_as_int(device, "brightness"));
+    }
+  else if (!g_strcmp0(action, "add") || !g_strcmp0(action, "remove"))
+    {
+      backlight_rescan(self);
+    }
+}
+
+/***
+****
+***/
+
+/***
+****  GSettings writes
+****
+****  Every dconf write costs a round trip and wakes up everything that's
+****  watching the key, so a slider drag's writes are batched with
+****  g_settings_delay() and applied once the slider has settled.
+***/
+
+static void
+settings_apply_now(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->settle_timer != 0)
+    {
+      indicator_power_clock_source_remove(p->clock, p->settle_timer);
+      p->settle_timer = 0;
+    }
+
+  g_settings_apply(p->settings);
+}
+
+static gboolean
+on_settle_timer(gpointer gself)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+
+  get_priv(self)->settle_timer = 0;
+  settings_apply_now(self);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+settings_apply_later(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->settle_timer != 0)
+    indicator_power_clock_source_remove(p->clock, p->settle_timer);
+
+  p->settle_timer = indicator_power_clock_timeout_add(p->clock,
+                                                      SETTLE_MSEC,
+                                                      on_settle_timer,
+                                                      self);
 }
 
 /***
@@ -412,13 +765,20 @@ static void
 set_brightness_global(IndicatorPowerBrightness * self, int brightness)
 {
   priv_t * p = get_priv(self);
+  const gint64 begin = indicator_power_metrics_handler_begin();
 
-  set_uscreen_user_brightness(self, brightness);
+  indicator_power_recorder_record(RECORD_BRIGHTNESS_REQUEST, (guint32)brightness);
+  set_hardware_brightness(self, brightness);
 
   if (p->settings != NULL)
-    g_settings_set_int(p->settings, KEY_BRIGHTNESS, brightness);
+    {
+      g_settings_set_int(p->settings, KEY_BRIGHTNESS, brightness);
+      settings_apply_later(self);
+    }
   else
     set_brightness_local(self, brightness);
+
+  indicator_power_metrics_handler_end(G_STRFUNC, begin);
 }
 
 static void
@@ -428,6 +788,18 @@ on_auto_changed_in_schema(IndicatorPowerBrightness * self)
 }
 
 
+/* where the slider starts, before anyone's told us anything */
+static void
+init_percentage(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if ((p->backlight != NULL) && using_backlight(p))
+    p->percentage = brightness_to_percentage(self, g_udev_device_get_sysfs_attr_as_int(p->backlight, "brightness"));
+  else if (!using_backlight(p) && p->have_powerd_params && (p->settings != NULL))
+    p->percentage = brightness_to_percentage(self, g_settings_get_int(p->settings, KEY_BRIGHTNESS));
+}
+
 /***
 ****  Instantiation
 ***/
@@ -437,9 +809,22 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
 {
   priv_t * p;
   GSettingsSchema * schema;
+  GVariant * cached;
 
   p = get_priv(self);
   p->cancellable = g_cancellable_new();
+  p->clock = g_object_ref(indicator_power_clock_get_default());
+
+  p->cache_settings = g_settings_new(CACHE_SCHEMA_NAME);
+  p->curve_dirty = TRUE;
+  g_signal_connect_swapped(p->cache_settings, "changed::" KEY_CURVE,
+                           G_CALLBACK(on_curve_changed_in_schema), self);
+  g_signal_connect_swapped(p->cache_settings, "changed::" KEY_GAMMA,
+                           G_CALLBACK(on_curve_changed_in_schema), self);
+
+  p->udev_client = g_udev_client_new((const gchar * const []){ "backlight", NULL });
+  g_signal_connect(p->udev_client, "uevent", G_CALLBACK(on_backlight_uevent), self);
+  backlight_rescan(self);
 
   schema = g_settings_schema_source_lookup(g_settings_schema_source_get_default(),
                                            SCHEMA_NAME,
@@ -453,6 +838,7 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
       if (g_settings_schema_has_key(schema, KEY_BRIGHTNESS))
         {
           p->settings = g_settings_new(SCHEMA_NAME);
+          g_settings_delay(p->settings);
           g_signal_connect(p->settings, "changed::" KEY_BRIGHTNESS,
                            G_CALLBACK(on_brightness_changed_in_schema), self);
           g_signal_connect_swapped(p->settings, "changed::" KEY_AUTO,
@@ -461,6 +847,13 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
       g_settings_schema_unref(schema);
     }
 
+  /* use the last session's powerd params so that the slider's
+     in the right place before powerd gets around to answering */
+  cached = g_settings_get_value(p->cache_settings, KEY_POWERD_PARAMS);
+  set_powerd_params(self, cached);
+  g_variant_unref(cached);
+  init_percentage(self);
+
   dbus_powerd_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
                                  G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
                                  "com.canonical.powerd",
@@ -519,6 +912,28 @@ indicator_power_brightness_new(void)
   return INDICATOR_POWER_BRIGHTNESS(o);
 }
 
+IndicatorPowerBrightness *
+indicator_power_brightness_new_with_backlight(const char * name,
+                                              int          max_brightness)
+{
+  IndicatorPowerBrightness * self = indicator_power_brightness_new();
+  priv_t * p = get_priv(self);
+
+  g_return_val_if_fail((name == NULL) || (max_brightness > 0), self);
+
+  /* forget what sysfs said. Nothing's been written yet,
+     since that waits for the system bus */
+  g_signal_handlers_disconnect_by_data(p->udev_client, self);
+  g_clear_object(&p->udev_client);
+  g_clear_object(&p->backlight);
+
+  g_free(p->backlight_name);
+  p->backlight_name = g_strdup(name);
+  p->backlight_max = name != NULL ? max_brightness : 0;
+  init_percentage(self);
+  return self;
+}
+
 void
 indicator_power_brightness_set_percentage(IndicatorPowerBrightness * self,
                                           double                     percentage)
@@ -58,6 +58,12 @@ GType indicator_power_brightness_get_type(void);
 
 IndicatorPowerBrightness * indicator_power_brightness_new(void);
 
+/* like indicator_power_brightness_new(), but with the named backlight
+   instead of whatever's in sysfs, or with none if name is NULL.
+   Meant for tests. */
+IndicatorPowerBrightness * indicator_power_brightness_new_with_backlight(const char * name,
+                                                                         int          max_brightness);
+
 void indicator_power_brightness_set_percentage(IndicatorPowerBrightness * self, double percentage);
 
 double indicator_power_brightness_get_percentage(IndicatorPowerBrightness * self);
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clock.h"
+#include "clock-mock.h"
+
+struct mock_timer
+{
+  guint tag;
+  gint64 interval;
+  gint64 due;
+  GSourceFunc func;
+  gpointer data;
+};
+
+/* start well away from zero, since callers often use 0 to mean 'unset' */
+#define START_TIME (G_USEC_PER_SEC * 60 * 60)
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_clock_interface_init (IndicatorPowerClockInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerClockMock,
+  indicator_power_clock_mock,
+  G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_CLOCK,
+                         indicator_power_clock_interface_init))
+
+/***
+****  Timers
+***/
+
+static struct mock_timer *
+find_timer (IndicatorPowerClockMock * self, guint tag)
+{
+  GList * l;
+
+  for (l=self->timers; l!=NULL; l=l->next)
+    {
+      struct mock_timer * timer = l->data;
+
+      if (timer->tag == tag)
+        return timer;
+    }
+
+  return NULL;
+}
+
+/* the timer that comes due soonest, ties going to the oldest */
+static struct mock_timer *
+find_next_timer (IndicatorPowerClockMock * self)
+{
+  GList * l;
+  struct mock_timer * next = NULL;
+
+  for (l=self->timers; l!=NULL; l=l->next)
+    {
+      struct mock_timer * timer = l->data;
+
+      if ((next == NULL) || (timer->due < next->due))
+        next = timer;
+    }
+
+  return next;
+}
+
+static void
+remove_timer (IndicatorPowerClockMock * self, struct mock_timer * timer)
+{
+  self->timers = g_list_remove (self->timers, timer);
+  g_slice_free (struct mock_timer, timer);
+}
+
+/***
+****  IndicatorPowerClock virtual functions
+***/
+
+static gint64
+my_get_monotonic_time (IndicatorPowerClock * clock)
+{
+  return INDICATOR_POWER_CLOCK_MOCK(clock)->now;
+}
+
+static guint
+my_timeout_add (IndicatorPowerClock * clock,
+                guint                 interval_msec,
+                GSourceFunc           func,
+                gpointer              data)
+{
+  IndicatorPowerClockMock * self = INDICATOR_POWER_CLOCK_MOCK(clock);
+  struct mock_timer * timer;
+
+  timer = g_slice_new (struct mock_timer);
+  timer->tag = ++self->next_tag;
+  timer->interval = (gint64)interval_msec * 1000;
+  timer->due = self->now + timer->interval;
+  timer->func = func;
+  timer->data = data;
+  self->timers = g_list_append (self->timers, timer);
+
+  return timer->tag;
+}
+
+static void
+my_source_remove (IndicatorPowerClock * clock,
+                  guint                 tag)
+{
+  IndicatorPowerClockMock * self = INDICATOR_POWER_CLOCK_MOCK(clock);
+  struct mock_timer * timer;
+
+  if ((timer = find_timer (self, tag)))
+    remove_timer (self, timer);
+  else
+    g_warning ("%s: no timer with tag %u", G_STRFUNC, tag);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_finalize (GObject * o)
+{
+  IndicatorPowerClockMock * self = INDICATOR_POWER_CLOCK_MOCK(o);
+
+  while (self->timers != NULL)
+    remove_timer (self, self->timers->data);
+
+  G_OBJECT_CLASS (indicator_power_clock_mock_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_clock_mock_class_init (IndicatorPowerClockMockClass * klass)
+{
+  GObjectClass * object_class;
+
+  object_class = G_OBJECT_CLASS (klass);
+  object_class->finalize = my_finalize;
+}
+
+static void
+indicator_power_clock_interface_init (IndicatorPowerClockInterface * iface)
+{
+  iface->get_monotonic_time = my_get_monotonic_time;
+  iface->timeout_add = my_timeout_add;
+  iface->source_remove = my_source_remove;
+}
+
+static void
+indicator_power_clock_mock_init (IndicatorPowerClockMock * self)
+{
+  self->now = START_TIME;
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerClock *
+indicator_power_clock_mock_new (void)
+{
+  gpointer o = g_object_new (INDICATOR_TYPE_POWER_CLOCK_MOCK, NULL);
+
+  return INDICATOR_POWER_CLOCK (o);
+}
+
+/**
+ * Moves the clock forward by msec, running timers as they come due.
+ *
+ * A timer's callback sees the clock's time as the moment it was due.
+ * Timers that return G_SOURCE_CONTINUE are rescheduled for another
+ * interval, so they may fire more than once during a single advance.
+ */
+void
+indicator_power_clock_mock_advance (IndicatorPowerClockMock * self,
+                                    guint                     msec)
+{
+  const gint64 end = self->now + (gint64)msec * 1000;
+  struct mock_timer * timer;
+
+  g_return_if_fail (INDICATOR_IS_POWER_CLOCK_MOCK (self));
+
+  g_object_ref (self);
+
+  while (((timer = find_next_timer (self))) && (timer->due <= end))
+    {
+      const guint tag = timer->tag;
+      gboolean again;
+
+      self->now = MAX (self->now, timer->due);
+      again = timer->func (timer->data);
+
+      /* the callback may have removed its own timer */
+      if ((timer = find_timer (self, tag)))
+        {
+          if (again)
+            timer->due += MAX (timer->interval, 1);
+          else
+            remove_timer (self, timer);
+        }
+    }
+
+  self->now = end;
+
+  g_object_unref (self);
+}
+
+guint
+indicator_power_clock_mock_get_n_timers (IndicatorPowerClockMock * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_CLOCK_MOCK (self), 0);
+
+  return g_list_length (self->timers);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_CLOCK_MOCK__H__
+#define __INDICATOR_POWER_CLOCK_MOCK__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "clock.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_CLOCK_MOCK \
+  (indicator_power_clock_mock_get_type())
+
+#define INDICATOR_POWER_CLOCK_MOCK(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_CLOCK_MOCK, \
+                               IndicatorPowerClockMock))
+
+#define INDICATOR_IS_POWER_CLOCK_MOCK(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_CLOCK_MOCK))
+
+typedef struct _IndicatorPowerClockMock
+                IndicatorPowerClockMock;
+typedef struct _IndicatorPowerClockMockClass
+                IndicatorPowerClockMockClass;
+
+/**
+ * A virtual IndicatorPowerClock for unit tests.
+ *
+ * Time stands still until indicator_power_clock_mock_advance() is called,
+ * which then runs any timers that came due, in order.
+ */
+struct _IndicatorPowerClockMock
+{
+  GObject parent_instance;
+
+  /*< private >*/
+  gint64 now;
+  guint next_tag;
+  GList * timers;
+};
+
+struct _IndicatorPowerClockMockClass
+{
+  GObjectClass parent_class;
+};
+
+GType indicator_power_clock_mock_get_type (void);
+
+IndicatorPowerClock * indicator_power_clock_mock_new (void);
+
+void indicator_power_clock_mock_advance (IndicatorPowerClockMock * clock,
+                                         guint                     msec);
+
+guint indicator_power_clock_mock_get_n_timers (IndicatorPowerClockMock * clock);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_CLOCK_MOCK__H__ */
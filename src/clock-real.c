@@ -0,0 +1,178 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clock.h"
+#include "clock-real.h"
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_clock_interface_init (IndicatorPowerClockInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerClockReal,
+  indicator_power_clock_real,
+  G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_CLOCK,
+                         indicator_power_clock_interface_init))
+
+/***
+****  IndicatorPowerClock virtual functions
+***/
+
+static gint64
+my_get_monotonic_time (IndicatorPowerClock * clock G_GNUC_UNUSED)
+{
+  return g_get_monotonic_time ();
+}
+
+/* Timers go on the thread-default context, like GIO's async calls,
+   so that a service embedded in a host's GMainContext keeps its
+   timers there too. For the standalone service that's the default.
+
+   Sources are kept by our own tag rather than by their GSource id,
+   since ids are only unique within one context and the caller may
+   remove a timer with a different thread-default pushed. */
+
+struct real_timer
+{
+  IndicatorPowerClockReal * self;
+  guint tag;
+  GSourceFunc func;
+  gpointer data;
+};
+
+static gboolean
+on_timer (gpointer gtimer)
+{
+  struct real_timer * timer = gtimer;
+
+  return timer->func (timer->data);
+}
+
+/* called when the source is destroyed, whether removed or finished */
+static void
+on_timer_destroyed (gpointer gtimer)
+{
+  struct real_timer * timer = gtimer;
+
+  if (timer->self->sources != NULL)
+    g_hash_table_remove (timer->self->sources, GUINT_TO_POINTER(timer->tag));
+
+  g_slice_free (struct real_timer, timer);
+}
+
+static guint
+my_timeout_add (IndicatorPowerClock * clock,
+                guint                 interval_msec,
+                GSourceFunc           func,
+                gpointer              data)
+{
+  IndicatorPowerClockReal * self = INDICATOR_POWER_CLOCK_REAL(clock);
+  struct real_timer * timer;
+  GSource * source;
+
+  timer = g_slice_new (struct real_timer);
+  timer->self = self;
+  do
+    timer->tag = ++self->next_tag;
+  while (timer->tag == 0);
+  timer->func = func;
+  timer->data = data;
+
+  source = g_timeout_source_new (interval_msec);
+  g_source_set_callback (source, on_timer, timer, on_timer_destroyed);
+  g_hash_table_insert (self->sources, GUINT_TO_POINTER(timer->tag), source);
+  g_source_attach (source, g_main_context_get_thread_default ());
+  g_source_unref (source);
+
+  return timer->tag;
+}
+
+static void
+my_source_remove (IndicatorPowerClock * clock,
+                  guint                 tag)
+{
+  IndicatorPowerClockReal * self = INDICATOR_POWER_CLOCK_REAL(clock);
+  GSource * source = g_hash_table_lookup (self->sources, GUINT_TO_POINTER(tag));
+
+  if (source != NULL)
+    g_source_destroy (source);
+  else
+    g_warning ("%s: no timer with tag %u", G_STRFUNC, tag);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_finalize (GObject * o)
+{
+  IndicatorPowerClockReal * self = INDICATOR_POWER_CLOCK_REAL(o);
+  GHashTable * sources = self->sources;
+  GHashTableIter iter;
+  gpointer source;
+
+  /* unset first, so the destroy notifies leave the table alone */
+  self->sources = NULL;
+  g_hash_table_iter_init (&iter, sources);
+  while (g_hash_table_iter_next (&iter, NULL, &source))
+    g_source_destroy (source);
+  g_hash_table_destroy (sources);
+
+  G_OBJECT_CLASS (indicator_power_clock_real_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_clock_real_class_init (IndicatorPowerClockRealClass * klass)
+{
+  GObjectClass * object_class;
+
+  object_class = G_OBJECT_CLASS (klass);
+  object_class->finalize = my_finalize;
+}
+
+static void
+indicator_power_clock_interface_init (IndicatorPowerClockInterface * iface)
+{
+  iface->get_monotonic_time = my_get_monotonic_time;
+  iface->timeout_add = my_timeout_add;
+  iface->source_remove = my_source_remove;
+}
+
+static void
+indicator_power_clock_real_init (IndicatorPowerClockReal * self)
+{
+  self->sources = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerClock *
+indicator_power_clock_real_new (void)
+{
+  gpointer o = g_object_new (INDICATOR_TYPE_POWER_CLOCK_REAL, NULL);
+
+  return INDICATOR_POWER_CLOCK (o);
+}
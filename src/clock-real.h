@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_CLOCK_REAL__H__
+#define __INDICATOR_POWER_CLOCK_REAL__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "clock.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_CLOCK_REAL \
+  (indicator_power_clock_real_get_type())
+
+#define INDICATOR_POWER_CLOCK_REAL(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_CLOCK_REAL, \
+                               IndicatorPowerClockReal))
+
+#define INDICATOR_IS_POWER_CLOCK_REAL(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_CLOCK_REAL))
+
+typedef struct _IndicatorPowerClockReal
+                IndicatorPowerClockReal;
+typedef struct _IndicatorPowerClockRealClass
+                IndicatorPowerClockRealClass;
+
+/**
+ * An IndicatorPowerClock backed by the thread-default GMainContext.
+ */
+struct _IndicatorPowerClockReal
+{
+  GObject parent_instance;
+
+  /*< private >*/
+  guint next_tag;
+  GHashTable * sources; /* tag -> GSource* */
+};
+
+struct _IndicatorPowerClockRealClass
+{
+  GObjectClass parent_class;
+};
+
+GType indicator_power_clock_real_get_type (void);
+
+IndicatorPowerClock * indicator_power_clock_real_new (void);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_CLOCK_REAL__H__ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clock.h"
+#include "clock-real.h"
+
+G_DEFINE_INTERFACE (IndicatorPowerClock,
+                    indicator_power_clock,
+                    0)
+
+static void
+indicator_power_clock_default_init (IndicatorPowerClockInterface * klass G_GNUC_UNUSED)
+{
+}
+
+/***
+****  PUBLIC API
+***/
+
+/**
+ * Returns the clock's current time in microseconds.
+ * Like g_get_monotonic_time(), this is only useful for measuring intervals.
+ */
+gint64
+indicator_power_clock_get_monotonic_time (IndicatorPowerClock * self)
+{
+  IndicatorPowerClockInterface * iface;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_CLOCK (self), 0);
+  iface = INDICATOR_POWER_CLOCK_GET_INTERFACE (self);
+
+  return iface->get_monotonic_time (self);
+}
+
+/**
+ * Like g_timeout_add(), but driven by this clock.
+ *
+ * Return value: a tag that can be passed to indicator_power_clock_source_remove()
+ */
+guint
+indicator_power_clock_timeout_add (IndicatorPowerClock * self,
+                                   guint                 interval_msec,
+                                   GSourceFunc           func,
+                                   gpointer              data)
+{
+  IndicatorPowerClockInterface * iface;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_CLOCK (self), 0);
+  g_return_val_if_fail (func != NULL, 0);
+  iface = INDICATOR_POWER_CLOCK_GET_INTERFACE (self);
+
+  return iface->timeout_add (self, interval_msec, func, data);
+}
+
+void
+indicator_power_clock_source_remove (IndicatorPowerClock * self,
+                                     guint                 tag)
+{
+  IndicatorPowerClockInterface * iface;
+
+  g_return_if_fail (INDICATOR_IS_POWER_CLOCK (self));
+  g_return_if_fail (tag != 0);
+  iface = INDICATOR_POWER_CLOCK_GET_INTERFACE (self);
+
+  iface->source_remove (self, tag);
+}
+
+/***
+****  Default clock
+***/
+
+static IndicatorPowerClock * default_clock = NULL;
+
+/**
+ * Returns the clock that the service's timers should use.
+ * This is the system clock unless indicator_power_clock_set_default()
+ * has been called, e.g. by unit tests that want a virtual clock.
+ *
+ * Return value: (transfer none): the default clock
+ */
+IndicatorPowerClock *
+indicator_power_clock_get_default (void)
+{
+  if (default_clock == NULL)
+    default_clock = indicator_power_clock_real_new ();
+
+  return default_clock;
+}
+
+/**
+ * Replaces the default clock. Passing NULL restores the system clock.
+ *
+ * Objects that are already running keep the clock they started with,
+ * so this should be called before the service objects are created.
+ */
+void
+indicator_power_clock_set_default (IndicatorPowerClock * clock)
+{
+  g_return_if_fail ((clock == NULL) || INDICATOR_IS_POWER_CLOCK (clock));
+
+  if (clock != NULL)
+    g_object_ref (clock);
+
+  g_clear_object (&default_clock);
+  default_clock = clock;
+}
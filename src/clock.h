@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_CLOCK__H__
+#define __INDICATOR_POWER_CLOCK__H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_CLOCK \
+  (indicator_power_clock_get_type ())
+
+#define INDICATOR_POWER_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+                               INDICATOR_TYPE_POWER_CLOCK, \
+                               IndicatorPowerClock))
+
+#define INDICATOR_IS_POWER_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), INDICATOR_TYPE_POWER_CLOCK))
+
+#define INDICATOR_POWER_CLOCK_GET_INTERFACE(inst) \
+  (G_TYPE_INSTANCE_GET_INTERFACE ((inst), \
+                                  INDICATOR_TYPE_POWER_CLOCK, \
+                                  IndicatorPowerClockInterface))
+
+typedef struct _IndicatorPowerClock
+                IndicatorPowerClock;
+
+typedef struct _IndicatorPowerClockInterface
+                IndicatorPowerClockInterface;
+
+/**
+ * An interface class for an object that tells time and runs timers.
+ *
+ * Example uses:
+ *  - in production, an implementation that wraps the GLib main loop
+ *  - in unit tests, a virtual clock that the test advances by hand
+ */
+struct _IndicatorPowerClockInterface
+{
+  GTypeInterface parent_iface;
+
+  /* virtual functions */
+  gint64 (*get_monotonic_time) (IndicatorPowerClock * self);
+
+  guint  (*timeout_add)        (IndicatorPowerClock * self,
+                                guint                 interval_msec,
+                                GSourceFunc           func,
+                                gpointer              data);
+
+  void   (*source_remove)      (IndicatorPowerClock * self,
+                                guint                 tag);
+};
+
+GType indicator_power_clock_get_type (void);
+
+/***
+****
+***/
+
+gint64 indicator_power_clock_get_monotonic_time (IndicatorPowerClock * self);
+
+guint  indicator_power_clock_timeout_add        (IndicatorPowerClock * self,
+                                                 guint                 interval_msec,
+                                                 GSourceFunc           func,
+                                                 gpointer              data);
+
+void   indicator_power_clock_source_remove      (IndicatorPowerClock * self,
+                                                 guint                 tag);
+
+IndicatorPowerClock * indicator_power_clock_get_default (void);
+
+void   indicator_power_clock_set_default        (IndicatorPowerClock * clock);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_CLOCK__H__ */
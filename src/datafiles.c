@@ -19,53 +19,188 @@
 
 #include "datafiles.h"
 
-static const gchar*
-get_directory_prefix_for_type (DatafileType type)
+#include <string.h> /* strchr() */
+
+/* the subdirectory of $XDG_DATA_DIR/indicator-power/ for each type */
+static const gchar* const type_subdirs[N_DATAFILE_TYPES] =
+{
+  "sounds" /* DATAFILE_TYPE_SOUND */
+};
+
+typedef struct
+{
+  /* basename --> path of the highest-priority match, or NULL if not built */
+  GHashTable * files;
+
+  /* one per search directory, kept for the life of the process */
+  GPtrArray * monitors;
+}
+DatafileIndex;
+
+static DatafileIndex indices[N_DATAFILE_TYPES];
+
+/***
+****
+***/
+
+static gchar**
+get_search_dirs (DatafileType type)
+{
+  const gchar * const * system_data_dirs = g_get_system_data_dirs();
+  GPtrArray * dirs = g_ptr_array_new();
+  gsize i;
+
+  g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), GETTEXT_PACKAGE, type_subdirs[type], NULL));
+  for (i=0; system_data_dirs && system_data_dirs[i]; ++i)
+    g_ptr_array_add(dirs, g_build_filename(system_data_dirs[i], GETTEXT_PACKAGE, type_subdirs[type], NULL));
+  g_ptr_array_add(dirs, NULL);
+
+  return (gchar**) g_ptr_array_free(dirs, FALSE);
+}
+
+static void
+on_directory_changed (GFileMonitor      * monitor  G_GNUC_UNUSED,
+                      GFile             * file     G_GNUC_UNUSED,
+                      GFile             * other    G_GNUC_UNUSED,
+                      GFileMonitorEvent   event,
+                      gpointer            gindex)
 {
-  switch (type)
+  DatafileIndex * index = gindex;
+
+  switch (event)
     {
-      case DATAFILE_TYPE_SOUND:
-        return "sounds";
+      case G_FILE_MONITOR_EVENT_CREATED:
+      case G_FILE_MONITOR_EVENT_DELETED:
+      case G_FILE_MONITOR_EVENT_MOVED:
+      case G_FILE_MONITOR_EVENT_MOVED_IN:
+      case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      case G_FILE_MONITOR_EVENT_RENAMED:
+        g_debug("data directory changed; dropping its index");
+        g_clear_pointer(&index->files, g_hash_table_destroy);
+        break;
 
       default:
-        g_critical("unknown type");
-        return "";
+        break;
+    }
+}
+
+static void
+watch_directories (DatafileIndex * index, gchar ** dirs)
+{
+  gsize i;
+
+  index->monitors = g_ptr_array_new_with_free_func(g_object_unref);
+
+  for (i=0; dirs[i]; ++i)
+    {
+      GError * error = NULL;
+      GFile * file = g_file_new_for_path(dirs[i]);
+      GFileMonitor * monitor = g_file_monitor_directory(file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+
+      if (monitor != NULL)
+        {
+          g_signal_connect(monitor, "changed", G_CALLBACK(on_directory_changed), index);
+          g_ptr_array_add(index->monitors, monitor);
+        }
+      else
+        {
+          g_debug("Unable to watch \"%s\": %s", dirs[i], error->message);
+          g_clear_error(&error);
+        }
+
+      g_object_unref(file);
+    }
+}
+
+static void
+build_index (DatafileIndex * index, gchar ** dirs)
+{
+  gsize i;
+
+  index->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  for (i=0; dirs[i]; ++i)
+    {
+      GDir * dir;
+      const gchar * name;
+
+      g_debug("indexing \"%s\"", dirs[i]);
+      if ((dir = g_dir_open(dirs[i], 0, NULL)) == NULL)
+        continue;
+
+      /* earlier directories take precedence */
+      while ((name = g_dir_read_name(dir)))
+        if (!g_hash_table_contains(index->files, name))
+          g_hash_table_insert(index->files, g_strdup(name), g_build_filename(dirs[i], name, NULL));
+
+      g_dir_close(dir);
+    }
+}
+
+static DatafileIndex*
+get_index (DatafileType type)
+{
+  DatafileIndex * index = &indices[type];
+
+  if (index->files == NULL)
+    {
+      gchar ** dirs = get_search_dirs(type);
+
+      /* watch before listing, so that we can't miss a change in between */
+      if (index->monitors == NULL)
+        watch_directories(index, dirs);
+
+      build_index(index, dirs);
+      g_strfreev(dirs);
     }
+
+  return index;
 }
 
+/***
+****
+***/
+
 static gchar*
-test_directory_for_file(const char* dir, DatafileType type, const char* basename)
+find_uncached (DatafileType type, const char * basename)
 {
-  gchar* filename = g_build_filename(dir,
-                                     GETTEXT_PACKAGE,
-                                     get_directory_prefix_for_type(type),
-                                     basename,
-                                     NULL);
-
-  g_debug("looking for \"%s\" at \"%s\"", basename, filename);
-  if (g_file_test(filename, G_FILE_TEST_EXISTS))
-    return filename;
-
-  g_free(filename);
-  return NULL;
+  gchar ** dirs = get_search_dirs(type);
+  gchar * filename = NULL;
+  gsize i;
+
+  for (i=0; filename==NULL && dirs[i]; ++i)
+    {
+      filename = g_build_filename(dirs[i], basename, NULL);
+      g_debug("looking for \"%s\" at \"%s\"", basename, filename);
+      if (!g_file_test(filename, G_FILE_TEST_EXISTS))
+        g_clear_pointer(&filename, g_free);
+    }
+
+  g_strfreev(dirs);
+  return filename;
 }
 
 gchar*
 datafile_find(DatafileType type, const char * basename)
 {
-  gchar * filename;
-  const gchar * user_data_dir;
-  const gchar * const * system_data_dirs;
-  gsize i;
+  g_return_val_if_fail((guint)type < N_DATAFILE_TYPES, NULL);
+  g_return_val_if_fail(basename != NULL, NULL);
 
-  user_data_dir = g_get_user_data_dir();
-  if ((filename = test_directory_for_file(user_data_dir, type, basename)))
-    return filename;
-  
-  system_data_dirs = g_get_system_data_dirs();
-  for (i=0; system_data_dirs && system_data_dirs[i]; ++i)
-    if ((filename = test_directory_for_file(system_data_dirs[i], type, basename)))
-      return filename;
+  /* the index only covers the top level of each directory */
+  if (strchr(basename, G_DIR_SEPARATOR) != NULL)
+    return find_uncached(type, basename);
 
-  return NULL;
+  return g_strdup(g_hash_table_lookup(get_index(type)->files, basename));
+}
+
+void
+datafile_clear_cache(void)
+{
+  gsize i;
+
+  for (i=0; i<N_DATAFILE_TYPES; ++i)
+    {
+      g_clear_pointer(&indices[i].files, g_hash_table_destroy);
+      g_clear_pointer(&indices[i].monitors, g_ptr_array_unref);
+    }
 }
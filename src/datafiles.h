@@ -24,14 +24,27 @@
 
 G_BEGIN_DECLS
 
-typedef enum 
+typedef enum
 {
-  DATAFILE_TYPE_SOUND
+  DATAFILE_TYPE_SOUND,
+  N_DATAFILE_TYPES
 }
 DatafileType;
 
+/**
+ * Look for basename in the user's and then the system's data directories.
+ *
+ * Each type's directories are indexed on first use and watched with
+ * GFileMonitors, so lookups after the first are served from memory
+ * until one of those directories changes.
+ *
+ * Returns: (transfer full): the file's path, or NULL if not found
+ */
 gchar* datafile_find(DatafileType type, const char * basename);
 
+/* drop all the indices, e.g. after changing XDG_DATA_DIRS */
+void datafile_clear_cache(void);
+
 G_END_DECLS
 
 #endif /* __INDICATOR_POWER_DATAFILES_H__ */
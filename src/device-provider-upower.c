@@ -17,9 +17,12 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "clock.h"
 #include "device.h"
 #include "device-provider.h"
 #include "device-provider-upower.h"
+#include "metrics.h"
+#include "recorder.h"
 
 #define BUS_NAME "org.freedesktop.UPower"
 
@@ -36,6 +39,7 @@ typedef struct
 {
   GDBusConnection * bus;
   GCancellable * cancellable;
+  IndicatorPowerClock * clock;
 
   /* dbus object path --> IndicatorPowerDevice */
   GHashTable * devices;
@@ -92,6 +96,7 @@ static void
 on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
 {
   struct device_get_all_data * data = gdata;
+  const gint64 begin = indicator_power_metrics_handler_begin ();
   GError * error;
   GVariant * response;
 
@@ -99,6 +104,9 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
   response = g_dbus_connection_call_finish (G_DBUS_CONNECTION(o), res, &error);
   if (error != NULL)
     {
+      indicator_power_metrics_inc (METRIC_GET_ALL_REPLIES_DROPPED);
+      indicator_power_recorder_record (RECORD_GET_ALL_FAILED, g_str_hash (data->path));
+
       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         g_warning ("Error getting properties for UPower device '%s': %s",
                    data->path, error->message);
@@ -118,6 +126,8 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
       priv_t * p = get_priv(data->self);
       GVariant * dict = g_variant_get_child_value (response, 0);
 
+      indicator_power_recorder_record (RECORD_GET_ALL_RECEIVED, g_str_hash (data->path));
+
       g_variant_lookup (dict, "Type", "u", &kind);
       g_variant_lookup (dict, "State", "u", &state);
       g_variant_lookup (dict, "Percentage", "d", &percentage);
@@ -159,6 +169,7 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
 
   g_free (data->path);
   g_slice_free (struct device_get_all_data, data);
+  indicator_power_metrics_handler_end (G_STRFUNC, begin);
 }
 
 static void
@@ -178,6 +189,8 @@ update_device_from_object_path (IndicatorPowerDeviceProviderUPower * self,
   data->path = g_strdup (path);
   data->self = self;
 
+  indicator_power_metrics_inc (METRIC_GET_ALL_CALLS);
+  indicator_power_recorder_record (RECORD_GET_ALL_SENT, g_str_hash (path));
   g_dbus_connection_call(p->bus,
                          BUS_NAME,
                          path,
@@ -234,7 +247,7 @@ refresh_device_soon (IndicatorPowerDeviceProviderUPower * self,
   g_hash_table_add (p->queued_paths, g_strdup (object_path));
 
   if (p->queued_paths_timer == 0)
-    p->queued_paths_timer = g_timeout_add (500, on_queued_paths_timer, self);
+    p->queued_paths_timer = indicator_power_clock_timeout_add (p->clock, 500, on_queued_paths_timer, self);
 }
 
 /***
@@ -284,10 +297,13 @@ on_device_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
                              GVariant        * parameters,
                              gpointer          gself)
 {
+  const gint64 begin = indicator_power_metrics_handler_begin ();
   IndicatorPowerDeviceProviderUPower* self;
   priv_t* p;
   IndicatorPowerDevice* device;
 
+  indicator_power_metrics_inc (METRIC_PROVIDER_SIGNALS);
+  indicator_power_recorder_record (RECORD_PROVIDER_SIGNAL, g_str_hash (object_path));
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
   p = get_priv(self);
 
@@ -349,6 +365,8 @@ on_device_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
       if (changed)
         emit_devices_changed(self);
     }
+
+  indicator_power_metrics_handler_end (G_STRFUNC, begin);
 }
 
 static const gchar*
@@ -373,15 +391,18 @@ get_path_from_nth_child(GVariant* parameters, gsize i)
 static void
 on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
                  const gchar     * sender_name    G_GNUC_UNUSED,
-                 const gchar     * object_path    G_GNUC_UNUSED,
+                 const gchar     * object_path,
                  const gchar     * interface_name G_GNUC_UNUSED,
                  const gchar     * signal_name,
                  GVariant        * parameters,
                  gpointer          gself)
 {
+  const gint64 begin = indicator_power_metrics_handler_begin ();
   IndicatorPowerDeviceProviderUPower * self;
   priv_t * p;
 
+  indicator_power_metrics_inc (METRIC_PROVIDER_SIGNALS);
+  indicator_power_recorder_record (RECORD_PROVIDER_SIGNAL, g_str_hash (object_path));
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
   p = get_priv(self);
 
@@ -409,6 +430,8 @@ on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
       while (g_hash_table_iter_next (&iter, &device_path, NULL))
         refresh_device_soon (self, device_path);
     }
+
+  indicator_power_metrics_handler_end (G_STRFUNC, begin);
 }
 
 /* start listening for UPower events on the bus */
@@ -484,7 +507,7 @@ on_bus_name_vanished(GDBusConnection * connection G_GNUC_UNUSED,
   g_hash_table_remove_all(p->queued_paths);
   if (p->queued_paths_timer != 0)
     {
-      g_source_remove(p->queued_paths_timer);
+      indicator_power_clock_source_remove(p->clock, p->queued_paths_timer);
       p->queued_paths_timer = 0;
     }
   emit_devices_changed (self);
@@ -540,7 +563,7 @@ my_dispose (GObject * o)
 
   if (p->queued_paths_timer != 0)
     {
-      g_source_remove (p->queued_paths_timer);
+      indicator_power_clock_source_remove (p->clock, p->queued_paths_timer);
 
       p->queued_paths_timer = 0;
     }
@@ -567,6 +590,7 @@ my_finalize (GObject * o)
 
   g_hash_table_destroy (p->devices);
   g_hash_table_destroy (p->queued_paths);
+  g_clear_object (&p->clock);
 
   G_OBJECT_CLASS (indicator_power_device_provider_upower_parent_class)->finalize (o);
 }
@@ -597,6 +621,8 @@ indicator_power_device_provider_upower_init (IndicatorPowerDeviceProviderUPower
 
   p->cancellable = g_cancellable_new();
 
+  p->clock = g_object_ref (indicator_power_clock_get_default ());
+
   p->devices = g_hash_table_new_full(g_str_hash,
                                      g_str_equal,
                                      g_free,
@@ -18,6 +18,7 @@
  */
 
 #include "device-provider.h"
+#include "metrics.h"
 
 enum
 {
@@ -86,5 +87,6 @@ indicator_power_device_provider_emit_devices_changed (IndicatorPowerDeviceProvid
 {
   g_return_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER (self));
 
+  indicator_power_metrics_inc (METRIC_DEVICES_CHANGED);
   g_signal_emit (self, signals[SIGNAL_DEVICES_CHANGED], 0, NULL);
 }
@@ -28,6 +28,7 @@ License along with this library. If not, see
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
 
+#include "clock.h"
 #include "device.h"
 
 struct _IndicatorPowerDevicePrivate
@@ -41,7 +42,7 @@ struct _IndicatorPowerDevicePrivate
   /* Timestamp of when when we first noticed that upower couldn't estimate
      the time-remaining field for this device, or 0 if not applicable.
      This is used when generating the time-remaining string. */
-  GTimer * inestimable;
+  gint64 inestimable;
   gboolean power_supply;
 };
 
@@ -63,7 +64,6 @@ static GParamSpec * properties[N_PROPERTIES];
 /* GObject stuff */
 static void indicator_power_device_class_init (IndicatorPowerDeviceClass *klass);
 static void indicator_power_device_init       (IndicatorPowerDevice *self);
-static void indicator_power_device_dispose    (GObject *object);
 static void indicator_power_device_finalize   (GObject *object);
 static void set_property (GObject*, guint prop_id, const GValue*, GParamSpec* );
 static void get_property (GObject*, guint prop_id,       GValue*, GParamSpec* );
@@ -79,7 +79,6 @@ indicator_power_device_class_init (IndicatorPowerDeviceClass *klass)
 
   g_type_class_add_private (klass, sizeof (IndicatorPowerDevicePrivate));
 
-  object_class->dispose = indicator_power_device_dispose;
   object_class->finalize = indicator_power_device_finalize;
   object_class->set_property = set_property;
   object_class->get_property = get_property;
@@ -145,17 +144,6 @@ indicator_power_device_init (IndicatorPowerDevice *self)
   self->priv = priv;
 }
 
-static void
-indicator_power_device_dispose (GObject *object)
-{
-  IndicatorPowerDevice * self = INDICATOR_POWER_DEVICE(object);
-  IndicatorPowerDevicePrivate * p = self->priv;
-
-  g_clear_pointer (&p->inestimable, g_timer_destroy);
-
-  G_OBJECT_CLASS (indicator_power_device_parent_class)->dispose (object);
-}
-
 static void
 indicator_power_device_finalize (GObject *object)
 {
@@ -249,7 +237,7 @@ set_property (GObject * o, guint prop_id, const GValue * value, GParamSpec * psp
 
   /**
    * Check to see if the time-remaining value is estimable.
-   * When it first becomes inestimable, kick off a timer because
+   * When it first becomes inestimable, note the time because
    * we need to track that to generate the appropriate title text.
    */
 
@@ -259,11 +247,11 @@ set_property (GObject * o, guint prop_id, const GValue * value, GParamSpec * psp
 
   if (!is_inestimable)
     {
-      g_clear_pointer (&p->inestimable, g_timer_destroy);
+      p->inestimable = 0;
     }
-  else if (p->inestimable == NULL)
+  else if (p->inestimable == 0)
     {
-      p->inestimable = g_timer_new ();
+      p->inestimable = indicator_power_clock_get_monotonic_time (indicator_power_clock_get_default ());
     }
 }
 
@@ -599,9 +587,10 @@ get_brief_time_remaining (const IndicatorPowerDevice * device)
 
       str = g_strdup_printf("%0d:%02d", hours, minutes);
     }
-  else if (p->inestimable != NULL)
+  else if (p->inestimable != 0)
     {
-      const double elapsed = g_timer_elapsed (p->inestimable, NULL);
+      const gint64 now = indicator_power_clock_get_monotonic_time (indicator_power_clock_get_default ());
+      const double elapsed = (now - p->inestimable) / (double)G_USEC_PER_SEC;
 
       if (elapsed < 30)
         {
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "icon-theme.h"
+
+#include <string.h> /* strrchr() */
+
+#define INTERFACE_SCHEMA "org.gnome.desktop.interface"
+#define INTERFACE_ICON_THEME_KEY "icon-theme"
+#define FALLBACK_THEME "hicolor"
+#define THEME_GROUP "Icon Theme"
+
+enum
+{
+  SIGNAL_CHANGED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+typedef struct
+{
+  /* if NULL, follow interface_settings */
+  gchar * theme_name;
+  GSettings * interface_settings;
+
+  /* one set of icon names for each theme in the order they're searched,
+     with the unthemed pixmaps last. NULL when it needs to be rebuilt */
+  GPtrArray * themes;
+
+  /* watching the directories that went into the current index */
+  GPtrArray * monitors;
+}
+IndicatorPowerIconThemePrivate;
+
+typedef IndicatorPowerIconThemePrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerIconTheme,
+                           indicator_power_icon_theme,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_icon_theme_get_instance_private(o))
+
+/***
+****  Invalidation
+***/
+
+static void
+invalidate (IndicatorPowerIconTheme * self)
+{
+  priv_t * p = get_priv (self);
+
+  /* if nobody's looked since the last change, there's nothing new to say */
+  if (p->themes == NULL)
+    return;
+
+  g_debug ("icon theme changed; dropping its index");
+  g_clear_pointer (&p->themes, g_ptr_array_unref);
+  g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+}
+
+static void
+on_directory_changed (GFileMonitor      * monitor  G_GNUC_UNUSED,
+                      GFile             * file     G_GNUC_UNUSED,
+                      GFile             * other    G_GNUC_UNUSED,
+                      GFileMonitorEvent   event,
+                      gpointer            gself)
+{
+  switch (event)
+    {
+      case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+      case G_FILE_MONITOR_EVENT_CREATED:
+      case G_FILE_MONITOR_EVENT_DELETED:
+      case G_FILE_MONITOR_EVENT_MOVED:
+      case G_FILE_MONITOR_EVENT_MOVED_IN:
+      case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      case G_FILE_MONITOR_EVENT_RENAMED:
+        invalidate (INDICATOR_POWER_ICON_THEME (gself));
+        break;
+
+      default:
+        break;
+    }
+}
+
+static void
+watch_directory (IndicatorPowerIconTheme * self, const gchar * path)
+{
+  GError * error = NULL;
+  GFile * file = g_file_new_for_path (path);
+  GFileMonitor * monitor = g_file_monitor_directory (file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+
+  if (monitor != NULL)
+    {
+      g_signal_connect (monitor, "changed", G_CALLBACK(on_directory_changed), self);
+      g_ptr_array_add (get_priv (self)->monitors, monitor);
+    }
+  else
+    {
+      g_debug ("Unable to watch \"%s\": %s", path, error->message);
+      g_clear_error (&error);
+    }
+
+  g_object_unref (file);
+}
+
+/***
+****  Indexing
+***/
+
+/* the directories that hold icon themes, in the order GTK+ searches them */
+static gchar **
+get_base_dirs (void)
+{
+  const gchar * const * system_data_dirs = g_get_system_data_dirs ();
+  GPtrArray * dirs = g_ptr_array_new ();
+  gsize i;
+
+  g_ptr_array_add (dirs, g_build_filename (g_get_user_data_dir (), "icons", NULL));
+  g_ptr_array_add (dirs, g_build_filename (g_get_home_dir (), ".icons", NULL));
+  for (i=0; system_data_dirs && system_data_dirs[i]; ++i)
+    g_ptr_array_add (dirs, g_build_filename (system_data_dirs[i], "icons", NULL));
+  g_ptr_array_add (dirs, NULL);
+
+  return (gchar **) g_ptr_array_free (dirs, FALSE);
+}
+
+/* add the names of the icon files in path to the icons set */
+static void
+index_directory (GHashTable * icons, const gchar * path)
+{
+  GDir * dir;
+  const gchar * name;
+
+  if ((dir = g_dir_open (path, 0, NULL)) == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      const gchar * ext = strrchr (name, '.');
+
+      if ((ext != NULL) && (!g_strcmp0 (ext, ".png") || !g_strcmp0 (ext, ".svg") || !g_strcmp0 (ext, ".xpm")))
+        g_hash_table_add (icons, g_strndup (name, ext - name));
+    }
+
+  g_dir_close (dir);
+}
+
+static GKeyFile *
+load_theme_index (gchar ** base_dirs, const gchar * name)
+{
+  GKeyFile * key_file = g_key_file_new ();
+  gsize i;
+
+  for (i=0; base_dirs[i]; ++i)
+    {
+      gchar * filename = g_build_filename (base_dirs[i], name, "index.theme", NULL);
+      const gboolean loaded = g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+      g_free (filename);
+
+      if (loaded)
+        return key_file;
+    }
+
+  g_key_file_free (key_file);
+  return NULL;
+}
+
+/* index a theme, then its parents depth-first, as GTK+ searches them */
+static void
+add_theme (IndicatorPowerIconTheme * self,
+           gchar                  ** base_dirs,
+           const gchar             * name,
+           GHashTable              * visited)
+{
+  priv_t * p = get_priv (self);
+  GKeyFile * key_file;
+  gchar ** subdirs;
+  gchar ** parents;
+  GHashTable * icons;
+  gsize i;
+  gsize j;
+
+  if (g_hash_table_contains (visited, name))
+    return;
+  g_hash_table_add (visited, g_strdup (name));
+
+  if ((key_file = load_theme_index (base_dirs, name)) == NULL)
+    {
+      g_debug ("no icon theme named \"%s\"", name);
+      return;
+    }
+
+  g_debug ("indexing icon theme \"%s\"", name);
+  subdirs = g_key_file_get_string_list (key_file, THEME_GROUP, "Directories", NULL, NULL);
+  parents = g_key_file_get_string_list (key_file, THEME_GROUP, "Inherits", NULL, NULL);
+  icons = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* the index applies to that theme's folder in every base directory */
+  for (i=0; base_dirs[i]; ++i)
+    {
+      gchar * theme_dir = g_build_filename (base_dirs[i], name, NULL);
+
+      if (g_file_test (theme_dir, G_FILE_TEST_IS_DIR))
+        {
+          /* icon installs end by updating the theme's icon-theme.cache,
+             so watching the theme's top level is enough to notice them */
+          watch_directory (self, theme_dir);
+
+          for (j=0; subdirs && subdirs[j]; ++j)
+            {
+              gchar * path = g_build_filename (theme_dir, subdirs[j], NULL);
+              index_directory (icons, path);
+              g_free (path);
+            }
+        }
+
+      g_free (theme_dir);
+    }
+
+  g_ptr_array_add (p->themes, icons);
+
+  for (i=0; parents && parents[i]; ++i)
+    add_theme (self, base_dirs, parents[i], visited);
+
+  g_strfreev (parents);
+  g_strfreev (subdirs);
+  g_key_file_free (key_file);
+}
+
+static gchar *
+get_theme_name (IndicatorPowerIconTheme * self)
+{
+  priv_t * p = get_priv (self);
+
+  if (p->theme_name != NULL)
+    return g_strdup (p->theme_name);
+
+  if (p->interface_settings != NULL)
+    return g_settings_get_string (p->interface_settings, INTERFACE_ICON_THEME_KEY);
+
+  return g_strdup (FALLBACK_THEME);
+}
+
+static GPtrArray *
+get_themes (IndicatorPowerIconTheme * self)
+{
+  priv_t * p = get_priv (self);
+
+  if (p->themes == NULL)
+    {
+      const gchar * const * system_data_dirs = g_get_system_data_dirs ();
+      gchar ** base_dirs = get_base_dirs ();
+      gchar * name = get_theme_name (self);
+      GHashTable * visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      GHashTable * pixmaps;
+      gsize i;
+
+      /* start watching afresh with the new index */
+      g_clear_pointer (&p->monitors, g_ptr_array_unref);
+      p->monitors = g_ptr_array_new_with_free_func (g_object_unref);
+      for (i=0; base_dirs[i]; ++i)
+        if (g_file_test (base_dirs[i], G_FILE_TEST_IS_DIR))
+          watch_directory (self, base_dirs[i]);
+
+      p->themes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_destroy);
+      add_theme (self, base_dirs, name, visited);
+      add_theme (self, base_dirs, FALLBACK_THEME, visited);
+
+      /* unthemed icons are looked for after every theme */
+      pixmaps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      for (i=0; system_data_dirs && system_data_dirs[i]; ++i)
+        {
+          gchar * path = g_build_filename (system_data_dirs[i], "pixmaps", NULL);
+          index_directory (pixmaps, path);
+          g_free (path);
+        }
+      g_ptr_array_add (p->themes, pixmaps);
+
+      g_hash_table_destroy (visited);
+      g_free (name);
+      g_strfreev (base_dirs);
+    }
+
+  return p->themes;
+}
+
+/***
+****  GObject boilerplate
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerIconTheme * self = INDICATOR_POWER_ICON_THEME (o);
+  priv_t * p = get_priv (self);
+
+  if (p->interface_settings != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->interface_settings, self);
+      g_clear_object (&p->interface_settings);
+    }
+
+  g_clear_pointer (&p->monitors, g_ptr_array_unref);
+  g_clear_pointer (&p->themes, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (indicator_power_icon_theme_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_ICON_THEME (o));
+
+  g_free (p->theme_name);
+
+  G_OBJECT_CLASS (indicator_power_icon_theme_parent_class)->finalize (o);
+}
+
+static void
+indicator_power_icon_theme_class_init (IndicatorPowerIconThemeClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+
+  signals[SIGNAL_CHANGED] = g_signal_new (
+    INDICATOR_POWER_ICON_THEME_SIGNAL_CHANGED,
+    G_TYPE_FROM_CLASS(klass),
+    G_SIGNAL_RUN_LAST,
+    G_STRUCT_OFFSET (IndicatorPowerIconThemeClass, changed),
+    NULL, NULL,
+    g_cclosure_marshal_VOID__VOID,
+    G_TYPE_NONE, 0);
+}
+
+static void
+indicator_power_icon_theme_init (IndicatorPowerIconTheme * self G_GNUC_UNUSED)
+{
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerIconTheme *
+indicator_power_icon_theme_new (const gchar * theme_name)
+{
+  IndicatorPowerIconTheme * self = g_object_new (INDICATOR_TYPE_POWER_ICON_THEME, NULL);
+  priv_t * p = get_priv (self);
+
+  p->theme_name = g_strdup (theme_name);
+
+  if (theme_name == NULL)
+    {
+      GSettingsSchemaSource * source = g_settings_schema_source_get_default ();
+      GSettingsSchema * schema = NULL;
+
+      if (source != NULL)
+        schema = g_settings_schema_source_lookup (source, INTERFACE_SCHEMA, TRUE);
+
+      if (schema != NULL)
+        {
+          p->interface_settings = g_settings_new (INTERFACE_SCHEMA);
+          g_signal_connect_swapped (p->interface_settings, "changed::" INTERFACE_ICON_THEME_KEY,
+                                    G_CALLBACK(invalidate), self);
+          g_settings_schema_unref (schema);
+        }
+    }
+
+  return self;
+}
+
+gboolean
+indicator_power_icon_theme_has_icon (IndicatorPowerIconTheme * self,
+                                     const gchar             * icon_name)
+{
+  GPtrArray * themes;
+  guint i;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_ICON_THEME (self), FALSE);
+  g_return_val_if_fail (icon_name != NULL, FALSE);
+
+  themes = get_themes (self);
+  for (i=0; i<themes->len; ++i)
+    if (g_hash_table_contains (g_ptr_array_index (themes, i), icon_name))
+      return TRUE;
+
+  return FALSE;
+}
+
+GIcon *
+indicator_power_icon_theme_choose_icon (IndicatorPowerIconTheme * self,
+                                        const gchar * const     * names)
+{
+  GPtrArray * themes;
+  guint i;
+  gsize j;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_ICON_THEME (self), NULL);
+
+  /* same order as gtk_icon_theme_choose_icon(): each theme in turn,
+     trying all of the names in each one before moving on */
+  themes = get_themes (self);
+  for (i=0; i<themes->len; ++i)
+    for (j=0; names && names[j]; ++j)
+      if (g_hash_table_contains (g_ptr_array_index (themes, i), names[j]))
+        return g_themed_icon_new (names[j]);
+
+  return NULL;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_ICON_THEME_H__
+#define __INDICATOR_POWER_ICON_THEME_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_ICON_THEME          (indicator_power_icon_theme_get_type())
+#define INDICATOR_POWER_ICON_THEME(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_ICON_THEME, IndicatorPowerIconTheme))
+#define INDICATOR_IS_POWER_ICON_THEME(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_ICON_THEME))
+
+typedef struct _IndicatorPowerIconTheme        IndicatorPowerIconTheme;
+typedef struct _IndicatorPowerIconThemeClass   IndicatorPowerIconThemeClass;
+
+/* signal keys */
+#define INDICATOR_POWER_ICON_THEME_SIGNAL_CHANGED "changed"
+
+/**
+ * An index of which icon names an icon theme, its parents,
+ * and hicolor provide, so that the service can pick one name
+ * from a list of fallbacks instead of every client doing it.
+ *
+ * The index is built on first use and dropped when one of the
+ * theme directories or the desktop's icon theme setting changes.
+ * "changed" is emitted once each time that happens.
+ */
+struct _IndicatorPowerIconTheme
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerIconThemeClass
+{
+  GObjectClass parent_class;
+
+  /* signals */
+  void (*changed) (IndicatorPowerIconTheme * self);
+};
+
+GType indicator_power_icon_theme_get_type (void);
+
+/* theme_name NULL means to follow the desktop's icon theme setting */
+IndicatorPowerIconTheme * indicator_power_icon_theme_new (const gchar * theme_name);
+
+gboolean indicator_power_icon_theme_has_icon (IndicatorPowerIconTheme * self,
+                                              const gchar             * icon_name);
+
+/**
+ * Pick the icon a client would find first in names,
+ * searching the theme and then each of its parents in turn.
+ *
+ * Returns: (transfer full): a GThemedIcon with just that one name,
+ *          or NULL if none of the names are in the theme.
+ */
+GIcon * indicator_power_icon_theme_choose_icon (IndicatorPowerIconTheme * self,
+                                                const gchar * const     * names);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_ICON_THEME_H__ */
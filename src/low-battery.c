@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "low-battery.h"
+
+/* the highest charge at each level */
+static const gdouble thresholds[POWER_LEVEL_OK] =
+{
+  2.0,  /* POWER_LEVEL_CRITICAL */
+  5.0,  /* POWER_LEVEL_VERY_LOW */
+  10.0  /* POWER_LEVEL_LOW */
+};
+
+PowerLevel
+indicator_power_low_battery_get_level_for_percentage (gdouble percentage)
+{
+  int i;
+
+  for (i=POWER_LEVEL_CRITICAL; i<POWER_LEVEL_OK; ++i)
+    if (percentage <= thresholds[i])
+      return (PowerLevel) i;
+
+  return POWER_LEVEL_OK;
+}
+
+void
+indicator_power_low_battery_init (IndicatorPowerLowBattery * self)
+{
+  self->hysteresis = LOW_BATTERY_DEFAULT_HYSTERESIS;
+  self->renotify_usec = LOW_BATTERY_DEFAULT_RENOTIFY_SEC * G_USEC_PER_SEC;
+  self->notified = FALSE;
+  self->notified_is_forecast = FALSE;
+  self->notified_level = POWER_LEVEL_OK;
+  self->notified_time = 0;
+  indicator_power_low_battery_reset (self);
+}
+
+void
+indicator_power_low_battery_reset (IndicatorPowerLowBattery * self)
+{
+  self->level = POWER_LEVEL_OK;
+  self->level_is_forecast = FALSE;
+  self->discharging = FALSE;
+  self->rate = 0;
+  self->sample_percentage = 0;
+  self->sample_time = 0;
+}
+
+static PowerLevel
+get_next_level (const IndicatorPowerLowBattery * self, gdouble percentage)
+{
+  const PowerLevel raw = indicator_power_low_battery_get_level_for_percentage (percentage);
+  PowerLevel level = self->level;
+
+  /* getting worse happens right away, as does backing out
+     of a level that the battery never actually reported... */
+  if ((raw <= level) || self->level_is_forecast)
+    return raw;
+
+  /* ...but getting better needs to clear the band above each threshold */
+  while ((level < raw) && (percentage >= thresholds[level] + self->hysteresis))
+    ++level;
+
+  return level;
+}
+
+static gboolean
+renotify_allowed (const IndicatorPowerLowBattery * self, PowerLevel level, gint64 now)
+{
+  return !self->notified
+      || (level < self->notified_level)
+      || (now - self->notified_time >= self->renotify_usec);
+}
+
+gboolean
+indicator_power_low_battery_is_relevant (const IndicatorPowerLowBattery * self,
+                                         gdouble                          percentage,
+                                         gboolean                         discharging)
+{
+  /* a forecast level stays relevant until a real sample confirms it */
+  return self->level_is_forecast
+      || (!discharging != !self->discharging)
+      || (get_next_level (self, percentage) != self->level);
+}
+
+/***
+****  Forecasting
+***/
+
+/* how much weight a new rate sample gets */
+#define RATE_SMOOTHING 0.3
+
+void
+indicator_power_low_battery_sample (IndicatorPowerLowBattery * self,
+                                    gdouble                    percentage,
+                                    gboolean                   discharging,
+                                    gint64                     now_usec)
+{
+  if (!discharging)
+    {
+      self->rate = 0;
+      self->sample_time = 0;
+      return;
+    }
+
+  if ((self->sample_time != 0) && (percentage < self->sample_percentage) && (now_usec > self->sample_time))
+    {
+      const gdouble seconds = (now_usec - self->sample_time) / (gdouble)G_USEC_PER_SEC;
+      const gdouble rate = (self->sample_percentage - percentage) / seconds;
+
+      if (self->rate > 0)
+        self->rate = RATE_SMOOTHING*rate + (1.0-RATE_SMOOTHING)*self->rate;
+      else
+        self->rate = rate;
+    }
+
+  /* only take a new sample when the charge moves,
+     so that repeated reports of the same value don't skew the rate */
+  if ((self->sample_time == 0) || (percentage != self->sample_percentage))
+    {
+      self->sample_percentage = percentage;
+      self->sample_time = now_usec;
+    }
+}
+
+gdouble
+indicator_power_low_battery_get_forecast_percentage (const IndicatorPowerLowBattery * self,
+                                                     gint64                           now_usec)
+{
+  if ((self->rate <= 0) || (self->sample_time == 0))
+    return -1;
+
+  return MAX (0.0, self->sample_percentage - self->rate * (now_usec - self->sample_time) / G_USEC_PER_SEC);
+}
+
+gint64
+indicator_power_low_battery_get_time_until (const IndicatorPowerLowBattery * self,
+                                            PowerLevel                       level,
+                                            gint64                           now_usec)
+{
+  gdouble percentage;
+
+  g_return_val_if_fail (level < POWER_LEVEL_OK, -1);
+
+  if ((percentage = indicator_power_low_battery_get_forecast_percentage (self, now_usec)) < 0)
+    return -1;
+
+  if (percentage <= thresholds[level])
+    return 0;
+
+  return (gint64) ((percentage - thresholds[level]) / self->rate * G_USEC_PER_SEC);
+}
+
+PowerLevel
+indicator_power_low_battery_get_next_level (const IndicatorPowerLowBattery * self)
+{
+  return self->level > POWER_LEVEL_CRITICAL ? self->level - 1 : POWER_LEVEL_OK;
+}
+
+/***
+****
+***/
+
+IndicatorPowerLowBatteryAction
+indicator_power_low_battery_update (IndicatorPowerLowBattery * self,
+                                    gdouble                    percentage,
+                                    gboolean                   discharging,
+                                    gint64                     now_usec)
+{
+  const PowerLevel old_level = self->level;
+  const gboolean old_discharging = self->discharging;
+  const PowerLevel new_level = get_next_level (self, percentage);
+  IndicatorPowerLowBatteryAction action = LOW_BATTERY_ACTION_NONE;
+
+  /* pop up a 'low battery' notification if either:
+     a) it's already discharging, and its PowerLevel worsens, OR
+     b) it's already got a bad PowerLevel and its state becomes 'discharging */
+  if ((discharging && (old_level > new_level)) ||
+      ((new_level != POWER_LEVEL_OK) && discharging && !old_discharging))
+    {
+      if (renotify_allowed (self, new_level, now_usec))
+        {
+          action = LOW_BATTERY_ACTION_SHOW;
+          self->notified = TRUE;
+          self->notified_is_forecast = FALSE;
+          self->notified_level = new_level;
+          self->notified_time = now_usec;
+        }
+    }
+  else if (!discharging || (new_level == POWER_LEVEL_OK))
+    {
+      action = LOW_BATTERY_ACTION_CLEAR;
+
+      /* a forecast that didn't pan out shouldn't delay the real warning */
+      if (self->notified_is_forecast)
+        {
+          self->notified = FALSE;
+          self->notified_is_forecast = FALSE;
+        }
+    }
+
+  self->level = new_level;
+  self->level_is_forecast = FALSE;
+  self->discharging = discharging;
+  return action;
+}
+
+IndicatorPowerLowBatteryAction
+indicator_power_low_battery_update_from_forecast (IndicatorPowerLowBattery * self,
+                                                  gdouble                    percentage,
+                                                  gint64                     now_usec)
+{
+  const PowerLevel old_level = self->level;
+  const gboolean old_is_forecast = self->level_is_forecast;
+  const IndicatorPowerLowBatteryAction action = indicator_power_low_battery_update (self, percentage, self->discharging, now_usec);
+
+  self->level_is_forecast = (self->level != old_level) ? TRUE : old_is_forecast;
+  if (action == LOW_BATTERY_ACTION_SHOW)
+    self->notified_is_forecast = TRUE;
+  return action;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_LOW_BATTERY_H__
+#define __INDICATOR_POWER_LOW_BATTERY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  POWER_LEVEL_CRITICAL,
+  POWER_LEVEL_VERY_LOW,
+  POWER_LEVEL_LOW,
+  POWER_LEVEL_OK
+}
+PowerLevel;
+
+typedef enum
+{
+  LOW_BATTERY_ACTION_NONE,
+  LOW_BATTERY_ACTION_SHOW,
+  LOW_BATTERY_ACTION_CLEAR
+}
+IndicatorPowerLowBatteryAction;
+
+/**
+ * The low-battery state machine that decides the battery's PowerLevel
+ * and when to show or clear a low-battery notification.
+ *
+ * A PowerLevel worsens as soon as the charge drops to its threshold,
+ * but only improves once the charge rises 'hysteresis' percent past it,
+ * so a battery hovering around a threshold doesn't flip back and forth.
+ *
+ * A notification that's been shown won't be shown again within
+ * 'renotify_usec' unless the PowerLevel gets worse, so a flapping
+ * AC adapter doesn't produce a stream of popups.
+ *
+ * It also keeps a smoothed discharge rate so that it can forecast when
+ * the next threshold will be crossed. The notifier uses that to arm a
+ * single timer instead of re-evaluating on every percentage change.
+ * A level that came from a forecast isn't held by hysteresis, so if
+ * the battery reports that it hasn't crossed the threshold after all,
+ * the level goes straight back. A notification shown for it doesn't
+ * hold back the next one once it's been cleared that way.
+ */
+typedef struct
+{
+  /* config */
+  gdouble hysteresis;
+  gint64 renotify_usec;
+
+  /* state */
+  PowerLevel level;
+  gboolean level_is_forecast;
+  gboolean discharging;
+  gboolean notified;
+  gboolean notified_is_forecast;
+  PowerLevel notified_level;
+  gint64 notified_time;
+
+  /* discharge forecast */
+  gdouble rate; /* percent per second, or 0 if unknown */
+  gdouble sample_percentage;
+  gint64 sample_time;
+}
+IndicatorPowerLowBattery;
+
+#define LOW_BATTERY_DEFAULT_HYSTERESIS 1.0
+#define LOW_BATTERY_DEFAULT_RENOTIFY_SEC 300
+
+void       indicator_power_low_battery_init   (IndicatorPowerLowBattery * self);
+
+/* forget the current battery, but not when we last notified */
+void       indicator_power_low_battery_reset  (IndicatorPowerLowBattery * self);
+
+IndicatorPowerLowBatteryAction
+           indicator_power_low_battery_update (IndicatorPowerLowBattery * self,
+                                               gdouble                    percentage,
+                                               gboolean                   discharging,
+                                               gint64                     now_usec);
+
+/* like update(), but with a charge from get_forecast_percentage() */
+IndicatorPowerLowBatteryAction
+           indicator_power_low_battery_update_from_forecast (IndicatorPowerLowBattery * self,
+                                                             gdouble                    percentage,
+                                                             gint64                     now_usec);
+
+/* feed the discharge rate estimator */
+void       indicator_power_low_battery_sample (IndicatorPowerLowBattery * self,
+                                               gdouble                    percentage,
+                                               gboolean                   discharging,
+                                               gint64                     now_usec);
+
+/* FALSE if update() with these values couldn't change anything */
+gboolean   indicator_power_low_battery_is_relevant (const IndicatorPowerLowBattery * self,
+                                                    gdouble                          percentage,
+                                                    gboolean                         discharging);
+
+/* the charge extrapolated from the last sample, or -1 if the rate's unknown */
+gdouble    indicator_power_low_battery_get_forecast_percentage (const IndicatorPowerLowBattery * self,
+                                                                gint64                           now_usec);
+
+/* usec until the charge reaches level's threshold, or -1 if unknown */
+gint64     indicator_power_low_battery_get_time_until (const IndicatorPowerLowBattery * self,
+                                                       PowerLevel                       level,
+                                                       gint64                           now_usec);
+
+/* the next level down from the current one, or POWER_LEVEL_OK if there isn't one */
+PowerLevel indicator_power_low_battery_get_next_level (const IndicatorPowerLowBattery * self);
+
+/* the level for a charge, without hysteresis */
+PowerLevel indicator_power_low_battery_get_level_for_percentage (gdouble percentage);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_LOW_BATTERY_H__ */
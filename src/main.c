@@ -21,11 +21,16 @@
 
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib-unix.h>
+
+#include <signal.h> /* SIGUSR1 */
 
 #include "device.h"
 #include "notifier.h"
+#include "recorder.h"
 #include "service.h"
 #include "testing.h"
+#include "watchdog.h"
 
 /***
 ****
@@ -38,6 +43,26 @@ on_name_lost (gpointer instance G_GNUC_UNUSED, gpointer loop)
   g_main_loop_quit ((GMainLoop*)loop);
 }
 
+static gboolean
+on_sigusr1 (gpointer unused G_GNUC_UNUSED)
+{
+  GError * error = NULL;
+  gchar * filename = g_build_filename (g_get_user_runtime_dir(), "indicator-power.recorder", NULL);
+
+  if (indicator_power_recorder_dump_to_file (filename, &error))
+    {
+      g_message ("flight recorder dumped to '%s'", filename);
+    }
+  else
+    {
+      g_warning ("Unable to dump flight recorder: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (filename);
+  return G_SOURCE_CONTINUE;
+}
+
 int
 main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
 {
@@ -45,12 +70,17 @@ main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
   IndicatorPowerService * service;
   IndicatorPowerTesting * testing;
   GMainLoop * loop;
+  const gchar * stall_msec;
 
   /* boilerplate i18n */
   setlocale (LC_ALL, "");
   bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
   textdomain (GETTEXT_PACKAGE);
 
+  /* optionally watch for main loop stalls */
+  if ((stall_msec = g_getenv ("INDICATOR_POWER_STALL_MSEC")) != NULL)
+    indicator_power_watchdog_start (NULL, indicator_power_watchdog_parse_threshold (stall_msec));
+
   /* run */
   notifier = indicator_power_notifier_new();
   service = indicator_power_service_new(NULL, notifier);
@@ -58,9 +88,11 @@ main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
   loop = g_main_loop_new (NULL, FALSE);
   g_signal_connect (service, INDICATOR_POWER_SERVICE_SIGNAL_NAME_LOST,
                     G_CALLBACK(on_name_lost), loop);
+  g_unix_signal_add (SIGUSR1, on_sigusr1, NULL);
   g_main_loop_run (loop);
 
   /* cleanup */
+  indicator_power_watchdog_stop ();
   g_main_loop_unref (loop);
   g_clear_object (&testing);
   g_clear_object (&service);
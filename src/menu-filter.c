@@ -0,0 +1,215 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "menu-filter.h"
+
+typedef struct
+{
+  GMenuModel * base;
+  gchar ** hidden_attributes;
+}
+IndicatorPowerMenuFilterPrivate;
+
+typedef IndicatorPowerMenuFilterPrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerMenuFilter,
+                           indicator_power_menu_filter,
+                           G_TYPE_MENU_MODEL)
+
+#define get_priv(o) ((priv_t*)indicator_power_menu_filter_get_instance_private(o))
+
+static gboolean
+is_hidden (const priv_t * p, const gchar * name)
+{
+  gchar ** it;
+
+  for (it=p->hidden_attributes; it && *it; ++it)
+    if (!g_strcmp0 (*it, name))
+      return TRUE;
+
+  return FALSE;
+}
+
+/***
+****  GMenuModel virtual functions
+***/
+
+static gboolean
+my_is_mutable (GMenuModel * model G_GNUC_UNUSED)
+{
+  return TRUE;
+}
+
+static gint
+my_get_n_items (GMenuModel * model)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_MENU_FILTER (model));
+
+  return p->base != NULL ? g_menu_model_get_n_items (p->base) : 0;
+}
+
+static void
+my_get_item_attributes (GMenuModel  * model,
+                        gint          position,
+                        GHashTable ** table)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_MENU_FILTER (model));
+  GMenuAttributeIter * iter;
+  const gchar * name;
+  GVariant * value;
+
+  *table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+
+  iter = g_menu_model_iterate_item_attributes (p->base, position);
+  while (g_menu_attribute_iter_get_next (iter, &name, &value))
+    {
+      if (is_hidden (p, name))
+        g_variant_unref (value);
+      else
+        g_hash_table_insert (*table, g_strdup (name), value);
+    }
+  g_object_unref (iter);
+}
+
+static void
+my_get_item_links (GMenuModel  * model,
+                   gint          position,
+                   GHashTable ** table)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_MENU_FILTER (model));
+  GMenuLinkIter * iter;
+  const gchar * name;
+  GMenuModel * link;
+
+  *table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+  iter = g_menu_model_iterate_item_links (p->base, position);
+  while (g_menu_link_iter_get_next (iter, &name, &link))
+    g_hash_table_insert (*table, g_strdup (name), link);
+  g_object_unref (iter);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_MENU_FILTER (o));
+
+  if (p->base != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->base, o);
+      g_clear_object (&p->base);
+    }
+
+  G_OBJECT_CLASS (indicator_power_menu_filter_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  g_strfreev (get_priv (INDICATOR_POWER_MENU_FILTER (o))->hidden_attributes);
+
+  G_OBJECT_CLASS (indicator_power_menu_filter_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_menu_filter_init (IndicatorPowerMenuFilter * self G_GNUC_UNUSED)
+{
+}
+
+static void
+indicator_power_menu_filter_class_init (IndicatorPowerMenuFilterClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+  GMenuModelClass * model_class = G_MENU_MODEL_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+
+  model_class->is_mutable = my_is_mutable;
+  model_class->get_n_items = my_get_n_items;
+  model_class->get_item_attributes = my_get_item_attributes;
+  model_class->get_item_links = my_get_item_links;
+}
+
+/***
+****  Public API
+***/
+
+static void
+on_base_items_changed (GMenuModel * base     G_GNUC_UNUSED,
+                       gint         position,
+                       gint         removed,
+                       gint         added,
+                       gpointer     gself)
+{
+  g_menu_model_items_changed (G_MENU_MODEL (gself), position, removed, added);
+}
+
+GMenuModel *
+indicator_power_menu_filter_new (GMenuModel          * base,
+                                 const gchar * const * hidden_attributes)
+{
+  IndicatorPowerMenuFilter * self = g_object_new (INDICATOR_TYPE_POWER_MENU_FILTER, NULL);
+
+  get_priv (self)->hidden_attributes = g_strdupv ((gchar **) hidden_attributes);
+  indicator_power_menu_filter_set_base (self, base);
+
+  return G_MENU_MODEL (self);
+}
+
+void
+indicator_power_menu_filter_set_base (IndicatorPowerMenuFilter * self,
+                                      GMenuModel               * base)
+{
+  priv_t * p;
+  gint old_n;
+  gint new_n;
+
+  g_return_if_fail (INDICATOR_IS_POWER_MENU_FILTER (self));
+  g_return_if_fail ((base == NULL) || G_IS_MENU_MODEL (base));
+
+  p = get_priv (self);
+  if (p->base == base)
+    return;
+
+  old_n = my_get_n_items (G_MENU_MODEL (self));
+
+  if (p->base != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->base, self);
+      g_clear_object (&p->base);
+    }
+
+  if (base != NULL)
+    {
+      p->base = g_object_ref (base);
+      g_signal_connect (p->base, "items-changed", G_CALLBACK (on_base_items_changed), self);
+    }
+
+  new_n = my_get_n_items (G_MENU_MODEL (self));
+
+  /* one signal for the whole swap, rather than one per item */
+  if (old_n || new_n)
+    g_menu_model_items_changed (G_MENU_MODEL (self), 0, old_n, new_n);
+}
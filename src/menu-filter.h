@@ -0,0 +1,59 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_MENU_FILTER_H__
+#define __INDICATOR_POWER_MENU_FILTER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_MENU_FILTER          (indicator_power_menu_filter_get_type())
+#define INDICATOR_POWER_MENU_FILTER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_MENU_FILTER, IndicatorPowerMenuFilter))
+#define INDICATOR_IS_POWER_MENU_FILTER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_MENU_FILTER))
+
+typedef struct _IndicatorPowerMenuFilter        IndicatorPowerMenuFilter;
+typedef struct _IndicatorPowerMenuFilterClass   IndicatorPowerMenuFilterClass;
+
+/**
+ * A read-only view of another GMenuModel's items with some of
+ * their attributes hidden, so that two menus which differ only
+ * by an attribute can share one set of items.
+ */
+struct _IndicatorPowerMenuFilter
+{
+  /*< private >*/
+  GMenuModel parent;
+};
+
+struct _IndicatorPowerMenuFilterClass
+{
+  GMenuModelClass parent_class;
+};
+
+GType indicator_power_menu_filter_get_type (void);
+
+/* hidden_attributes is a NULL-terminated list of attribute names */
+GMenuModel * indicator_power_menu_filter_new      (GMenuModel                * base,
+                                                    const gchar * const       * hidden_attributes);
+
+/* show a different model's items through the same filter */
+void         indicator_power_menu_filter_set_base (IndicatorPowerMenuFilter  * self,
+                                                    GMenuModel                * base);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_MENU_FILTER_H__ */
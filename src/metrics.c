@@ -0,0 +1,365 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus-metrics.h"
+#include "dbus-shared.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "watchdog.h"
+
+#include <string.h> /* memset() */
+
+static const char * const counter_names[N_METRIC_COUNTERS] =
+{
+  "provider-signals",
+  "get-all-calls",
+  "get-all-replies-dropped",
+  "devices-changed",
+  "rebuilds-header",
+  "rebuilds-devices",
+  "rebuilds-settings",
+  "action-states-unchanged",
+  "notifications-shown",
+  "main-loop-stalls"
+};
+
+struct histogram
+{
+  guint64 calls;
+  guint64 total_usec;
+  guint64 max_usec;
+  guint64 buckets[METRICS_N_BUCKETS];
+};
+
+static guint64 counters[N_METRIC_COUNTERS];
+
+struct stall
+{
+  guint64 count;
+  guint64 max_usec;
+};
+
+/* handler name --> struct histogram */
+static GHashTable * histograms = NULL;
+
+/* handler name --> struct stall */
+static GHashTable * stalls = NULL;
+
+static GDBusConnection * metrics_bus = NULL;
+static DbusMetrics * skeleton = NULL;
+
+/***
+****  Counters & Histograms
+***/
+
+void
+indicator_power_metrics_inc (IndicatorPowerMetricCounter counter)
+{
+  g_return_if_fail (counter < N_METRIC_COUNTERS);
+
+  ++counters[counter];
+}
+
+guint64
+indicator_power_metrics_get (IndicatorPowerMetricCounter counter)
+{
+  g_return_val_if_fail (counter < N_METRIC_COUNTERS, 0);
+
+  return counters[counter];
+}
+
+/* bucket i holds durations under 2^(i+4) usec; the last one holds the rest */
+static guint
+get_bucket (gint64 usec)
+{
+  guint i;
+
+  for (i=0; i<METRICS_N_BUCKETS-1; ++i)
+    if (usec < ((gint64)1 << (i+4)))
+      break;
+
+  return i;
+}
+
+gint64
+indicator_power_metrics_handler_begin (void)
+{
+  return g_get_monotonic_time ();
+}
+
+void
+indicator_power_metrics_handler_end (const char * handler_name,
+                                     gint64       begin)
+{
+  indicator_power_metrics_record_handler (handler_name, g_get_monotonic_time () - begin);
+}
+
+void
+indicator_power_metrics_record_handler (const char * handler_name,
+                                        gint64       usec)
+{
+  struct histogram * h;
+
+  g_return_if_fail (handler_name != NULL);
+
+  if (G_UNLIKELY (histograms == NULL))
+    histograms = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+  if ((h = g_hash_table_lookup (histograms, handler_name)) == NULL)
+    {
+      h = g_new0 (struct histogram, 1);
+      g_hash_table_insert (histograms, (gpointer)handler_name, h);
+    }
+
+  usec = MAX (usec, 0);
+  ++h->calls;
+  h->total_usec += (guint64)usec;
+  h->max_usec = MAX (h->max_usec, (guint64)usec);
+  ++h->buckets[get_bucket (usec)];
+
+  indicator_power_watchdog_note_handler (handler_name, usec);
+}
+
+guint64
+indicator_power_metrics_get_handler_calls (const char * handler_name)
+{
+  const struct histogram * h = NULL;
+
+  if (histograms != NULL)
+    h = g_hash_table_lookup (histograms, handler_name);
+
+  return h != NULL ? h->calls : 0;
+}
+
+void
+indicator_power_metrics_record_stall (const char * handler_name,
+                                      gint64       usec)
+{
+  struct stall * s;
+
+  g_return_if_fail (handler_name != NULL);
+
+  if (G_UNLIKELY (stalls == NULL))
+    stalls = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+  if ((s = g_hash_table_lookup (stalls, handler_name)) == NULL)
+    {
+      s = g_new0 (struct stall, 1);
+      g_hash_table_insert (stalls, (gpointer)handler_name, s);
+    }
+
+  ++counters[METRIC_MAIN_LOOP_STALLS];
+  ++s->count;
+  s->max_usec = MAX (s->max_usec, (guint64)MAX (usec, 0));
+}
+
+guint64
+indicator_power_metrics_get_stalls (const char * handler_name)
+{
+  const struct stall * s = NULL;
+
+  if (stalls != NULL)
+    s = g_hash_table_lookup (stalls, handler_name);
+
+  return s != NULL ? s->count : 0;
+}
+
+void
+indicator_power_metrics_reset (void)
+{
+  memset (counters, 0, sizeof(counters));
+
+  if (histograms != NULL)
+    g_hash_table_remove_all (histograms);
+
+  if (stalls != NULL)
+    g_hash_table_remove_all (stalls);
+}
+
+/***
+****  D-Bus
+***/
+
+static GVariant *
+create_counters_variant (void)
+{
+  GVariantBuilder b;
+  int i;
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE("a{st}"));
+  for (i=0; i<N_METRIC_COUNTERS; ++i)
+    g_variant_builder_add (&b, "{st}", counter_names[i], counters[i]);
+
+  return g_variant_builder_end (&b);
+}
+
+static GVariant *
+create_histograms_variant (void)
+{
+  GVariantBuilder b;
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE("a{s(tttat)}"));
+
+  if (histograms != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, histograms);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          const struct histogram * h = value;
+          GVariant * buckets;
+
+          buckets = g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                               h->buckets,
+                                               METRICS_N_BUCKETS,
+                                               sizeof(guint64));
+
+          g_variant_builder_add (&b, "{s(ttt@at)}",
+                                 key,
+                                 h->calls,
+                                 h->total_usec,
+                                 h->max_usec,
+                                 buckets);
+        }
+    }
+
+  return g_variant_builder_end (&b);
+}
+
+static GVariant *
+create_stalls_variant (void)
+{
+  GVariantBuilder b;
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE("a{s(tt)}"));
+
+  if (stalls != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, stalls);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          const struct stall * s = value;
+          g_variant_builder_add (&b, "{s(tt)}", key, s->count, s->max_usec);
+        }
+    }
+
+  return g_variant_builder_end (&b);
+}
+
+static gboolean
+on_handle_get_counters (DbusMetrics           * skel,
+                        GDBusMethodInvocation * invocation,
+                        gpointer                unused G_GNUC_UNUSED)
+{
+  dbus_metrics_complete_get_counters (skel, invocation, create_counters_variant ());
+  return TRUE;
+}
+
+static gboolean
+on_handle_get_histograms (DbusMetrics           * skel,
+                          GDBusMethodInvocation * invocation,
+                          gpointer                unused G_GNUC_UNUSED)
+{
+  dbus_metrics_complete_get_histograms (skel, invocation, create_histograms_variant ());
+  return TRUE;
+}
+
+static gboolean
+on_handle_get_stalls (DbusMetrics           * skel,
+                      GDBusMethodInvocation * invocation,
+                      gpointer                unused G_GNUC_UNUSED)
+{
+  dbus_metrics_complete_get_stalls (skel, invocation, create_stalls_variant ());
+  return TRUE;
+}
+
+static gboolean
+on_handle_dump_recorder (DbusMetrics           * skel,
+                         GDBusMethodInvocation * invocation,
+                         gpointer                unused G_GNUC_UNUSED)
+{
+  GBytes * bytes = indicator_power_recorder_dump ();
+  dbus_metrics_complete_dump_recorder (skel, invocation,
+                                       g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, bytes, TRUE));
+  g_bytes_unref (bytes);
+  return TRUE;
+}
+
+static gboolean
+on_handle_reset (DbusMetrics           * skel,
+                 GDBusMethodInvocation * invocation,
+                 gpointer                unused G_GNUC_UNUSED)
+{
+  indicator_power_metrics_reset ();
+  dbus_metrics_complete_reset (skel, invocation);
+  return TRUE;
+}
+
+/**
+ * Exports the Metrics interface on the given bus,
+ * or unexports it if bus is NULL.
+ */
+void
+indicator_power_metrics_set_bus (GDBusConnection * bus)
+{
+  g_return_if_fail ((bus == NULL) || G_IS_DBUS_CONNECTION(bus));
+
+  if (metrics_bus == bus)
+    return;
+
+  if (metrics_bus != NULL)
+    {
+      g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON(skeleton));
+      g_clear_object (&skeleton);
+      g_clear_object (&metrics_bus);
+    }
+
+  if (bus != NULL)
+    {
+      GError * error;
+
+      metrics_bus = g_object_ref (bus);
+
+      skeleton = dbus_metrics_skeleton_new ();
+      g_signal_connect (skeleton, "handle-get-counters",
+                        G_CALLBACK(on_handle_get_counters), NULL);
+      g_signal_connect (skeleton, "handle-get-histograms",
+                        G_CALLBACK(on_handle_get_histograms), NULL);
+      g_signal_connect (skeleton, "handle-get-stalls",
+                        G_CALLBACK(on_handle_get_stalls), NULL);
+      g_signal_connect (skeleton, "handle-dump-recorder",
+                        G_CALLBACK(on_handle_dump_recorder), NULL);
+      g_signal_connect (skeleton, "handle-reset",
+                        G_CALLBACK(on_handle_reset), NULL);
+
+      error = NULL;
+      if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON(skeleton),
+                                             bus,
+                                             BUS_PATH"/Metrics",
+                                             &error))
+        {
+          g_warning ("Unable to export Metrics: %s", error->message);
+          g_error_free (error);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_METRICS_H__
+#define __INDICATOR_POWER_METRICS_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Process-wide counters and handler timings, exported over D-Bus
+ * as com.canonical.indicator.power.Metrics so that we can tell from
+ * the outside whether the service is busy, and why.
+ *
+ * These are only touched from the main thread.
+ */
+
+typedef enum
+{
+  METRIC_PROVIDER_SIGNALS,
+  METRIC_GET_ALL_CALLS,
+  METRIC_GET_ALL_REPLIES_DROPPED,
+  METRIC_DEVICES_CHANGED,
+  METRIC_REBUILDS_HEADER,
+  METRIC_REBUILDS_DEVICES,
+  METRIC_REBUILDS_SETTINGS,
+  METRIC_ACTION_STATES_UNCHANGED,
+  METRIC_NOTIFICATIONS_SHOWN,
+  METRIC_MAIN_LOOP_STALLS,
+  N_METRIC_COUNTERS
+}
+IndicatorPowerMetricCounter;
+
+#define METRICS_N_BUCKETS 17
+
+void    indicator_power_metrics_inc            (IndicatorPowerMetricCounter counter);
+
+guint64 indicator_power_metrics_get            (IndicatorPowerMetricCounter counter);
+
+/* time a main-loop handler:
+     const gint64 begin = indicator_power_metrics_handler_begin ();
+     ...
+     indicator_power_metrics_handler_end (G_STRFUNC, begin);
+   the name must be a static string. */
+gint64  indicator_power_metrics_handler_begin  (void);
+
+void    indicator_power_metrics_handler_end    (const char * handler_name,
+                                                gint64       begin);
+
+/* records a handler's duration directly */
+void    indicator_power_metrics_record_handler (const char * handler_name,
+                                                gint64       usec);
+
+guint64 indicator_power_metrics_get_handler_calls (const char * handler_name);
+
+/* records a main loop stall that's been blamed on handler_name,
+   which must be a static string. See watchdog.h */
+void    indicator_power_metrics_record_stall   (const char * handler_name,
+                                                gint64       usec);
+
+guint64 indicator_power_metrics_get_stalls     (const char * handler_name);
+
+void    indicator_power_metrics_reset          (void);
+
+void    indicator_power_metrics_set_bus        (GDBusConnection * bus);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_METRICS_H__ */
@@ -21,25 +21,18 @@
 #include "dbus-accounts-sound.h"
 #include "dbus-battery.h"
 #include "dbus-shared.h"
+#include "clock.h"
+#include "low-battery.h"
+#include "metrics.h"
 #include "notifier.h"
+#include "recorder.h"
 
 #include <url-dispatcher.h>
 
-#include <libnotify/notify.h>
-
 #include <glib/gi18n.h>
 
 #include <stdint.h> /* UINT32_MAX */
 
-typedef enum
-{
-  POWER_LEVEL_CRITICAL,
-  POWER_LEVEL_VERY_LOW,
-  POWER_LEVEL_LOW,
-  POWER_LEVEL_OK
-}
-PowerLevel;
-
 /**
 ***  GObject Properties
 **/
@@ -55,8 +48,6 @@ enum
 
 static GParamSpec * properties[LAST_PROP];
 
-static int instance_count = 0;
-
 /**
 ***
 **/
@@ -69,20 +60,35 @@ typedef struct
      See indicator_power_service_choose_primary_device() and
      bug #880881 */
   IndicatorPowerDevice * battery;
-  PowerLevel power_level;
-  gboolean discharging;
+  IndicatorPowerLowBattery low_battery;
+  GSettings * settings;
 
-  NotifyNotification * notify_notification;
+  /* fires when the forecast says the next threshold will be crossed */
+  IndicatorPowerClock * clock;
+  guint forecast_timer;
+  gint64 forecast_deadline;
 
   GDBusConnection * bus;
   DbusBattery * dbus_battery; /* com.canonical.indicator.power.Battery skeleton */
 
+  /* org.freedesktop.Notifications state */
+  GCancellable * notify_cancellable;
+  guint notify_subscriptions[2];
   gboolean caps_queried;
   gboolean actions_supported;
+  guint32 notification_id; /* nonzero if the server's showing ours */
+  gboolean notification_wanted;
+  gboolean notification_dirty; /* wanted, and needs a Notify call */
+  gboolean notification_request_pending;
 
   GCancellable * cancellable;
   DbusAccountsServiceSound * accounts_service_sound_proxy;
   gboolean accounts_service_sound_proxy_pending;
+
+  /* most sessions never need the notification server or AccountsService,
+     so we don't talk to them until the battery runs low or startup's over */
+  gboolean warm;
+  guint prewarm_timer;
 }
 IndicatorPowerNotifierPrivate;
 
@@ -113,33 +119,18 @@ power_level_to_dbus_string (const PowerLevel power_level)
 static PowerLevel
 get_battery_power_level (IndicatorPowerDevice * battery)
 {
-  static const double percent_critical = 2.0;
-  static const double percent_very_low = 5.0;
-  static const double percent_low = 10.0;
-  gdouble p;
-  PowerLevel ret;
-
   g_return_val_if_fail(battery != NULL, POWER_LEVEL_OK);
   g_return_val_if_fail(indicator_power_device_get_kind(battery) == UP_DEVICE_KIND_BATTERY, POWER_LEVEL_OK);
 
-  p = indicator_power_device_get_percentage(battery);
-
-  if (p <= percent_critical)
-    ret = POWER_LEVEL_CRITICAL;
-  else if (p <= percent_very_low)
-    ret = POWER_LEVEL_VERY_LOW;
-  else if (p <= percent_low)
-    ret = POWER_LEVEL_LOW;
-  else
-    ret = POWER_LEVEL_OK;
-
-  return ret;
+  return indicator_power_low_battery_get_level_for_percentage(indicator_power_device_get_percentage(battery));
 }
 
 /***
 ****  Sounds
 ***/
 
+static void notification_flush (IndicatorPowerNotifier * self);
+
 static void
 on_sound_proxy_ready (GObject      * source_object G_GNUC_UNUSED,
                       GAsyncResult * res,
@@ -156,6 +147,7 @@ on_sound_proxy_ready (GObject      * source_object G_GNUC_UNUSED,
         {
           get_priv(gself)->accounts_service_sound_proxy_pending = FALSE;
           g_debug("%s Couldn't find accounts service sound proxy: %s", G_STRLOC, error->message);
+          notification_flush(INDICATOR_POWER_NOTIFIER(gself));
         }
 
       g_clear_error(&error);
@@ -167,6 +159,7 @@ on_sound_proxy_ready (GObject      * source_object G_GNUC_UNUSED,
       g_clear_object (&p->accounts_service_sound_proxy);
       p->accounts_service_sound_proxy = proxy;
       p->accounts_service_sound_proxy_pending = FALSE;
+      notification_flush(self);
     }
 }
 
@@ -186,157 +179,621 @@ silent_mode (IndicatorPowerNotifier * self)
 
 /***
 ****  Notifications
+****
+****  We talk to org.freedesktop.Notifications directly and asynchronously,
+****  since the notification server is often slowest just when the battery
+****  is most critical. notification_show() and notification_clear() only
+****  change what we want; notification_flush() sends at most one request
+****  at a time to bring the server in line, so bursts get coalesced.
 ***/
 
+#define NOTIFY_BUS_NAME  "org.freedesktop.Notifications"
+#define NOTIFY_OBJ_PATH  "/org/freedesktop/Notifications"
+#define NOTIFY_INTERFACE "org.freedesktop.Notifications"
+
+#define NOTIFY_EXPIRES_DEFAULT -1
+#define NOTIFY_EXPIRES_NEVER 0
+
 static void
-on_notify_notification_finalized (gpointer gself, GObject * dead)
+set_is_warning (IndicatorPowerNotifier * self, gboolean is_warning)
 {
-  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
-  priv_t * const p = get_priv(self);
-  g_return_if_fail ((void*)(p->notify_notification) == (void*)dead);
-  p->notify_notification = NULL;
-  dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+  dbus_battery_set_is_warning (get_priv(self)->dbus_battery, is_warning);
 }
 
-static void
-notification_clear (IndicatorPowerNotifier * self)
+static gchar *
+create_notify_body (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv(self);
-  NotifyNotification * nn;
+  const gdouble pct = indicator_power_device_get_percentage(p->battery);
+  gint64 usec = -1;
 
-  if ((nn = p->notify_notification))
+  /* if we can see it coming, say how long until it's critical */
+  if (p->low_battery.level != POWER_LEVEL_CRITICAL)
+    usec = indicator_power_low_battery_get_time_until(&p->low_battery,
+                                                      POWER_LEVEL_CRITICAL,
+                                                      indicator_power_clock_get_monotonic_time(p->clock));
+
+  if (usec >= 60*G_USEC_PER_SEC)
     {
-      GError * error = NULL;
+      const gulong minutes = (gulong)(usec / (60*G_USEC_PER_SEC));
+
+      /* TRANSLATORS: example: "9% charge remaining, about 12 minutes until critical" */
+      return g_strdup_printf(g_dngettext(NULL,
+                                         "%.0f%% charge remaining, about %lu minute until critical",
+                                         "%.0f%% charge remaining, about %lu minutes until critical",
+                                         minutes),
+                             pct, minutes);
+    }
+
+  return g_strdup_printf(_("%.0f%% charge remaining"), pct);
+}
+
+static GVariant *
+create_notify_parameters (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  const PowerLevel power_level = p->low_battery.level;
+  const char * title;
+  gchar * body;
+  GStrv icon_names;
+  const char * icon_name;
+  GVariantBuilder actions;
+  GVariantBuilder hints;
+  gint32 expire_timeout;
+  GVariant * parameters;
+
+  title = power_level == POWER_LEVEL_LOW
+        ? _("Battery Low")
+        : _("Battery Critical");
+  body = create_notify_body(self);
+  icon_names = indicator_power_device_get_icon_names(p->battery);
+  if (icon_names && *icon_names)
+    icon_name = icon_names[0];
+  else
+    icon_name = "";
 
-      g_object_weak_unref(G_OBJECT(nn), on_notify_notification_finalized, self);
+  g_variant_builder_init(&actions, G_VARIANT_TYPE_STRING_ARRAY);
+  g_variant_builder_init(&hints, G_VARIANT_TYPE_VARDICT);
+  expire_timeout = NOTIFY_EXPIRES_DEFAULT;
 
-      if (!notify_notification_close(nn, &error))
+  if (p->actions_supported)
+    {
+      if (!silent_mode(self))
         {
-          g_warning("Unable to close notification: %s", error->message);
-          g_error_free(error);
+          gchar* filename = datafile_find(DATAFILE_TYPE_SOUND, LOW_BATTERY_SOUND);
+          if (filename != NULL)
+            {
+              gchar * uri = g_filename_to_uri(filename, NULL, NULL);
+              g_variant_builder_add(&hints, "{sv}", "sound-file", g_variant_new_take_string(uri));
+              g_clear_pointer(&filename, g_free);
+            }
+          else
+            {
+              g_warning("Unable to find '%s' in XDG data dirs", LOW_BATTERY_SOUND);
+            }
         }
 
-      p->notify_notification = NULL;
-      dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+      g_variant_builder_add(&hints, "{sv}", "x-canonical-snap-decisions", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-canonical-non-shaped-icon", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-canonical-private-affirmative-tint", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-canonical-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
+      expire_timeout = NOTIFY_EXPIRES_NEVER;
+      g_variant_builder_add(&actions, "s", "dismiss");
+      g_variant_builder_add(&actions, "s", _("OK"));
+      g_variant_builder_add(&actions, "s", "settings");
+      g_variant_builder_add(&actions, "s", _("Battery settings"));
     }
+
+  parameters = g_variant_new("(susssasa{sv}i)",
+                             SERVICE_EXEC,
+                             p->notification_id, /* replace ours, if it's up */
+                             icon_name,
+                             title,
+                             body,
+                             &actions,
+                             &hints,
+                             expire_timeout);
+
+  g_strfreev(icon_names);
+  g_free(body);
+  return parameters;
 }
 
 static void
-on_battery_settings_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
-                            char               * action    G_GNUC_UNUSED,
-                            gpointer             user_data G_GNUC_UNUSED)
+on_notify_response (GObject      * bus,
+                    GAsyncResult * res,
+                    gpointer       gself)
 {
-  url_dispatch_send("settings:///system/battery", NULL, NULL);
+  GError * error;
+  GVariant * v;
+  IndicatorPowerNotifier * self;
+  priv_t * p;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free(error);
+      return;
+    }
+
+  self = INDICATOR_POWER_NOTIFIER(gself);
+  p = get_priv(self);
+  p->notification_request_pending = FALSE;
+
+  if (error != NULL)
+    {
+      g_critical("Unable to show snap decision: %s", error->message);
+      g_error_free(error);
+    }
+  else
+    {
+      g_variant_get(v, "(u)", &p->notification_id);
+      g_variant_unref(v);
+
+      indicator_power_metrics_inc (METRIC_NOTIFICATIONS_SHOWN);
+      indicator_power_recorder_record (RECORD_NOTIFICATION_SHOWN, (guint32)p->low_battery.level);
+
+      /* if we still want it, it's a warning. otherwise flush() will close it */
+      if (p->notification_wanted)
+        set_is_warning(self, TRUE);
+    }
+
+  notification_flush(self);
 }
 
 static void
-on_dismiss_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
-                   char               * action    G_GNUC_UNUSED,
-                   gpointer             user_data G_GNUC_UNUSED)
+on_close_response (GObject      * bus,
+                   GAsyncResult * res,
+                   gpointer       gself)
 {
-  /* no-op; libnotify warns if we have a NULL action callback */
+  GError * error;
+  GVariant * v;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free(error);
+      return;
+    }
+
+  /* the user may have closed it first, so failure here is unremarkable */
+  if (error != NULL)
+    {
+      g_debug("Unable to close notification: %s", error->message);
+      g_error_free(error);
+    }
+
+  g_clear_pointer(&v, g_variant_unref);
+
+  get_priv(gself)->notification_request_pending = FALSE;
+  notification_flush(INDICATOR_POWER_NOTIFIER(gself));
 }
 
-static gboolean
-are_actions_supported(IndicatorPowerNotifier * self)
+/* send the next request needed to make the server match what we want */
+static void
+notification_flush (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv(self);
 
-  if (!p->caps_queried)
+  if ((p->bus == NULL) || !p->caps_queried || p->notification_request_pending)
+    return;
+
+  /* wait for the sound proxy so that we know whether to play a sound */
+  if (p->notification_wanted && p->notification_dirty && (p->battery != NULL)
+      && !p->accounts_service_sound_proxy_pending)
     {
-      gboolean actions_supported;
-      GList * caps;
-      GList * l;
+      p->notification_dirty = FALSE;
+      p->notification_request_pending = TRUE;
+      g_dbus_connection_call(p->bus,
+                             NOTIFY_BUS_NAME,
+                             NOTIFY_OBJ_PATH,
+                             NOTIFY_INTERFACE,
+                             "Notify",
+                             create_notify_parameters(self),
+                             G_VARIANT_TYPE("(u)"),
+                             G_DBUS_CALL_FLAGS_NONE,
+                             -1,
+                             p->notify_cancellable,
+                             on_notify_response,
+                             self);
+    }
+  else if (!p->notification_wanted && (p->notification_id != 0))
+    {
+      indicator_power_recorder_record (RECORD_NOTIFICATION_CLEARED, 0);
+      p->notification_request_pending = TRUE;
+      g_dbus_connection_call(p->bus,
+                             NOTIFY_BUS_NAME,
+                             NOTIFY_OBJ_PATH,
+                             NOTIFY_INTERFACE,
+                             "CloseNotification",
+                             g_variant_new("(u)", p->notification_id),
+                             NULL,
+                             G_DBUS_CALL_FLAGS_NONE,
+                             -1,
+                             p->notify_cancellable,
+                             on_close_response,
+                             self);
+      p->notification_id = 0;
+    }
+}
 
-      /* see if actions are supported */
-      actions_supported = FALSE;
-      caps = notify_get_server_caps();
-      for (l=caps; l!=NULL && !actions_supported; l=l->next)
-        if (!g_strcmp0(l->data, "actions"))
-          actions_supported = TRUE;
+static void
+notification_clear (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
 
-      p->actions_supported = actions_supported;
-      p->caps_queried = TRUE;
+  p->notification_wanted = FALSE;
+  p->notification_dirty = FALSE;
+  set_is_warning(self, FALSE);
+  notification_flush(self);
+}
 
-      g_list_free_full(caps, g_free);
-    }
+static void
+notification_show(IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
 
-  return p->actions_supported;
+  g_return_if_fail(p->low_battery.level != POWER_LEVEL_OK);
+
+  p->notification_wanted = TRUE;
+  p->notification_dirty = TRUE;
+  notification_flush(self);
 }
 
+/***
+****  Notification server
+***/
+
 static void
-notification_show(IndicatorPowerNotifier * self)
+on_notification_closed (GDBusConnection * connection     G_GNUC_UNUSED,
+                        const gchar     * sender_name    G_GNUC_UNUSED,
+                        const gchar     * object_path    G_GNUC_UNUSED,
+                        const gchar     * interface_name G_GNUC_UNUSED,
+                        const gchar     * signal_name    G_GNUC_UNUSED,
+                        GVariant        * parameters,
+                        gpointer          gself)
 {
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
   priv_t * const p = get_priv(self);
-  gdouble pct;
-  const char * title;
-  char * body;
-  GStrv icon_names;
-  const char * icon_name;
-  NotifyNotification * nn;
+  guint32 id = 0;
+  guint32 reason = 0;
+
+  g_variant_get(parameters, "(uu)", &id, &reason);
+
+  /* the user dismissed it, or it expired */
+  if ((id != 0) && (id == p->notification_id))
+    {
+      p->notification_id = 0;
+      p->notification_wanted = FALSE;
+      p->notification_dirty = FALSE;
+      set_is_warning(self, FALSE);
+    }
+}
+
+static void
+on_action_invoked (GDBusConnection * connection     G_GNUC_UNUSED,
+                   const gchar     * sender_name    G_GNUC_UNUSED,
+                   const gchar     * object_path    G_GNUC_UNUSED,
+                   const gchar     * interface_name G_GNUC_UNUSED,
+                   const gchar     * signal_name    G_GNUC_UNUSED,
+                   GVariant        * parameters,
+                   gpointer          gself)
+{
+  priv_t * const p = get_priv(INDICATOR_POWER_NOTIFIER(gself));
+  guint32 id = 0;
+  const gchar * action = NULL;
+
+  g_variant_get(parameters, "(u&s)", &id, &action);
+
+  if ((id != 0) && (id == p->notification_id) && !g_strcmp0(action, "settings"))
+    url_dispatch_send("settings:///system/battery", NULL, NULL);
+}
+
+static void
+on_get_capabilities_response (GObject      * bus,
+                              GAsyncResult * res,
+                              gpointer       gself)
+{
   GError * error;
-  const PowerLevel power_level = get_battery_power_level(p->battery);
+  GVariant * v;
+  priv_t * p;
 
-  notification_clear(self);
+  error = NULL;
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free(error);
+      return;
+    }
 
-  g_return_if_fail(power_level != POWER_LEVEL_OK);
+  p = get_priv(INDICATOR_POWER_NOTIFIER(gself));
+  p->actions_supported = FALSE;
+  p->caps_queried = TRUE;
 
-  /* create the notification */
-  title = power_level == POWER_LEVEL_LOW
-        ? _("Battery Low")
-        : _("Battery Critical");
-  pct = indicator_power_device_get_percentage(p->battery);
-  body = g_strdup_printf(_("%.0f%% charge remaining"), pct);
-  icon_names = indicator_power_device_get_icon_names(p->battery);
-  if (icon_names && *icon_names)
-    icon_name = icon_names[0];
+  if (error != NULL)
+    {
+      g_debug("Unable to get notification server capabilities: %s", error->message);
+      g_error_free(error);
+    }
   else
-    icon_name = NULL;
-  nn = notify_notification_new(title, body, icon_name);
-  g_strfreev (icon_names);
-  g_free (body);
+    {
+      const gchar ** caps = NULL;
+      const gchar ** it;
+
+      g_variant_get(v, "(^a&s)", &caps);
+      for (it=caps; it && *it && !p->actions_supported; ++it)
+        if (!g_strcmp0(*it, "actions"))
+          p->actions_supported = TRUE;
+
+      g_free(caps);
+      g_variant_unref(v);
+    }
+
+  notification_flush(INDICATOR_POWER_NOTIFIER(gself));
+}
+
+/* prefetch the server's capabilities and listen for its signals */
+static void
+notification_server_connect (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
 
-  if (are_actions_supported(self))
+  p->notify_cancellable = g_cancellable_new();
+
+  p->notify_subscriptions[0] = g_dbus_connection_signal_subscribe(p->bus,
+                                                                  NOTIFY_BUS_NAME,
+                                                                  NOTIFY_INTERFACE,
+                                                                  "NotificationClosed",
+                                                                  NOTIFY_OBJ_PATH,
+                                                                  NULL,
+                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  on_notification_closed,
+                                                                  self,
+                                                                  NULL);
+
+  p->notify_subscriptions[1] = g_dbus_connection_signal_subscribe(p->bus,
+                                                                  NOTIFY_BUS_NAME,
+                                                                  NOTIFY_INTERFACE,
+                                                                  "ActionInvoked",
+                                                                  NOTIFY_OBJ_PATH,
+                                                                  NULL,
+                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  on_action_invoked,
+                                                                  self,
+                                                                  NULL);
+
+  g_dbus_connection_call(p->bus,
+                         NOTIFY_BUS_NAME,
+                         NOTIFY_OBJ_PATH,
+                         NOTIFY_INTERFACE,
+                         "GetCapabilities",
+                         NULL,
+                         G_VARIANT_TYPE("(as)"),
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         p->notify_cancellable,
+                         on_get_capabilities_response,
+                         self);
+}
+
+/* take down our notification (without waiting for a reply) and
+   forget about this server. If we still want a notification,
+   it'll be shown again when we get another bus. */
+static void
+notification_server_disconnect (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+  guint i;
+
+  if (p->notification_id != 0)
     {
-      if (!silent_mode(self))
+      g_dbus_connection_call(p->bus,
+                             NOTIFY_BUS_NAME,
+                             NOTIFY_OBJ_PATH,
+                             NOTIFY_INTERFACE,
+                             "CloseNotification",
+                             g_variant_new("(u)", p->notification_id),
+                             NULL,
+                             G_DBUS_CALL_FLAGS_NONE,
+                             -1,
+                             NULL,
+                             NULL,
+                             NULL);
+      p->notification_id = 0;
+      p->notification_dirty = p->notification_wanted;
+    }
+
+  for (i=0; i<G_N_ELEMENTS(p->notify_subscriptions); ++i)
+    {
+      if (p->notify_subscriptions[i] != 0)
         {
-          gchar* filename = datafile_find(DATAFILE_TYPE_SOUND, LOW_BATTERY_SOUND);
-          if (filename != NULL)
-            {
-              gchar * uri = g_filename_to_uri(filename, NULL, NULL);
-              notify_notification_set_hint(nn, "sound-file", g_variant_new_take_string(uri));
-              g_clear_pointer(&filename, g_free);
-            }
-          else
-            {
-              g_warning("Unable to find '%s' in XDG data dirs", LOW_BATTERY_SOUND);
-            }
+          g_dbus_connection_signal_unsubscribe(p->bus, p->notify_subscriptions[i]);
+          p->notify_subscriptions[i] = 0;
         }
+    }
 
-      notify_notification_set_hint(nn, "x-canonical-snap-decisions", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-non-shaped-icon", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-private-affirmative-tint", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-canonical-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
-      notify_notification_set_timeout(nn, NOTIFY_EXPIRES_NEVER);
-      notify_notification_add_action(nn, "dismiss", _("OK"), on_dismiss_clicked, NULL, NULL);
-      notify_notification_add_action(nn, "settings", _("Battery settings"), on_battery_settings_clicked, NULL, NULL);
+  if (p->notify_cancellable != NULL)
+    {
+      g_cancellable_cancel(p->notify_cancellable);
+      g_clear_object(&p->notify_cancellable);
     }
 
-  /* if we can show it, keep it */
-  error = NULL;
-  if (notify_notification_show(nn, &error))
+  p->notification_request_pending = FALSE;
+  p->caps_queried = FALSE;
+  p->actions_supported = FALSE;
+}
+
+/***
+****  Warming up
+***/
+
+/* how long after getting a bus to connect to the notification server
+   and AccountsService if the battery hasn't made us do it already */
+#define PREWARM_DELAY_MSEC (60 * 1000)
+
+static void
+notifier_warm_up (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+  gchar * object_path;
+
+  if (p->warm)
+    return;
+
+  p->warm = TRUE;
+
+  if (p->prewarm_timer != 0)
     {
-      p->notify_notification = nn;
-      g_signal_connect(nn, "closed", G_CALLBACK(g_object_unref), NULL);
-      g_object_weak_ref(G_OBJECT(nn), on_notify_notification_finalized, self);
-      dbus_battery_set_is_warning (p->dbus_battery, TRUE);
+      indicator_power_clock_source_remove (p->clock, p->prewarm_timer);
+      p->prewarm_timer = 0;
     }
-  else
+
+  p->accounts_service_sound_proxy_pending = TRUE;
+  object_path = g_strdup_printf("/org/freedesktop/Accounts/User%lu", (gulong)getuid());
+  dbus_accounts_service_sound_proxy_new_for_bus(
+    G_BUS_TYPE_SYSTEM,
+    G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
+    "org.freedesktop.Accounts",
+    object_path,
+    p->cancellable,
+    on_sound_proxy_ready,
+    self);
+  g_free(object_path);
+
+  if (p->bus != NULL)
+    notification_server_connect (self);
+}
+
+static gboolean
+on_prewarm_timer (gpointer gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+
+  get_priv(self)->prewarm_timer = 0;
+  notifier_warm_up (self);
+  return G_SOURCE_REMOVE;
+}
+
+/***
+****
+***/
+
+static void
+on_low_battery_settings_changed (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+
+  p->low_battery.hysteresis = g_settings_get_double (p->settings, "low-battery-hysteresis");
+  p->low_battery.renotify_usec = (gint64) g_settings_get_uint (p->settings, "low-battery-renotify-interval") * G_USEC_PER_SEC;
+}
+
+static void
+evaluate (IndicatorPowerNotifier         * self,
+          IndicatorPowerLowBatteryAction   action)
+{
+  priv_t * const p = get_priv (self);
+
+  if (p->low_battery.level != POWER_LEVEL_OK)
+    notifier_warm_up (self);
+
+  switch (action)
     {
-      g_critical("Unable to show snap decision for '%s': %s", body, error->message);
-      g_error_free(error);
-      g_object_unref(nn);
+      case LOW_BATTERY_ACTION_SHOW:
+        notification_show (self);
+        break;
+
+      case LOW_BATTERY_ACTION_CLEAR:
+        notification_clear (self);
+        break;
+
+      default:
+        break;
     }
+
+  dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (p->low_battery.level));
+}
+
+/***
+****  Forecasting
+****
+****  Rather than wait for the battery to report that it's crossed the next
+****  threshold, arm a timer for when the discharge rate says it will.
+***/
+
+/* don't bother re-arming the timer unless the forecast moves more than
+   this much or 10% of the time remaining, whichever is more */
+#define FORECAST_SLACK_USEC (30 * G_USEC_PER_SEC)
+
+/* keep a forecast that's slightly off from spinning the timer */
+#define FORECAST_MIN_USEC (1 * G_USEC_PER_SEC)
+
+static void
+forecast_cancel (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+
+  if (p->forecast_timer != 0)
+    {
+      indicator_power_clock_source_remove (p->clock, p->forecast_timer);
+      p->forecast_timer = 0;
+    }
+}
+
+static gboolean on_forecast_timer (gpointer gself);
+
+static void
+forecast_reschedule (IndicatorPowerNotifier * self, gint64 now)
+{
+  priv_t * const p = get_priv (self);
+  const PowerLevel next = indicator_power_low_battery_get_next_level (&p->low_battery);
+  gint64 usec = -1;
+  gint64 deadline;
+
+  if (p->low_battery.discharging && (next != POWER_LEVEL_OK))
+    usec = indicator_power_low_battery_get_time_until (&p->low_battery, next, now);
+
+  if (usec < 0)
+    {
+      forecast_cancel (self);
+      return;
+    }
+
+  deadline = now + MAX (usec, FORECAST_MIN_USEC);
+
+  if (p->forecast_timer != 0)
+    {
+      const gint64 slack = MAX (FORECAST_SLACK_USEC, (p->forecast_deadline - now) / 10);
+
+      if (ABS (deadline - p->forecast_deadline) <= slack)
+        return;
+
+      forecast_cancel (self);
+    }
+
+  p->forecast_deadline = deadline;
+  p->forecast_timer = indicator_power_clock_timeout_add (p->clock,
+                                                         (guint) MIN ((deadline - now + 999) / 1000, G_MAXUINT),
+                                                         on_forecast_timer,
+                                                         self);
+}
+
+static gboolean
+on_forecast_timer (gpointer gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER (gself);
+  priv_t * const p = get_priv (self);
+  const gint64 now = indicator_power_clock_get_monotonic_time (p->clock);
+  const gdouble percentage = indicator_power_low_battery_get_forecast_percentage (&p->low_battery, now);
+
+  p->forecast_timer = 0;
+
+  if (percentage >= 0)
+    evaluate (self, indicator_power_low_battery_update_from_forecast (&p->low_battery, percentage, now));
+
+  forecast_reschedule (self, now);
+  return G_SOURCE_REMOVE;
 }
 
 /***
@@ -346,38 +803,29 @@ notification_show(IndicatorPowerNotifier * self)
 static void
 on_battery_property_changed (IndicatorPowerNotifier * self)
 {
+  const gint64 begin = indicator_power_metrics_handler_begin ();
   priv_t * p;
-  PowerLevel old_power_level;
-  PowerLevel new_power_level;
-  gboolean old_discharging;
-  gboolean new_discharging;
+  gdouble percentage;
+  gboolean discharging;
+  gint64 now;
 
   g_return_if_fail(INDICATOR_IS_POWER_NOTIFIER(self));
   p = get_priv (self);
   g_return_if_fail(INDICATOR_IS_POWER_DEVICE(p->battery));
 
-  old_power_level = p->power_level;
-  new_power_level = get_battery_power_level (p->battery);
+  percentage = indicator_power_device_get_percentage (p->battery);
+  discharging = indicator_power_device_get_state (p->battery) == UP_DEVICE_STATE_DISCHARGING;
+  now = indicator_power_clock_get_monotonic_time (p->clock);
 
-  old_discharging = p->discharging;
-  new_discharging = indicator_power_device_get_state(p->battery) == UP_DEVICE_STATE_DISCHARGING;
+  indicator_power_low_battery_sample (&p->low_battery, percentage, discharging, now);
 
-  /* pop up a 'low battery' notification if either:
-     a) it's already discharging, and its PowerLevel worsens, OR
-     b) it's already got a bad PowerLevel and its state becomes 'discharging */
-  if ((new_discharging && (old_power_level > new_power_level)) ||
-      ((new_power_level != POWER_LEVEL_OK) && new_discharging && !old_discharging))
-    {
-      notification_show (self);
-    }
-  else if (!new_discharging || (new_power_level == POWER_LEVEL_OK))
-    {
-      notification_clear (self);
-    }
+  /* most updates are just the charge ticking down between thresholds */
+  if (indicator_power_low_battery_is_relevant (&p->low_battery, percentage, discharging))
+    evaluate (self, indicator_power_low_battery_update (&p->low_battery, percentage, discharging, now));
+
+  forecast_reschedule (self, now);
 
-  dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (new_power_level));
-  p->power_level = new_power_level;
-  p->discharging = new_discharging;
+  indicator_power_metrics_handler_end (G_STRFUNC, begin);
 }
 
 /***
@@ -435,23 +883,22 @@ my_dispose (GObject * o)
       g_clear_object(&p->cancellable);
     }
 
-  indicator_power_notifier_set_bus (self, NULL);
   notification_clear (self);
+  indicator_power_notifier_set_bus (self, NULL);
   indicator_power_notifier_set_battery (self, NULL);
   g_clear_object (&p->dbus_battery);
   g_clear_object (&p->accounts_service_sound_proxy);
+  g_clear_object (&p->settings);
 
-  G_OBJECT_CLASS (indicator_power_notifier_parent_class)->dispose (o);
-}
+  if (p->prewarm_timer != 0)
+    {
+      indicator_power_clock_source_remove (p->clock, p->prewarm_timer);
+      p->prewarm_timer = 0;
+    }
 
-static void
-my_finalize (GObject * o G_GNUC_UNUSED)
-{
-  /* FIXME: This is an awkward place to put this. 
-     Ordinarily something like this would go in main(), but we need libnotify
-     to clean itself up before shutting down the bus in the unit tests as well. */
-  if (!--instance_count)
-    notify_uninit();
+  g_clear_object (&p->clock);
+
+  G_OBJECT_CLASS (indicator_power_notifier_parent_class)->dispose (o);
 }
 
 /***
@@ -467,24 +914,16 @@ indicator_power_notifier_init (IndicatorPowerNotifier * self)
 
   p->dbus_battery = dbus_battery_skeleton_new ();
 
-  p->power_level = POWER_LEVEL_OK;
+  indicator_power_low_battery_init (&p->low_battery);
+  p->clock = g_object_ref (indicator_power_clock_get_default ());
+  p->settings = g_settings_new ("com.canonical.indicator.power");
+  g_signal_connect_swapped (p->settings, "changed::low-battery-hysteresis",
+                            G_CALLBACK(on_low_battery_settings_changed), self);
+  g_signal_connect_swapped (p->settings, "changed::low-battery-renotify-interval",
+                            G_CALLBACK(on_low_battery_settings_changed), self);
+  on_low_battery_settings_changed (self);
 
   p->cancellable = g_cancellable_new();
-
-  if (!instance_count++ && !notify_init(SERVICE_EXEC))
-    g_critical("Unable to initialize libnotify! Notifications might not be shown.");
-
-  p->accounts_service_sound_proxy_pending = TRUE;
-  gchar* object_path = g_strdup_printf("/org/freedesktop/Accounts/User%lu", (gulong)getuid());
-  dbus_accounts_service_sound_proxy_new_for_bus(
-    G_BUS_TYPE_SYSTEM,
-    G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
-    "org.freedesktop.Accounts",
-    object_path,
-    p->cancellable,
-    on_sound_proxy_ready,
-    self);
-  g_clear_pointer(&object_path, g_free);
 }
 
 static void
@@ -493,7 +932,6 @@ indicator_power_notifier_class_init (IndicatorPowerNotifierClass * klass)
   GObjectClass * object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = my_dispose;
-  object_class->finalize = my_finalize;
   object_class->get_property = my_get_property;
   object_class->set_property = my_set_property;
 
@@ -537,6 +975,8 @@ indicator_power_notifier_set_battery (IndicatorPowerNotifier * self,
     {
       g_signal_handlers_disconnect_by_data (p->battery, self);
       g_clear_object (&p->battery);
+      forecast_cancel (self);
+      indicator_power_low_battery_reset (&p->low_battery);
       dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (POWER_LEVEL_OK));
       notification_clear (self);
     }
@@ -574,6 +1014,7 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
       if (skel != NULL)
         g_dbus_interface_skeleton_unexport (skel);
 
+      notification_server_disconnect (self);
       g_clear_object (&p->bus);
     }
 
@@ -592,6 +1033,14 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
           g_warning ("Unable to export LowBattery properties: %s", error->message);
           g_error_free (error);
         }
+
+      if (p->warm)
+        notification_server_connect (self);
+      else if (p->prewarm_timer == 0)
+        p->prewarm_timer = indicator_power_clock_timeout_add (p->clock,
+                                                              PREWARM_DELAY_MSEC,
+                                                              on_prewarm_timer,
+                                                              self);
     }
 }
 
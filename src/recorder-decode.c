@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Pretty-prints a flight recorder dump.
+ *
+ *   kill -USR1 $(pidof indicator-power-service)
+ *   indicator-power-recorder-decode $XDG_RUNTIME_DIR/indicator-power.recorder
+ */
+
+#include "recorder.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h> /* memcpy() */
+
+static void
+print_record (const struct IndicatorPowerRecord * r, gint64 first, gint64 prev)
+{
+  printf ("%12.6f %+10.6f  %-22s",
+          (r->usec - first) / (double)G_USEC_PER_SEC,
+          (r->usec - prev) / (double)G_USEC_PER_SEC,
+          indicator_power_recorder_event_name (r->event));
+
+  switch (r->event)
+    {
+      case RECORD_PROVIDER_SIGNAL:
+      case RECORD_GET_ALL_SENT:
+      case RECORD_GET_ALL_RECEIVED:
+      case RECORD_GET_ALL_FAILED:
+        printf ("  path #%08x", r->arg);
+        break;
+
+      case RECORD_REBUILD:
+        printf ("  sections 0x%x", r->arg);
+        break;
+
+      case RECORD_NOTIFICATION_SHOWN:
+        printf ("  power level %u", r->arg);
+        break;
+
+      case RECORD_BRIGHTNESS_REQUEST:
+        printf ("  brightness %u", r->arg);
+        break;
+
+      case RECORD_DISPLAY_STATE:
+        printf ("  display %s", r->arg ? "on" : "off");
+        break;
+
+      default:
+        break;
+    }
+
+  printf ("\n");
+}
+
+int
+main (int argc, char ** argv)
+{
+  gchar * contents;
+  gsize len;
+  GError * error;
+  struct IndicatorPowerRecorderHeader header;
+  const struct IndicatorPowerRecord * records;
+  gint64 prev;
+  guint i;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "Usage: %s recorder-dump-file\n", argv[0]);
+      return 1;
+    }
+
+  error = NULL;
+  if (!g_file_get_contents (argv[1], &contents, &len, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      g_error_free (error);
+      return 1;
+    }
+
+  if (len < sizeof(header))
+    {
+      fprintf (stderr, "%s: too short to be a recorder dump\n", argv[1]);
+      g_free (contents);
+      return 1;
+    }
+
+  memcpy (&header, contents, sizeof(header));
+  if ((header.magic != RECORDER_MAGIC) || (header.version != RECORDER_VERSION))
+    {
+      fprintf (stderr, "%s: not a version %u recorder dump\n", argv[1], RECORDER_VERSION);
+      g_free (contents);
+      return 1;
+    }
+
+  if (len < sizeof(header) + header.n_records*sizeof(struct IndicatorPowerRecord))
+    {
+      fprintf (stderr, "%s: truncated\n", argv[1]);
+      g_free (contents);
+      return 1;
+    }
+
+  records = (const struct IndicatorPowerRecord*) (contents + sizeof(header));
+  prev = header.n_records > 0 ? records[0].usec : 0;
+  for (i=0; i<header.n_records; ++i)
+    {
+      print_record (&records[i], records[0].usec, prev);
+      prev = records[i].usec;
+    }
+
+  g_free (contents);
+  return 0;
+}
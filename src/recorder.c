@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recorder.h"
+
+#include <string.h> /* memset() */
+
+G_STATIC_ASSERT ((RECORDER_N_RECORDS & (RECORDER_N_RECORDS-1)) == 0);
+G_STATIC_ASSERT (sizeof(struct IndicatorPowerRecord) == 16);
+
+static struct IndicatorPowerRecord ring[RECORDER_N_RECORDS];
+
+/* total number of records ever written; the next slot is head % N */
+static volatile gint head = 0;
+
+static const char * const event_names[N_RECORD_EVENTS] =
+{
+  "none",
+  "provider-signal",
+  "get-all-sent",
+  "get-all-received",
+  "get-all-failed",
+  "rebuild",
+  "notification-shown",
+  "notification-cleared",
+  "brightness-request",
+  "display-state"
+};
+
+/***
+****
+***/
+
+void
+indicator_power_recorder_record (IndicatorPowerRecordEvent event,
+                                 guint32                   arg)
+{
+  const guint n = (guint) g_atomic_int_add (&head, 1);
+  struct IndicatorPowerRecord * r = &ring[n & (RECORDER_N_RECORDS-1)];
+
+  r->usec = g_get_monotonic_time ();
+  r->arg = arg;
+  r->event = event;
+}
+
+/**
+ * Returns a header followed by the recorded events, oldest first.
+ *
+ * This doesn't stop writers, so a record that's being overwritten
+ * while we copy it may come out torn. That's fine for a debugging aid.
+ */
+GBytes *
+indicator_power_recorder_dump (void)
+{
+  struct IndicatorPowerRecorderHeader header;
+  GByteArray * bytes;
+  guint n;
+  guint i;
+  guint begin;
+
+  n = (guint) g_atomic_int_get (&head);
+  begin = n > RECORDER_N_RECORDS ? n - RECORDER_N_RECORDS : 0;
+
+  bytes = g_byte_array_sized_new (sizeof(header) + (n-begin)*sizeof(struct IndicatorPowerRecord));
+
+  memset (&header, 0, sizeof(header));
+  header.magic = RECORDER_MAGIC;
+  header.version = RECORDER_VERSION;
+  g_byte_array_append (bytes, (const guint8*)&header, sizeof(header));
+
+  for (i=begin; i!=n; ++i)
+    {
+      const struct IndicatorPowerRecord * r = &ring[i & (RECORDER_N_RECORDS-1)];
+
+      if (r->event == RECORD_NONE)
+        continue;
+
+      g_byte_array_append (bytes, (const guint8*)r, sizeof(*r));
+      ++header.n_records;
+    }
+
+  memcpy (bytes->data, &header, sizeof(header));
+
+  return g_byte_array_free_to_bytes (bytes);
+}
+
+gboolean
+indicator_power_recorder_dump_to_file (const char * filename,
+                                       GError    ** error)
+{
+  GBytes * bytes;
+  gsize len;
+  gconstpointer data;
+  gboolean success;
+
+  bytes = indicator_power_recorder_dump ();
+  data = g_bytes_get_data (bytes, &len);
+  success = g_file_set_contents (filename, data, (gssize)len, error);
+  g_bytes_unref (bytes);
+
+  return success;
+}
+
+void
+indicator_power_recorder_clear (void)
+{
+  memset (ring, 0, sizeof(ring));
+  g_atomic_int_set (&head, 0);
+}
+
+const char *
+indicator_power_recorder_event_name (guint32 event)
+{
+  return event < N_RECORD_EVENTS ? event_names[event] : "unknown";
+}
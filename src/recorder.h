@@ -0,0 +1,86 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_RECORDER_H__
+#define __INDICATOR_POWER_RECORDER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A flight recorder: a fixed-size ring buffer of compact binary event
+ * records that's always on, so that there's some history to look at
+ * when a bug report comes in. Recording an event is an atomic increment
+ * and a 16-byte store; nothing gets formatted until the buffer's decoded.
+ *
+ * The buffer can be dumped with SIGUSR1 or with the Metrics interface's
+ * DumpRecorder method and then read with indicator-power-recorder-decode.
+ */
+
+typedef enum
+{
+  RECORD_NONE,
+  RECORD_PROVIDER_SIGNAL,     /* arg: hash of the object path */
+  RECORD_GET_ALL_SENT,        /* arg: hash of the object path */
+  RECORD_GET_ALL_RECEIVED,    /* arg: hash of the object path */
+  RECORD_GET_ALL_FAILED,      /* arg: hash of the object path */
+  RECORD_REBUILD,             /* arg: bitmask of the sections rebuilt */
+  RECORD_NOTIFICATION_SHOWN,  /* arg: the battery's PowerLevel */
+  RECORD_NOTIFICATION_CLEARED,
+  RECORD_BRIGHTNESS_REQUEST,  /* arg: the requested brightness */
+  RECORD_DISPLAY_STATE,       /* arg: 1 if the display's on, 0 if off */
+  N_RECORD_EVENTS
+}
+IndicatorPowerRecordEvent;
+
+/* the dump format: a header followed by the records, oldest first,
+   in the host's byte order */
+
+#define RECORDER_MAGIC 0x52465049u /* "IPFR" */
+#define RECORDER_VERSION 1u
+#define RECORDER_N_RECORDS 4096u
+
+struct IndicatorPowerRecorderHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 n_records;
+  guint32 reserved;
+};
+
+struct IndicatorPowerRecord
+{
+  gint64 usec;  /* g_get_monotonic_time() */
+  guint32 event;
+  guint32 arg;
+};
+
+void         indicator_power_recorder_record     (IndicatorPowerRecordEvent event,
+                                                  guint32                   arg);
+
+GBytes *     indicator_power_recorder_dump       (void);
+
+gboolean     indicator_power_recorder_dump_to_file (const char * filename,
+                                                    GError    ** error);
+
+void         indicator_power_recorder_clear      (void);
+
+const char * indicator_power_recorder_event_name (guint32 event);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_RECORDER_H__ */
@@ -0,0 +1,383 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clock.h"
+#include "request-stats.h"
+
+enum
+{
+  SIGNAL_CHANGED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+typedef struct
+{
+  IndicatorPowerRequestHolder pub;
+
+  /* what powerd reported last time, so we can take the difference */
+  guint64 last_total;
+  gboolean seen;
+}
+Holder;
+
+typedef struct
+{
+  IndicatorPowerClock * clock;
+  GCancellable * cancellable;
+  DbusPowerd * powerd_proxy;
+
+  /* "owner\nname" --> Holder */
+  GHashTable * holders;
+
+  gboolean active;
+  gboolean fetching;
+  gint64 sampled_at;
+  guint poll_timer;
+}
+IndicatorPowerRequestStatsPrivate;
+
+typedef IndicatorPowerRequestStatsPrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerRequestStats,
+                           indicator_power_request_stats,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_request_stats_get_instance_private(o))
+
+static void
+holder_free (gpointer gholder)
+{
+  Holder * holder = gholder;
+
+  g_free (holder->pub.name);
+  g_free (holder);
+}
+
+/***
+****  Polling powerd
+***/
+
+static void
+on_stats_ready (GObject      * powerd_proxy,
+                GAsyncResult * res,
+                gpointer       gself)
+{
+  GError * error = NULL;
+  GVariant * stats = NULL;
+  IndicatorPowerRequestStats * self;
+  priv_t * p;
+
+  dbus_powerd_call_get_sys_request_stats_finish (DBUS_POWERD (powerd_proxy), &stats, res, &error);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      return;
+    }
+
+  self = INDICATOR_POWER_REQUEST_STATS (gself);
+  p = get_priv (self);
+  p->fetching = FALSE;
+  p->sampled_at = indicator_power_clock_get_monotonic_time (p->clock);
+
+  if (error != NULL)
+    {
+      /* e.g. an older powerd; try again next time */
+      g_debug ("Unable to get powerd's request stats: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  indicator_power_request_stats_add_sample (self, stats, p->sampled_at);
+  g_variant_unref (stats);
+}
+
+static void
+fetch (IndicatorPowerRequestStats * self)
+{
+  priv_t * p = get_priv (self);
+
+  if ((p->powerd_proxy == NULL) || p->fetching)
+    return;
+
+  p->fetching = TRUE;
+  dbus_powerd_call_get_sys_request_stats (p->powerd_proxy,
+                                          p->cancellable,
+                                          on_stats_ready,
+                                          self);
+}
+
+static gboolean
+on_poll_timer (gpointer gself)
+{
+  fetch (INDICATOR_POWER_REQUEST_STATS (gself));
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+fetch_if_stale (IndicatorPowerRequestStats * self)
+{
+  priv_t * p = get_priv (self);
+  const gint64 now = indicator_power_clock_get_monotonic_time (p->clock);
+
+  if (!p->sampled_at || (now - p->sampled_at >= REQUEST_STATS_TTL_SEC * G_USEC_PER_SEC))
+    fetch (self);
+}
+
+/***
+****  GObject boilerplate
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerRequestStats * self = INDICATOR_POWER_REQUEST_STATS (o);
+  priv_t * p = get_priv (self);
+
+  if (p->cancellable != NULL)
+    {
+      g_cancellable_cancel (p->cancellable);
+      g_clear_object (&p->cancellable);
+    }
+
+  if (p->poll_timer != 0)
+    {
+      indicator_power_clock_source_remove (p->clock, p->poll_timer);
+      p->poll_timer = 0;
+    }
+
+  g_clear_object (&p->powerd_proxy);
+  g_clear_object (&p->clock);
+
+  G_OBJECT_CLASS (indicator_power_request_stats_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * p = get_priv (INDICATOR_POWER_REQUEST_STATS (o));
+
+  g_hash_table_destroy (p->holders);
+
+  G_OBJECT_CLASS (indicator_power_request_stats_parent_class)->finalize (o);
+}
+
+static void
+indicator_power_request_stats_class_init (IndicatorPowerRequestStatsClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+
+  signals[SIGNAL_CHANGED] = g_signal_new (
+    INDICATOR_POWER_REQUEST_STATS_SIGNAL_CHANGED,
+    G_TYPE_FROM_CLASS(klass),
+    G_SIGNAL_RUN_LAST,
+    G_STRUCT_OFFSET (IndicatorPowerRequestStatsClass, changed),
+    NULL, NULL,
+    g_cclosure_marshal_VOID__VOID,
+    G_TYPE_NONE, 0);
+}
+
+static void
+indicator_power_request_stats_init (IndicatorPowerRequestStats * self)
+{
+  priv_t * p = get_priv (self);
+
+  p->clock = g_object_ref (indicator_power_clock_get_default ());
+  p->cancellable = g_cancellable_new ();
+  p->holders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, holder_free);
+}
+
+/***
+****  Public API
+***/
+
+IndicatorPowerRequestStats *
+indicator_power_request_stats_new (void)
+{
+  return g_object_new (INDICATOR_TYPE_POWER_REQUEST_STATS, NULL);
+}
+
+void
+indicator_power_request_stats_set_proxy (IndicatorPowerRequestStats * self,
+                                         DbusPowerd                 * powerd_proxy)
+{
+  priv_t * p;
+
+  g_return_if_fail (INDICATOR_IS_POWER_REQUEST_STATS (self));
+  g_return_if_fail (!powerd_proxy || DBUS_IS_POWERD (powerd_proxy));
+  p = get_priv (self);
+
+  g_clear_object (&p->powerd_proxy);
+  if (powerd_proxy != NULL)
+    p->powerd_proxy = g_object_ref (powerd_proxy);
+
+  if (p->active)
+    fetch_if_stale (self);
+}
+
+void
+indicator_power_request_stats_set_active (IndicatorPowerRequestStats * self,
+                                          gboolean                     active)
+{
+  priv_t * p;
+
+  g_return_if_fail (INDICATOR_IS_POWER_REQUEST_STATS (self));
+  p = get_priv (self);
+
+  if (p->active == active)
+    return;
+
+  p->active = active;
+
+  if (active)
+    {
+      /* reuse the last sample if it's recent enough */
+      fetch_if_stale (self);
+      p->poll_timer = indicator_power_clock_timeout_add (p->clock,
+                                                         REQUEST_STATS_TTL_SEC * 1000,
+                                                         on_poll_timer,
+                                                         self);
+    }
+  else if (p->poll_timer != 0)
+    {
+      indicator_power_clock_source_remove (p->clock, p->poll_timer);
+      p->poll_timer = 0;
+    }
+}
+
+void
+indicator_power_request_stats_add_sample (IndicatorPowerRequestStats * self,
+                                          GVariant                   * stats,
+                                          gint64                       now)
+{
+  priv_t * p;
+  GHashTableIter hiter;
+  GVariantIter iter;
+  const gchar * owner;
+  const gchar * name;
+  guint32 active_count;
+  guint64 active_time;
+  guint64 max_active_time;
+  guint64 active_since;
+  gpointer value;
+  gboolean changed = FALSE;
+
+  g_return_if_fail (INDICATOR_IS_POWER_REQUEST_STATS (self));
+  g_return_if_fail (g_variant_is_of_type (stats, G_VARIANT_TYPE ("a(ssuttt)")));
+  p = get_priv (self);
+
+  g_hash_table_iter_init (&hiter, p->holders);
+  while (g_hash_table_iter_next (&hiter, NULL, &value))
+    ((Holder*)value)->seen = FALSE;
+
+  g_variant_iter_init (&iter, stats);
+  while (g_variant_iter_next (&iter, "(&s&suttt)", &owner, &name,
+                              &active_count, &active_time, &max_active_time, &active_since))
+    {
+      const gboolean active = active_since != 0;
+      guint64 total = active_time;
+      gchar * key = g_strdup_printf ("%s\n%s", owner, name);
+      Holder * holder = g_hash_table_lookup (p->holders, key);
+
+      /* powerd only adds a request's time when it's released */
+      if (active && ((guint64)now > active_since))
+        total += (guint64)now - active_since;
+
+      if (holder == NULL)
+        {
+          holder = g_new0 (Holder, 1);
+          holder->pub.name = g_strdup (name);
+          holder->pub.active_usec = total;
+          g_hash_table_insert (p->holders, key, holder);
+          changed |= (total > 0) || active;
+        }
+      else
+        {
+          /* if the total went down, powerd was restarted */
+          const guint64 delta = total >= holder->last_total ? total - holder->last_total : total;
+
+          holder->pub.active_usec += delta;
+          changed |= (delta > 0) || (holder->pub.active != active);
+          g_free (key);
+        }
+
+      holder->last_total = total;
+      holder->pub.active = active;
+      holder->seen = TRUE;
+    }
+
+  /* a client that's gone isn't holding anything */
+  g_hash_table_iter_init (&hiter, p->holders);
+  while (g_hash_table_iter_next (&hiter, NULL, &value))
+    {
+      Holder * holder = value;
+
+      if (!holder->seen && holder->pub.active)
+        {
+          holder->pub.active = FALSE;
+          changed = TRUE;
+        }
+    }
+
+  if (changed)
+    g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+}
+
+static gint
+compare_holders_by_time (gconstpointer ga, gconstpointer gb)
+{
+  const IndicatorPowerRequestHolder * a = *(IndicatorPowerRequestHolder * const *) ga;
+  const IndicatorPowerRequestHolder * b = *(IndicatorPowerRequestHolder * const *) gb;
+
+  if (a->active_usec != b->active_usec)
+    return a->active_usec > b->active_usec ? -1 : 1;
+
+  return g_strcmp0 (a->name, b->name);
+}
+
+GPtrArray *
+indicator_power_request_stats_get_top (IndicatorPowerRequestStats * self,
+                                       guint                        max_holders)
+{
+  GPtrArray * top;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_REQUEST_STATS (self), NULL);
+
+  top = g_ptr_array_new ();
+
+  g_hash_table_iter_init (&iter, get_priv (self)->holders);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      Holder * holder = value;
+
+      if (holder->pub.active_usec > 0 || holder->pub.active)
+        g_ptr_array_add (top, &holder->pub);
+    }
+
+  g_ptr_array_sort (top, compare_holders_by_time);
+  if (top->len > max_holders)
+    g_ptr_array_set_size (top, max_holders);
+
+  return top;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_REQUEST_STATS_H__
+#define __INDICATOR_POWER_REQUEST_STATS_H__
+
+#include <gio/gio.h>
+
+#include "dbus-powerd.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_REQUEST_STATS          (indicator_power_request_stats_get_type())
+#define INDICATOR_POWER_REQUEST_STATS(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_REQUEST_STATS, IndicatorPowerRequestStats))
+#define INDICATOR_IS_POWER_REQUEST_STATS(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_REQUEST_STATS))
+
+typedef struct _IndicatorPowerRequestStats        IndicatorPowerRequestStats;
+typedef struct _IndicatorPowerRequestStatsClass   IndicatorPowerRequestStatsClass;
+
+/* signal keys */
+#define INDICATOR_POWER_REQUEST_STATS_SIGNAL_CHANGED "changed"
+
+/* how long a sample is good for */
+#define REQUEST_STATS_TTL_SEC 10
+
+/* one of the clients that's asked powerd to keep the system awake */
+typedef struct
+{
+  gchar * name;
+  guint64 active_usec; /* how long it's held its requests in all */
+  gboolean active;     /* whether it's holding one now */
+}
+IndicatorPowerRequestHolder;
+
+/**
+ * Keeps track of which clients are keeping the system awake,
+ * from powerd's getSysRequestStats.
+ *
+ * powerd is only asked while the stats are active, and then no
+ * more than once every REQUEST_STATS_TTL_SEC. Each sample is folded
+ * into the running totals, and "changed" is emitted only if it
+ * changed any of them.
+ */
+struct _IndicatorPowerRequestStats
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerRequestStatsClass
+{
+  GObjectClass parent_class;
+
+  /* signals */
+  void (*changed) (IndicatorPowerRequestStats * self);
+};
+
+GType indicator_power_request_stats_get_type (void);
+
+IndicatorPowerRequestStats * indicator_power_request_stats_new (void);
+
+void indicator_power_request_stats_set_proxy  (IndicatorPowerRequestStats * self,
+                                               DbusPowerd                 * powerd_proxy);
+
+/* start or stop polling powerd, e.g. when the stats are shown or hidden */
+void indicator_power_request_stats_set_active (IndicatorPowerRequestStats * self,
+                                               gboolean                     active);
+
+/* fold a getSysRequestStats reply, of type a(ssuttt), into the totals */
+void indicator_power_request_stats_add_sample (IndicatorPowerRequestStats * self,
+                                               GVariant                   * stats,
+                                               gint64                       now);
+
+/**
+ * Returns: (transfer container) (element-type IndicatorPowerRequestHolder):
+ *          the holders that have kept the system awake at all,
+ *          longest first and no more than max_holders of them.
+ */
+GPtrArray * indicator_power_request_stats_get_top (IndicatorPowerRequestStats * self,
+                                                   guint                        max_holders);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_REQUEST_STATS_H__ */
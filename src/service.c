@@ -22,12 +22,21 @@
 #include <gio/gio.h>
 #include <url-dispatcher.h>
 
+#include <string.h> /* strlen() */
+
 #include "brightness.h"
+#include "dbus-powerd.h"
 #include "dbus-shared.h"
 #include "device.h"
 #include "device-provider.h"
+#include "icon-theme.h"
+#include "menu-filter.h"
+#include "metrics.h"
 #include "notifier.h"
+#include "recorder.h"
+#include "request-stats.h"
 #include "service.h"
+#include "shm-writer.h"
 
 #define BUS_NAME "com.canonical.indicator.power"
 #define BUS_PATH "/com/canonical/indicator/power"
@@ -35,6 +44,11 @@
 #define SETTINGS_SHOW_TIME_S "show-time"
 #define SETTINGS_ICON_POLICY_S "icon-policy"
 #define SETTINGS_SHOW_PERCENTAGE_S "show-percentage"
+#define SETTINGS_RESOLVE_ICONS_S "resolve-icons"
+#define SETTINGS_SHOW_REQUEST_STATS_S "show-request-stats"
+
+/* how many of the clients keeping the system awake to list */
+#define MAX_REQUEST_HOLDERS 5
 
 G_DEFINE_TYPE (IndicatorPowerService,
                indicator_power_service,
@@ -54,6 +68,8 @@ enum
   PROP_BUS,
   PROP_DEVICE_PROVIDER,
   PROP_NOTIFIER,
+  PROP_CONTEXT,
+  PROP_EMBEDDED,
   LAST_PROP
 };
 
@@ -64,6 +80,8 @@ enum
   SECTION_HEADER    = (1<<0),
   SECTION_DEVICES   = (1<<1),
   SECTION_SETTINGS  = (1<<2),
+  SECTION_DEVICE_STATES = (1<<3), /* the battery-level and device-state actions */
+  SECTION_REQUEST_STATS = (1<<4)
 };
 
 enum
@@ -97,6 +115,20 @@ struct ProfileMenuInfo
   GMenu * submenu;
 
   guint export_id;
+
+  /* unique bus name --> how many of the submenu's org.gtk.Menus groups
+     it's Start()ed. The menu's open while this is nonempty. */
+  GHashTable * subscribers;
+
+  /* the sections are built when the menu's first opened. After that
+     they're only rebuilt while it's open; the ones that change while
+     it's closed are flagged here and caught up when it reopens */
+  gboolean populated;
+  guint dirty;
+
+  /* an embedded service's host has no way to tell us when it shows
+     a menu, so the ones it's asked for are treated as always open */
+  gboolean held_open;
 };
 
 struct _IndicatorPowerServicePrivate
@@ -107,12 +139,38 @@ struct _IndicatorPowerServicePrivate
 
   IndicatorPowerBrightness * brightness;
 
+  /* while powerd says the display's off, updates nobody can see
+     are held back in deferred and made when it comes back on */
+  DbusPowerd * powerd_proxy;
+  gboolean display_off;
+  guint deferred;
+
+  /* the phone menu's optional "What's using power" section.
+     powerd's only asked for the stats while it's showing */
+  IndicatorPowerRequestStats * request_stats;
+  GMenu * request_stats_section;
+
+  /* non-NULL when we pick device icons instead of leaving it to the clients */
+  IndicatorPowerIconTheme * icon_theme;
+
+  /* embedded services run in a host process, which uses the menus and
+     actions directly; nothing's owned or exported on the bus */
+  gboolean embedded;
+
   guint own_id;
   guint actions_export_id;
   GDBusConnection * conn;
+  GMainContext * context;
 
-  gboolean menus_built;
   struct ProfileMenuInfo menus[N_PROFILES];
+  guint menus_filter_id;
+
+  /* the desktop and greeter menus share one devices section.
+     The greeter sees it through a filter that hides the actions */
+  GMenuModel * devices_section;
+  GMenuModel * greeter_devices_section;
+
+  GHashTable * subscriber_watches; /* unique bus name --> NameOwnerChanged subscription */
 
   GSimpleActionGroup * actions;
   GSimpleAction * header_action;
@@ -125,6 +183,9 @@ struct _IndicatorPowerServicePrivate
 
   IndicatorPowerDeviceProvider * device_provider;
   IndicatorPowerNotifier * notifier;
+
+  /* the device list for local readers; see <indicator-power/battery-shm.h> */
+  IndicatorPowerShmWriter * shm_writer;
 };
 
 typedef IndicatorPowerServicePrivate priv_t;
@@ -431,6 +492,27 @@ should_be_visible (IndicatorPowerService * self)
   return visible;
 }
 
+/* If we're resolving icons, just the first of the device's icon names
+   that's in the theme. Otherwise, or if none are, all of them. */
+static GIcon *
+get_device_icon (IndicatorPowerService * self, const IndicatorPowerDevice * device)
+{
+  priv_t * p = self->priv;
+  GIcon * icon = NULL;
+
+  if (p->icon_theme != NULL)
+    {
+      GStrv names = indicator_power_device_get_icon_names (device);
+      icon = indicator_power_icon_theme_choose_icon (p->icon_theme, (const gchar * const *) names);
+      g_strfreev (names);
+    }
+
+  if (icon == NULL)
+    icon = indicator_power_device_get_gicon (device);
+
+  return icon;
+}
+
 static GVariant *
 create_header_state (IndicatorPowerService * self)
 {
@@ -473,7 +555,7 @@ create_header_state (IndicatorPowerService * self)
             g_free (title);
         }
 
-      if ((icon = indicator_power_device_get_gicon (p->primary_device)))
+      if ((icon = get_device_icon (self, p->primary_device)))
         {
           GVariant * serialized_icon = g_icon_serialize (icon);
 
@@ -498,7 +580,7 @@ create_header_state (IndicatorPowerService * self)
 ***/
 
 static void
-append_device_to_menu (GMenu * menu, const IndicatorPowerDevice * device, int profile)
+append_device_to_menu (IndicatorPowerService * self, GMenu * menu, const IndicatorPowerDevice * device)
 {
   const UpDeviceKind kind = indicator_power_device_get_kind (device);
 
@@ -514,7 +596,7 @@ append_device_to_menu (GMenu * menu, const IndicatorPowerDevice * device, int pr
 
     g_menu_item_set_attribute (item, "x-canonical-type", "s", "com.canonical.indicator.basic");
 
-    if ((icon = indicator_power_device_get_gicon (device)))
+    if ((icon = get_device_icon (self, device)))
       {
         GVariant * serialized_icon = g_icon_serialize (icon);
 
@@ -529,11 +611,9 @@ append_device_to_menu (GMenu * menu, const IndicatorPowerDevice * device, int pr
         g_object_unref (icon);
       }
 
-    if (profile == PROFILE_DESKTOP)
-      {
-        g_menu_item_set_action_and_target(item, "indicator.activate-statistics", "s",
-                                          indicator_power_device_get_object_path (device));
-      }
+    /* the greeter's filter hides this */
+    g_menu_item_set_action_and_target(item, "indicator.activate-statistics", "s",
+                                      indicator_power_device_get_object_path (device));
 
     g_menu_append_item (menu, item);
     g_object_unref (item);
@@ -542,17 +622,28 @@ append_device_to_menu (GMenu * menu, const IndicatorPowerDevice * device, int pr
 
 
 static GMenuModel *
-create_desktop_devices_section (IndicatorPowerService * self, int profile)
+create_desktop_devices_section (IndicatorPowerService * self)
 {
   GList * l;
   GMenu * menu = g_menu_new ();
 
   for (l=self->priv->devices; l!=NULL; l=l->next)
-    append_device_to_menu (menu, l->data, profile);
+    append_device_to_menu (self, menu, l->data);
 
   return G_MENU_MODEL (menu);
 }
 
+static GMenuModel *
+get_devices_section (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+
+  if (p->devices_section == NULL)
+    p->devices_section = create_desktop_devices_section (self);
+
+  return p->devices_section;
+}
+
 /* https://wiki.ubuntu.com/Power#Phone
  * The spec also discusses including an item for any connected bluetooth
  * headset, but bluez doesn't appear to support Battery Level at this time */
@@ -677,6 +768,60 @@ create_phone_settings_section(IndicatorPowerService * self)
   return G_MENU_MODEL(section);
 }
 
+static gchar *
+format_request_duration (guint64 usec)
+{
+  const guint64 minutes = usec / (60 * G_USEC_PER_SEC);
+
+  if (minutes < 1)
+    return g_strdup_printf (_("%d s"), (int)(usec / G_USEC_PER_SEC));
+
+  if (minutes < 60)
+    return g_strdup_printf (_("%d min"), (int)minutes);
+
+  return g_strdup_printf (_("%d h %d min"), (int)(minutes / 60), (int)(minutes % 60));
+}
+
+static gboolean
+request_stats_enabled (IndicatorPowerService * self)
+{
+  return g_settings_get_boolean (self->priv->settings, SETTINGS_SHOW_REQUEST_STATS_S);
+}
+
+/* the section's kept for the life of the service so that its label
+   stays put; this just refills it */
+static void
+fill_request_stats_section (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  GPtrArray * top = indicator_power_request_stats_get_top (p->request_stats, MAX_REQUEST_HOLDERS);
+  guint i;
+
+  g_menu_remove_all (p->request_stats_section);
+
+  for (i=0; i<top->len; ++i)
+    {
+      const IndicatorPowerRequestHolder * holder = g_ptr_array_index (top, i);
+      gchar * duration = format_request_duration (holder->active_usec);
+      gchar * label;
+
+      if (holder->active)
+        label = g_strdup_printf (_("%s: %s (now)"), holder->name, duration);
+      else
+        label = g_strdup_printf (_("%s: %s"), holder->name, duration);
+
+      g_menu_append (p->request_stats_section, label, NULL);
+
+      g_free (label);
+      g_free (duration);
+    }
+
+  if (top->len == 0)
+    g_menu_append (p->request_stats_section, _("Nothing is keeping the phone awake"), NULL);
+
+  g_ptr_array_unref (top);
+}
+
 /***
 ****
 ****  SECTION REBUILDING
@@ -684,7 +829,29 @@ create_phone_settings_section(IndicatorPowerService * self)
 ***/
 
 /**
- * A small helper function for rebuild_now().
+ * Sets an action's state. GSimpleAction already drops a state that's
+ * equal to the current one; this counts those, since each one is a
+ * rebuild that did work for nothing.
+ * Takes ownership of a floating new_state.
+ */
+static void
+set_action_state (GSimpleAction * action, GVariant * new_state)
+{
+  GVariant * old_state = g_action_get_state (G_ACTION(action));
+
+  g_variant_ref_sink (new_state);
+
+  if ((old_state != NULL) && g_variant_equal (old_state, new_state))
+    indicator_power_metrics_inc (METRIC_ACTION_STATES_UNCHANGED);
+
+  g_simple_action_set_state (action, new_state);
+
+  g_variant_unref (new_state);
+  g_clear_pointer (&old_state, g_variant_unref);
+}
+
+/**
+ * A small helper function for rebuild_sections().
  * - removes the previous section
  * - adds and unrefs the new section
  */
@@ -696,33 +863,118 @@ rebuild_section (GMenu * parent, int pos, GMenuModel * new_section)
   g_object_unref (new_section);
 }
 
+/* which of the SECTION_* flags each profile's submenu has */
+static const guint profile_sections[N_PROFILES] =
+{
+  SECTION_SETTINGS | SECTION_REQUEST_STATS, /* PROFILE_PHONE */
+  SECTION_DEVICES | SECTION_SETTINGS, /* PROFILE_DESKTOP */
+  SECTION_DEVICES                    /* PROFILE_DESKTOP_GREETER */
+};
+
+static gboolean
+menu_is_open (const struct ProfileMenuInfo * info)
+{
+  return info->held_open || (g_hash_table_size (info->subscribers) > 0);
+}
+
+static void
+count_rebuilds (guint sections)
+{
+  if (sections & SECTION_DEVICES)
+    indicator_power_metrics_inc (METRIC_REBUILDS_DEVICES);
+  if (sections & SECTION_SETTINGS)
+    indicator_power_metrics_inc (METRIC_REBUILDS_SETTINGS);
+}
+
+/* rebuild some of a populated menu's sections */
+static void
+rebuild_sections (IndicatorPowerService * self, int profile, guint sections)
+{
+  priv_t * p = self->priv;
+  struct ProfileMenuInfo * info = &p->menus[profile];
+
+  switch (profile)
+    {
+      case PROFILE_PHONE:
+        if (sections & SECTION_SETTINGS)
+          rebuild_section (info->submenu, 1, create_phone_settings_section (self));
+        if ((sections & SECTION_REQUEST_STATS) && request_stats_enabled (self))
+          fill_request_stats_section (self);
+        break;
+
+      case PROFILE_DESKTOP:
+        if (sections & SECTION_DEVICES)
+          rebuild_section (info->submenu, 0, g_object_ref (get_devices_section (self)));
+        if (sections & SECTION_SETTINGS)
+          rebuild_section (info->submenu, 1, create_desktop_settings_section (self));
+        break;
+
+      case PROFILE_DESKTOP_GREETER:
+        if (sections & SECTION_DEVICES)
+          indicator_power_menu_filter_set_base (INDICATOR_POWER_MENU_FILTER (p->greeter_devices_section),
+                                                get_devices_section (self));
+        break;
+    }
+}
+
+/* rebuild the sections now if the menu's open, or flag them if it's not.
+   Returns the sections that were rebuilt. */
+static guint
+refresh_sections (IndicatorPowerService * self, int profile, guint sections)
+{
+  struct ProfileMenuInfo * info = &self->priv->menus[profile];
+
+  sections &= profile_sections[profile];
+
+  /* menus that have never been opened get built fresh when they are */
+  if (!sections || !info->populated)
+    return 0;
+
+  if (!menu_is_open (info))
+    {
+      info->dirty |= sections;
+      return 0;
+    }
+
+  rebuild_sections (self, profile, sections);
+  return sections;
+}
+
 static void
 rebuild_now (IndicatorPowerService * self, guint sections)
 {
   priv_t * p = self->priv;
-  struct ProfileMenuInfo * phone   = &p->menus[PROFILE_PHONE];
-  struct ProfileMenuInfo * desktop = &p->menus[PROFILE_DESKTOP];
-  struct ProfileMenuInfo * greeter = &p->menus[PROFILE_DESKTOP_GREETER];
+  guint rebuilt = 0;
+  int i;
 
-  if (sections & SECTION_HEADER)
+  if (p->display_off)
     {
-      g_simple_action_set_state (p->header_action, create_header_state (self));
+      p->deferred |= sections;
+      return;
     }
 
-  if (!p->menus_built)
-    return;
+  indicator_power_recorder_record (RECORD_REBUILD, sections);
 
-  if (sections & SECTION_DEVICES)
+  if (sections & SECTION_DEVICE_STATES)
     {
-      rebuild_section (desktop->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP));
-      rebuild_section (greeter->submenu, 0, create_desktop_devices_section (self, PROFILE_DESKTOP_GREETER));
+      set_action_state (p->battery_level_action, calculate_battery_level_action_state (self));
+      set_action_state (p->device_state_action, calculate_device_state_action_state (self));
     }
 
-  if (sections & SECTION_SETTINGS)
+  if (sections & SECTION_HEADER)
     {
-      rebuild_section (desktop->submenu, 1, create_desktop_settings_section (self));
-      rebuild_section (phone->submenu, 1, create_phone_settings_section (self));
+      indicator_power_metrics_inc (METRIC_REBUILDS_HEADER);
+      set_action_state (p->header_action, create_header_state (self));
     }
+
+  /* the shared devices section is rebuilt on demand */
+  if (sections & SECTION_DEVICES)
+    g_clear_object (&p->devices_section);
+
+  for (i=0; i<N_PROFILES; ++i)
+    rebuilt |= refresh_sections (self, i, sections);
+
+  count_rebuilds (rebuilt);
 }
 
 static inline void
@@ -731,20 +983,21 @@ rebuild_header_now (IndicatorPowerService * self)
   rebuild_now (self, SECTION_HEADER);
 }
 
+/* fill in a profile's sections */
 static void
-create_menu (IndicatorPowerService * self, int profile)
+populate_menu (IndicatorPowerService * self, int profile)
 {
-  GMenu * menu;
-  GMenu * submenu;
-  GMenuItem * header;
+  struct ProfileMenuInfo * info = &self->priv->menus[profile];
   GMenuModel * sections[16];
   guint i;
   guint n = 0;
 
   g_assert (0<=profile && profile<N_PROFILES);
-  g_assert (self->priv->menus[profile].menu == NULL);
 
-  /* build the sections */
+  if (info->populated)
+    return;
+
+  g_debug ("building the %s menu", menu_names[profile]);
 
   switch (profile)
     {
@@ -754,25 +1007,109 @@ create_menu (IndicatorPowerService * self, int profile)
         break;
 
       case PROFILE_DESKTOP:
-        sections[n++] = create_desktop_devices_section (self, PROFILE_DESKTOP);
+        sections[n++] = g_object_ref (get_devices_section (self));
         sections[n++] = create_desktop_settings_section (self);
         break;
 
       case PROFILE_DESKTOP_GREETER:
-        sections[n++] = create_desktop_devices_section (self, PROFILE_DESKTOP_GREETER);
+        indicator_power_menu_filter_set_base (INDICATOR_POWER_MENU_FILTER (self->priv->greeter_devices_section),
+                                              get_devices_section (self));
+        sections[n++] = g_object_ref (self->priv->greeter_devices_section);
         break;
     }
 
-  /* add sections to the submenu */
-
-  submenu = g_menu_new ();
-
   for (i=0; i<n; ++i)
     {
-      g_menu_append_section (submenu, NULL, sections[i]);
+      g_menu_append_section (info->submenu, NULL, sections[i]);
       g_object_unref (sections[i]);
     }
 
+  if ((profile == PROFILE_PHONE) && request_stats_enabled (self))
+    {
+      fill_request_stats_section (self);
+      g_menu_append_section (info->submenu, _("What's using power"),
+                             G_MENU_MODEL (self->priv->request_stats_section));
+    }
+
+  info->populated = TRUE;
+  info->dirty = 0;
+}
+
+/* only ask powerd for its stats while someone can see them */
+static void
+update_request_stats_active (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  gboolean active;
+
+  if ((p->request_stats == NULL) || (p->settings == NULL))
+    return;
+
+  active = request_stats_enabled (self)
+        && menu_is_open (&p->menus[PROFILE_PHONE])
+        && !p->display_off;
+
+  indicator_power_request_stats_set_active (p->request_stats, active);
+}
+
+/* someone's opened the menu, so bring it up to date in one pass */
+static void
+open_menu (IndicatorPowerService * self, int profile)
+{
+  struct ProfileMenuInfo * info = &self->priv->menus[profile];
+
+  if (!info->populated)
+    {
+      populate_menu (self, profile);
+    }
+  else if (info->dirty)
+    {
+      g_debug ("catching up the %s menu", menu_names[profile]);
+      rebuild_sections (self, profile, info->dirty);
+      count_rebuilds (info->dirty);
+      info->dirty = 0;
+    }
+
+  update_request_stats_active (self);
+}
+
+static void
+depopulate_menu (IndicatorPowerService * self, int profile)
+{
+  priv_t * p = self->priv;
+  struct ProfileMenuInfo * info = &p->menus[profile];
+
+  if (!info->populated)
+    return;
+
+  g_debug ("tearing down the %s menu", menu_names[profile]);
+  g_menu_remove_all (info->submenu);
+  info->populated = FALSE;
+  info->dirty = 0;
+
+  if (profile == PROFILE_DESKTOP_GREETER)
+    indicator_power_menu_filter_set_base (INDICATOR_POWER_MENU_FILTER (p->greeter_devices_section), NULL);
+
+  if (profile == PROFILE_PHONE)
+    update_request_stats_active (self);
+
+  if (!p->menus[PROFILE_DESKTOP].populated && !p->menus[PROFILE_DESKTOP_GREETER].populated)
+    g_clear_object (&p->devices_section);
+}
+
+/* create a profile's root menu and header, but not its sections */
+static void
+create_menu (IndicatorPowerService * self, int profile)
+{
+  GMenu * menu;
+  GMenu * submenu;
+  GMenuItem * header;
+
+  g_assert (0<=profile && profile<N_PROFILES);
+  g_assert (self->priv->menus[profile].menu == NULL);
+
+  submenu = g_menu_new ();
+
   /* add submenu to the header */
   header = g_menu_item_new (NULL, "indicator._header");
   g_menu_item_set_attribute (header, "x-canonical-type",
@@ -787,6 +1124,275 @@ create_menu (IndicatorPowerService * self, int profile)
 
   self->priv->menus[profile].menu = menu;
   self->priv->menus[profile].submenu = submenu;
+  self->priv->menus[profile].subscribers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/***
+****  Menu Subscribers
+****
+****  GDBus's menu exporter doesn't tell us who's subscribed to a menu,
+****  so we watch for org.gtk.Menus Start and End calls ourselves.
+****
+****  Clients subscribe to group 0, which is just the header item, for
+****  as long as they show the indicator. The header's submenu and its
+****  sections are in the groups after that, which clients only Start()
+****  while the menu is open. So a profile's menu counts as open while
+****  someone's subscribed to any group other than 0.
+***/
+
+static int
+profile_for_path (const gchar * path)
+{
+  int i;
+
+  if (!g_str_has_prefix (path, BUS_PATH"/"))
+    return -1;
+
+  for (i=0; i<N_PROFILES; ++i)
+    if (!g_strcmp0 (path + strlen(BUS_PATH"/"), menu_names[i]))
+      return i;
+
+  return -1;
+}
+
+static void unwatch_subscriber_if_unused (IndicatorPowerService * self, const gchar * sender);
+
+static void
+forget_subscriber (IndicatorPowerService * self, int profile, const gchar * sender, guint n_groups)
+{
+  struct ProfileMenuInfo * info = &self->priv->menus[profile];
+  const guint n = GPOINTER_TO_UINT (g_hash_table_lookup (info->subscribers, sender));
+
+  if (n == 0)
+    return;
+
+  if (n > n_groups)
+    g_hash_table_insert (info->subscribers, g_strdup (sender), GUINT_TO_POINTER (n - n_groups));
+  else
+    g_hash_table_remove (info->subscribers, sender);
+
+  if (!menu_is_open (info))
+    {
+      g_debug ("the %s menu was closed", menu_names[profile]);
+      update_request_stats_active (self);
+    }
+}
+
+static void
+on_subscriber_name_owner_changed (GDBusConnection * connection   G_GNUC_UNUSED,
+                                  const gchar     * sender_name  G_GNUC_UNUSED,
+                                  const gchar     * object_path  G_GNUC_UNUSED,
+                                  const gchar     * interface    G_GNUC_UNUSED,
+                                  const gchar     * signal_name  G_GNUC_UNUSED,
+                                  GVariant        * parameters,
+                                  gpointer          gself)
+{
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE (gself);
+  const gchar * name = NULL;
+  const gchar * new_owner = NULL;
+  gchar * sender;
+  int i;
+
+  g_variant_get (parameters, "(&s&s&s)", &name, NULL, &new_owner);
+  if (*new_owner != '\0')
+    return;
+
+  sender = g_strdup (name);
+  for (i=0; i<N_PROFILES; ++i)
+    forget_subscriber (self, i, sender, G_MAXUINT);
+  unwatch_subscriber_if_unused (self, sender);
+  g_free (sender);
+}
+
+static void
+watch_subscriber (IndicatorPowerService * self, const gchar * sender)
+{
+  priv_t * p = self->priv;
+  guint id;
+
+  if (g_hash_table_contains (p->subscriber_watches, sender))
+    return;
+
+  id = g_dbus_connection_signal_subscribe (p->conn,
+                                           "org.freedesktop.DBus",
+                                           "org.freedesktop.DBus",
+                                           "NameOwnerChanged",
+                                           "/org/freedesktop/DBus",
+                                           sender,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           on_subscriber_name_owner_changed,
+                                           self,
+                                           NULL);
+  g_hash_table_insert (p->subscriber_watches, g_strdup (sender), GUINT_TO_POINTER (id));
+}
+
+static void
+unwatch_subscriber_if_unused (IndicatorPowerService * self, const gchar * sender)
+{
+  priv_t * p = self->priv;
+  gpointer id;
+  int i;
+
+  for (i=0; i<N_PROFILES; ++i)
+    if (g_hash_table_contains (p->menus[i].subscribers, sender))
+      return;
+
+  if (g_hash_table_lookup_extended (p->subscriber_watches, sender, NULL, &id))
+    {
+      g_dbus_connection_signal_unsubscribe (p->conn, GPOINTER_TO_UINT (id));
+      g_hash_table_remove (p->subscriber_watches, sender);
+    }
+}
+
+typedef struct
+{
+  IndicatorPowerService * self;
+  gchar * sender;
+  int profile;
+  gboolean start;
+  guint n_groups;
+}
+MenusCall;
+
+static void
+menus_call_free (gpointer gcall)
+{
+  MenusCall * call = gcall;
+
+  g_object_unref (call->self);
+  g_free (call->sender);
+  g_free (call);
+}
+
+/* runs in our main context */
+static gboolean
+on_menus_call (gpointer gcall)
+{
+  MenusCall * call = gcall;
+  IndicatorPowerService * self = call->self;
+  priv_t * p = self->priv;
+  struct ProfileMenuInfo * info = &p->menus[call->profile];
+
+  if (p->conn == NULL)
+    return G_SOURCE_REMOVE;
+
+  if (call->n_groups == 0)
+    return G_SOURCE_REMOVE;
+
+  if (call->start)
+    {
+      const guint n = GPOINTER_TO_UINT (g_hash_table_lookup (info->subscribers, call->sender));
+      g_hash_table_insert (info->subscribers, g_strdup (call->sender), GUINT_TO_POINTER (n + call->n_groups));
+      watch_subscriber (self, call->sender);
+      open_menu (self, call->profile);
+    }
+  else
+    {
+      forget_subscriber (self, call->profile, call->sender, call->n_groups);
+      unwatch_subscriber_if_unused (self, call->sender);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* runs in GDBus's worker thread, so just pass the call along */
+static GDBusMessage *
+menus_filter (GDBusConnection * connection G_GNUC_UNUSED,
+              GDBusMessage    * message,
+              gboolean          incoming,
+              gpointer          gweak)
+{
+  IndicatorPowerService * self;
+  const gchar * member;
+  GVariant * body;
+  GVariant * groups;
+  GVariantIter iter;
+  guint32 group;
+  MenusCall * call;
+  const gchar * path;
+  int profile;
+
+  if (!incoming ||
+      (g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL) ||
+      g_strcmp0 (g_dbus_message_get_interface (message), "org.gtk.Menus"))
+    return message;
+
+  member = g_dbus_message_get_member (message);
+  if (g_strcmp0 (member, "Start") && g_strcmp0 (member, "End"))
+    return message;
+
+  body = g_dbus_message_get_body (message);
+  if ((body == NULL) || !g_variant_is_of_type (body, G_VARIANT_TYPE ("(au)")))
+    return message;
+
+  if (((path = g_dbus_message_get_path (message)) == NULL) || ((profile = profile_for_path (path)) < 0))
+    return message;
+
+  if ((self = g_weak_ref_get (gweak)) == NULL)
+    return message;
+
+  call = g_new0 (MenusCall, 1);
+  call->self = self;
+  call->sender = g_strdup (g_dbus_message_get_sender (message));
+  call->profile = profile;
+  call->start = !g_strcmp0 (member, "Start");
+  groups = g_variant_get_child_value (body, 0);
+  g_variant_iter_init (&iter, groups);
+  while (g_variant_iter_next (&iter, "u", &group))
+    if (group != 0) /* the header */
+      ++call->n_groups;
+  g_variant_unref (groups);
+  g_main_context_invoke_full (self->priv->context, G_PRIORITY_DEFAULT, on_menus_call, call, menus_call_free);
+
+  return message;
+}
+
+static void
+weak_ref_free (gpointer gweak)
+{
+  g_weak_ref_clear (gweak);
+  g_free (gweak);
+}
+
+static void
+menus_filter_add (IndicatorPowerService * self)
+{
+  GWeakRef * weak = g_new0 (GWeakRef, 1);
+
+  g_weak_ref_init (weak, self);
+  self->priv->menus_filter_id = g_dbus_connection_add_filter (self->priv->conn,
+                                                              menus_filter,
+                                                              weak,
+                                                              weak_ref_free);
+}
+
+static void
+menus_filter_remove (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  GHashTableIter iter;
+  gpointer id;
+  int i;
+
+  if (p->subscriber_watches == NULL) /* already disposed */
+    return;
+
+  if (p->menus_filter_id != 0)
+    {
+      g_dbus_connection_remove_filter (p->conn, p->menus_filter_id);
+      p->menus_filter_id = 0;
+    }
+
+  g_hash_table_iter_init (&iter, p->subscriber_watches);
+  while (g_hash_table_iter_next (&iter, NULL, &id))
+    g_dbus_connection_signal_unsubscribe (p->conn, GPOINTER_TO_UINT (id));
+  g_hash_table_remove_all (p->subscriber_watches);
+
+  for (i=0; i<N_PROFILES; ++i)
+    {
+      g_hash_table_remove_all (p->menus[i].subscribers);
+      depopulate_menu (self, i);
+    }
 }
 
 /***
@@ -989,6 +1595,9 @@ on_bus_acquired (GDBusConnection * connection,
   if (p->notifier != NULL)
     indicator_power_notifier_set_bus (p->notifier, connection);
 
+  /* export the metrics */
+  indicator_power_metrics_set_bus (connection);
+
   /* export the actions */
   if ((id = g_dbus_connection_export_action_group (connection,
                                                    BUS_PATH,
@@ -1004,6 +1613,7 @@ on_bus_acquired (GDBusConnection * connection,
     }
 
   /* export the menus */
+  menus_filter_add (self);
   for (i=0; i<N_PROFILES; ++i)
     {
       struct ProfileMenuInfo * menu = &p->menus[i];
@@ -1034,6 +1644,7 @@ unexport (IndicatorPowerService * self)
   priv_t * p = self->priv;
 
   /* unexport the menus */
+  menus_filter_remove (self);
   for (i=0; i<N_PROFILES; ++i)
     {
       guint * id = &self->priv->menus[i].export_id;
@@ -1051,6 +1662,9 @@ unexport (IndicatorPowerService * self)
       g_dbus_connection_unexport_action_group (p->conn, p->actions_export_id);
       p->actions_export_id = 0;
     }
+
+  /* unexport the metrics */
+  indicator_power_metrics_set_bus (NULL);
 }
 
 static void
@@ -1067,6 +1681,112 @@ on_name_lost (GDBusConnection * connection G_GNUC_UNUSED,
   g_signal_emit (self, signals[SIGNAL_NAME_LOST], 0, NULL);
 }
 
+/***
+****  Display State
+****
+****  On phones, powerd announces SysPowerStateChange(SUSPEND) when the
+****  display's turned off and ACTIVE when it's back on. Nobody can see
+****  the header, menus, or action states in between, so rebuild_now()
+****  holds them back and they're brought up to date in one pass after.
+****  The notifier isn't deferred, so low battery notifications and the
+****  Battery object's PowerLevel stay live.
+***/
+
+/* from powerd's powerd.h */
+#define POWERD_SYS_STATE_SUSPEND 0
+
+static void
+set_display_off (IndicatorPowerService * self, gboolean display_off)
+{
+  priv_t * p = self->priv;
+  guint deferred;
+
+  if (p->display_off == display_off)
+    return;
+
+  g_debug ("display is %s", display_off ? "off" : "on");
+  indicator_power_recorder_record (RECORD_DISPLAY_STATE, !display_off);
+  p->display_off = display_off;
+  update_request_stats_active (self);
+
+  if (!display_off && p->deferred)
+    {
+      deferred = p->deferred;
+      p->deferred = 0;
+      rebuild_now (self, deferred);
+    }
+}
+
+static void
+on_sys_power_state_change (DbusPowerd * powerd_proxy G_GNUC_UNUSED,
+                           gint         state,
+                           gpointer     gself)
+{
+  set_display_off (INDICATOR_POWER_SERVICE (gself), state == POWERD_SYS_STATE_SUSPEND);
+}
+
+static void
+on_powerd_name_owner_changed (GDBusProxy * powerd_proxy,
+                              GParamSpec * pspec         G_GNUC_UNUSED,
+                              gpointer     gself)
+{
+  gchar * owner = g_dbus_proxy_get_name_owner (powerd_proxy);
+
+  /* don't stay deferred if powerd goes away while the display's off */
+  if (owner == NULL)
+    set_display_off (INDICATOR_POWER_SERVICE (gself), FALSE);
+
+  g_free (owner);
+}
+
+static void
+on_powerd_proxy_ready (GObject      * source_object G_GNUC_UNUSED,
+                       GAsyncResult * res,
+                       gpointer       gself)
+{
+  GError * error = NULL;
+  DbusPowerd * powerd_proxy = dbus_powerd_proxy_new_for_bus_finish (res, &error);
+
+  if (powerd_proxy != NULL)
+    {
+      priv_t * p = INDICATOR_POWER_SERVICE (gself)->priv;
+
+      p->powerd_proxy = powerd_proxy;
+      indicator_power_request_stats_set_proxy (p->request_stats, powerd_proxy);
+      g_signal_connect (powerd_proxy, "sys-power-state-change",
+                        G_CALLBACK(on_sys_power_state_change), gself);
+      g_signal_connect (powerd_proxy, "notify::g-name-owner",
+                        G_CALLBACK(on_powerd_name_owner_changed), gself);
+    }
+  else if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Unable to get powerd proxy: %s", error->message);
+
+      g_error_free (error);
+    }
+}
+
+/***
+****  Shared Memory
+***/
+
+static void
+shm_writer_init (IndicatorPowerService * self)
+{
+  GError * error = NULL;
+  gchar * path = indicator_power_shm_writer_get_default_path ();
+
+  self->priv->shm_writer = indicator_power_shm_writer_new (path, &error);
+  if (error != NULL)
+    {
+      g_warning ("Unable to publish battery state: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (path);
+}
+
 /***
 ****  Events
 ***/
@@ -1074,6 +1794,7 @@ on_name_lost (GDBusConnection * connection G_GNUC_UNUSED,
 static void
 on_devices_changed (IndicatorPowerService * self)
 {
+  const gint64 begin = indicator_power_metrics_handler_begin ();
   priv_t * p = self->priv;
 
   /* update the device list */
@@ -1090,13 +1811,13 @@ on_devices_changed (IndicatorPowerService * self)
   else
     indicator_power_notifier_set_battery (p->notifier, NULL);
 
-  /* update the battery-level action's state */
-  g_simple_action_set_state (p->battery_level_action, calculate_battery_level_action_state(self));
+  /* like the notifier, this stays live while the display's off */
+  if (p->shm_writer != NULL)
+    indicator_power_shm_writer_publish (p->shm_writer, p->devices, p->primary_device);
 
-  /* update the device-state action's state */
-  g_simple_action_set_state (p->device_state_action, calculate_device_state_action_state(self));
+  rebuild_now (self, SECTION_HEADER | SECTION_DEVICES | SECTION_DEVICE_STATES);
 
-  rebuild_now (self, SECTION_HEADER | SECTION_DEVICES);
+  indicator_power_metrics_handler_end (G_STRFUNC, begin);
 }
 
 static void
@@ -1105,6 +1826,85 @@ on_auto_brightness_supported_changed(IndicatorPowerService * self)
   rebuild_now(self, SECTION_SETTINGS);
 }
 
+static void
+on_request_stats_changed (IndicatorPowerService * self)
+{
+  rebuild_now (self, SECTION_REQUEST_STATS);
+}
+
+/* a section's position in a menu, or -1 if it's not there */
+static gint
+find_section (GMenuModel * menu, GMenuModel * section)
+{
+  const gint n = g_menu_model_get_n_items (menu);
+  gint i;
+
+  for (i=0; i<n; ++i)
+    {
+      GMenuModel * link = g_menu_model_get_item_link (menu, i, G_MENU_LINK_SECTION);
+      const gboolean found = link == section;
+
+      g_clear_object (&link);
+      if (found)
+        return i;
+    }
+
+  return -1;
+}
+
+static void
+on_show_request_stats_changed (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  struct ProfileMenuInfo * phone = &p->menus[PROFILE_PHONE];
+
+  if (phone->populated)
+    {
+      const gboolean shown = find_section (G_MENU_MODEL (phone->submenu),
+                                           G_MENU_MODEL (p->request_stats_section)) >= 0;
+
+      /* let populate_menu() decide which sections go where */
+      if (shown != request_stats_enabled (self))
+        {
+          g_menu_remove_all (phone->submenu);
+          phone->populated = FALSE;
+          populate_menu (self, PROFILE_PHONE);
+        }
+    }
+
+  update_request_stats_active (self);
+}
+
+static void
+on_icon_theme_changed (IndicatorPowerService * self)
+{
+  rebuild_now (self, SECTION_HEADER | SECTION_DEVICES);
+}
+
+static void
+on_resolve_icons_changed (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  const gboolean resolve = g_settings_get_boolean (p->settings, SETTINGS_RESOLVE_ICONS_S);
+
+  if (resolve == (p->icon_theme != NULL))
+    return;
+
+  if (resolve)
+    {
+      p->icon_theme = indicator_power_icon_theme_new (NULL);
+      g_signal_connect_swapped (p->icon_theme, INDICATOR_POWER_ICON_THEME_SIGNAL_CHANGED,
+                                G_CALLBACK(on_icon_theme_changed), self);
+    }
+  else
+    {
+      g_signal_handlers_disconnect_by_data (p->icon_theme, self);
+      g_clear_object (&p->icon_theme);
+    }
+
+  rebuild_now (self, SECTION_HEADER | SECTION_DEVICES);
+}
+
 
 /***
 ****  GObject virtual functions
@@ -1133,6 +1933,14 @@ my_get_property (GObject     * o,
         g_value_set_object (value, p->notifier);
         break;
 
+      case PROP_CONTEXT:
+        g_value_set_boxed (value, p->context);
+        break;
+
+      case PROP_EMBEDDED:
+        g_value_set_boolean (value, p->embedded);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (o, property_id, pspec);
     }
@@ -1156,6 +1964,14 @@ my_set_property (GObject       * o,
         indicator_power_service_set_notifier (self, g_value_get_object (value));
         break;
 
+      case PROP_CONTEXT:
+        self->priv->context = g_value_dup_boxed (value);
+        break;
+
+      case PROP_EMBEDDED:
+        self->priv->embedded = g_value_get_boolean (value);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (o, property_id, pspec);
     }
@@ -1166,6 +1982,12 @@ my_dispose (GObject * o)
 {
   IndicatorPowerService * self = INDICATOR_POWER_SERVICE(o);
   priv_t * p = self->priv;
+  GMainContext * context = p->context;
+  int i;
+
+  /* our children remove their timers from the thread-default context */
+  if (context != NULL)
+    g_main_context_push_thread_default (context);
 
   if (p->own_id)
     {
@@ -1188,6 +2010,27 @@ my_dispose (GObject * o)
       g_clear_object (&p->settings);
     }
 
+  if (p->icon_theme != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->icon_theme, self);
+      g_clear_object (&p->icon_theme);
+    }
+
+  if (p->powerd_proxy != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->powerd_proxy, self);
+      g_clear_object (&p->powerd_proxy);
+    }
+
+  if (p->request_stats != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->request_stats, self);
+      g_clear_object (&p->request_stats);
+    }
+  g_clear_object (&p->request_stats_section);
+
+  g_clear_pointer (&p->shm_writer, indicator_power_shm_writer_free);
+
   g_clear_object (&p->notifier);
   g_clear_object (&p->brightness_action);
   g_clear_object (&p->brightness);
@@ -1197,9 +2040,21 @@ my_dispose (GObject * o)
 
   g_clear_object (&p->conn);
 
+  for (i=0; i<N_PROFILES; ++i)
+    g_clear_pointer (&p->menus[i].subscribers, g_hash_table_destroy);
+  g_clear_pointer (&p->subscriber_watches, g_hash_table_destroy);
+  g_clear_object (&p->devices_section);
+  g_clear_object (&p->greeter_devices_section);
+
   indicator_power_service_set_device_provider (self, NULL);
   indicator_power_service_set_notifier (self, NULL);
 
+  if (context != NULL)
+    {
+      g_main_context_pop_thread_default (context);
+      g_clear_pointer (&p->context, g_main_context_unref);
+    }
+
   G_OBJECT_CLASS (indicator_power_service_parent_class)->dispose (o);
 }
 
@@ -1208,15 +2063,19 @@ my_dispose (GObject * o)
 ***/
 
 static void
-indicator_power_service_init (IndicatorPowerService * self)
+my_constructed (GObject * o)
 {
-  priv_t * p;
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE (o);
+  priv_t * p = self->priv;
   int i;
 
-  p = G_TYPE_INSTANCE_GET_PRIVATE (self,
-                                   INDICATOR_TYPE_POWER_SERVICE,
-                                   IndicatorPowerServicePrivate);
-  self->priv = p;
+  G_OBJECT_CLASS (indicator_power_service_parent_class)->constructed (o);
+
+  /* everything below that waits on a GMainContext -- GSettings, the
+     bus proxies, file monitors, timers -- uses the thread-default one */
+  if (p->context == NULL)
+    p->context = g_main_context_ref_thread_default ();
+  g_main_context_push_thread_default (p->context);
 
   p->cancellable = g_cancellable_new ();
 
@@ -1229,22 +2088,59 @@ indicator_power_service_init (IndicatorPowerService * self)
   init_gactions (self);
 
   g_signal_connect_swapped (p->settings, "changed", G_CALLBACK(rebuild_header_now), self);
-
+  g_signal_connect_swapped (p->settings, "changed::" SETTINGS_RESOLVE_ICONS_S,
+                            G_CALLBACK(on_resolve_icons_changed), self);
+  g_signal_connect_swapped (p->settings, "changed::" SETTINGS_SHOW_REQUEST_STATS_S,
+                            G_CALLBACK(on_show_request_stats_changed), self);
+
+  shm_writer_init (self);
+
+  p->request_stats = indicator_power_request_stats_new ();
+  p->request_stats_section = g_menu_new ();
+  g_signal_connect_swapped (p->request_stats, INDICATOR_POWER_REQUEST_STATS_SIGNAL_CHANGED,
+                            G_CALLBACK(on_request_stats_changed), self);
+
+  p->subscriber_watches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  p->greeter_devices_section = indicator_power_menu_filter_new (NULL, (const gchar * const []) {
+                                                                  G_MENU_ATTRIBUTE_ACTION,
+                                                                  G_MENU_ATTRIBUTE_TARGET,
+                                                                  NULL });
   for (i=0; i<N_PROFILES; ++i)
     create_menu(self, i);
-  p->menus_built = TRUE;
+
+  on_resolve_icons_changed (self);
+
+  dbus_powerd_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+                                 "com.canonical.powerd",
+                                 "/com/canonical/powerd",
+                                 p->cancellable,
+                                 on_powerd_proxy_ready,
+                                 self);
 
   g_signal_connect_swapped(p->brightness, "notify::auto-brightness-supported",
                            G_CALLBACK(on_auto_brightness_supported_changed), self);
 
-  p->own_id = g_bus_own_name(G_BUS_TYPE_SESSION,
-                             BUS_NAME,
-                             G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
-                             on_bus_acquired,
-                             NULL,
-                             on_name_lost,
-                             self,
-                             NULL);
+  if (!p->embedded)
+    p->own_id = g_bus_own_name(G_BUS_TYPE_SESSION,
+                               BUS_NAME,
+                               G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
+                               on_bus_acquired,
+                               NULL,
+                               on_name_lost,
+                               self,
+                               NULL);
+
+  g_main_context_pop_thread_default (p->context);
+}
+
+static void
+indicator_power_service_init (IndicatorPowerService * self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+                                            INDICATOR_TYPE_POWER_SERVICE,
+                                            IndicatorPowerServicePrivate);
 }
 
 static void
@@ -1252,6 +2148,7 @@ indicator_power_service_class_init (IndicatorPowerServiceClass * klass)
 {
   GObjectClass * object_class = G_OBJECT_CLASS (klass);
 
+  object_class->constructed = my_constructed;
   object_class->dispose = my_dispose;
   object_class->get_property = my_get_property;
   object_class->set_property = my_set_property;
@@ -1290,6 +2187,20 @@ indicator_power_service_class_init (IndicatorPowerServiceClass * klass)
     G_TYPE_OBJECT,
     G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_CONTEXT] = g_param_spec_boxed (
+    "context",
+    "Context",
+    "GMainContext to run in, or NULL for the thread-default one",
+    G_TYPE_MAIN_CONTEXT,
+    G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_EMBEDDED] = g_param_spec_boolean (
+    "embedded",
+    "Embedded",
+    "Whether to run in-process instead of exporting menus/actions on the bus",
+    FALSE,
+    G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
@@ -1309,6 +2220,69 @@ indicator_power_service_new (IndicatorPowerDeviceProvider * device_provider,
   return INDICATOR_POWER_SERVICE (o);
 }
 
+IndicatorPowerService *
+indicator_power_service_new_embedded (IndicatorPowerDeviceProvider * device_provider,
+                                      IndicatorPowerNotifier       * notifier,
+                                      GMainContext                 * context)
+{
+  GObject * o;
+
+  /* the provider's first devices-changed is handled during construction */
+  if (context != NULL)
+    g_main_context_push_thread_default (context);
+
+  o = g_object_new (INDICATOR_TYPE_POWER_SERVICE,
+                    "context", context,
+                    "embedded", TRUE,
+                    "device-provider", device_provider,
+                    "notifier", notifier,
+                    NULL);
+
+  if (context != NULL)
+    g_main_context_pop_thread_default (context);
+
+  return INDICATOR_POWER_SERVICE (o);
+}
+
+GMenuModel *
+indicator_power_service_get_menu (IndicatorPowerService * self,
+                                  const gchar           * profile_name)
+{
+  priv_t * p;
+  int i;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_SERVICE (self), NULL);
+  g_return_val_if_fail (self->priv->embedded, NULL);
+  p = self->priv;
+
+  for (i=0; i<N_PROFILES; ++i)
+    {
+      if (g_strcmp0 (profile_name, menu_names[i]))
+        continue;
+
+      if (!p->menus[i].held_open)
+        {
+          p->menus[i].held_open = TRUE;
+          g_main_context_push_thread_default (p->context);
+          open_menu (self, i);
+          g_main_context_pop_thread_default (p->context);
+        }
+
+      return G_MENU_MODEL (p->menus[i].menu);
+    }
+
+  g_warning ("%s: no such menu profile '%s'", G_STRFUNC, profile_name);
+  return NULL;
+}
+
+GActionGroup *
+indicator_power_service_get_action_group (IndicatorPowerService * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_SERVICE (self), NULL);
+
+  return G_ACTION_GROUP (self->priv->actions);
+}
+
 void
 indicator_power_service_set_device_provider (IndicatorPowerService * self,
                                              IndicatorPowerDeviceProvider * dp)
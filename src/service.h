@@ -22,6 +22,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h> /* GMenuModel, GActionGroup */
 
 #include "device-provider.h"
 #include "notifier.h"
@@ -68,6 +69,31 @@ GType indicator_power_service_get_type (void);
 IndicatorPowerService * indicator_power_service_new (IndicatorPowerDeviceProvider * provider,
                                                      IndicatorPowerNotifier       * notifier);
 
+/**
+ * Creates a service that runs inside the calling process instead of
+ * owning a bus name and exporting its menus and actions. Its sources
+ * are attached to context (NULL for the thread-default context), which
+ * the host must iterate as the thread-default, as GIO expects, and from
+ * which it must call into the service.
+ */
+IndicatorPowerService * indicator_power_service_new_embedded (IndicatorPowerDeviceProvider * provider,
+                                                              IndicatorPowerNotifier       * notifier,
+                                                              GMainContext                 * context);
+
+/**
+ * An embedded service's menu for the given profile, e.g. "phone" or
+ * "desktop". The menu's built on the first call and kept up to date
+ * from then on. Its items refer to actions in the "indicator" namespace,
+ * so insert indicator_power_service_get_action_group() under that name.
+ *
+ * Return value: (transfer none): the menu, or NULL if there's no such profile
+ */
+GMenuModel * indicator_power_service_get_menu (IndicatorPowerService * self,
+                                               const gchar           * profile_name);
+
+/* Return value: (transfer none): the actions that the menus refer to */
+GActionGroup * indicator_power_service_get_action_group (IndicatorPowerService * self);
+
 void indicator_power_service_set_device_provider (IndicatorPowerService        * self,
                                                   IndicatorPowerDeviceProvider * provider);
 
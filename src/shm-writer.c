@@ -0,0 +1,224 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* mmap(), ftruncate(), O_CLOEXEC */
+
+#include "shm-writer.h"
+
+#include <indicator-power/battery-shm.h>
+
+#include <gio/gio.h> /* g_io_error_from_errno() */
+#include <glib/gstdio.h>
+
+struct _IndicatorPowerShmWriter
+{
+  gchar * path;
+  int fd;
+  struct indicator_power_shm * shm;
+};
+
+/***
+****  The writer's half of the seqlock
+***/
+
+static void
+write_begin (struct indicator_power_shm * shm)
+{
+  const uint32_t seq = __atomic_load_n (&shm->seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n (&shm->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static void
+write_end (struct indicator_power_shm * shm)
+{
+  const uint32_t seq = __atomic_load_n (&shm->seq, __ATOMIC_RELAXED);
+
+  ++shm->state.generation;
+  __atomic_store_n (&shm->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/***
+****
+***/
+
+static void
+set_error_from_errno (GError ** error, int err, const gchar * what, const gchar * path)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               g_io_error_from_errno (err),
+               "Unable to %s \"%s\": %s",
+               what, path, g_strerror (err));
+}
+
+gchar *
+indicator_power_shm_writer_get_default_path (void)
+{
+  /* the same as indicator_power_shm_get_path(),
+     but honoring GLib's fallback if XDG_RUNTIME_DIR isn't set */
+  return g_build_filename (g_get_user_runtime_dir (), INDICATOR_POWER_SHM_BASENAME, NULL);
+}
+
+IndicatorPowerShmWriter *
+indicator_power_shm_writer_new (const gchar * path, GError ** error)
+{
+  IndicatorPowerShmWriter * self;
+  struct indicator_power_shm * shm;
+  gchar * dir;
+  gchar * tmp;
+  void * map;
+  int fd;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) < 0)
+    {
+      set_error_from_errno (error, errno, "create", dir);
+      g_free (dir);
+      return NULL;
+    }
+  g_free (dir);
+
+  /* build it beside the old one, then swap it in all at once
+     so that readers never see a half-initialized segment */
+  tmp = g_strdup_printf ("%s.XXXXXX", path);
+  if ((fd = g_mkstemp_full (tmp, O_RDWR | O_CLOEXEC, 0644)) < 0)
+    {
+      set_error_from_errno (error, errno, "create", tmp);
+      g_free (tmp);
+      return NULL;
+    }
+
+  map = MAP_FAILED;
+  if ((ftruncate (fd, sizeof (struct indicator_power_shm)) < 0) ||
+      ((map = mmap (NULL, sizeof (struct indicator_power_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED))
+    {
+      set_error_from_errno (error, errno, "map", tmp);
+      g_unlink (tmp);
+      g_free (tmp);
+      close (fd);
+      return NULL;
+    }
+
+  shm = map;
+  shm->magic = INDICATOR_POWER_SHM_MAGIC;
+  shm->version = INDICATOR_POWER_SHM_VERSION;
+  shm->size = sizeof (struct indicator_power_shm);
+  shm->state.primary = -1;
+
+  if (g_rename (tmp, path) < 0)
+    {
+      set_error_from_errno (error, errno, "rename", tmp);
+      munmap (map, sizeof (struct indicator_power_shm));
+      g_unlink (tmp);
+      g_free (tmp);
+      close (fd);
+      return NULL;
+    }
+
+  g_free (tmp);
+
+  self = g_new0 (IndicatorPowerShmWriter, 1);
+  self->path = g_strdup (path);
+  self->fd = fd;
+  self->shm = shm;
+  return self;
+}
+
+static void
+copy_device (struct indicator_power_shm_device * d,
+             const IndicatorPowerDevice        * device)
+{
+  const gchar * object_path;
+
+  d->kind = indicator_power_device_get_kind (device);
+  d->state = indicator_power_device_get_state (device);
+  d->percentage = indicator_power_device_get_percentage (device);
+  d->time = indicator_power_device_get_time (device);
+  d->power_supply = indicator_power_device_get_power_supply (device) ? 1 : 0;
+
+  /* a totalled battery has no object path */
+  memset (d->object_path, 0, sizeof (d->object_path));
+  if ((object_path = indicator_power_device_get_object_path (device)))
+    g_strlcpy (d->object_path, object_path, sizeof (d->object_path));
+}
+
+void
+indicator_power_shm_writer_publish (IndicatorPowerShmWriter * self,
+                                    GList                   * devices,
+                                    IndicatorPowerDevice    * primary)
+{
+  struct indicator_power_shm_state * state;
+  GList * l;
+  uint32_t n = 0;
+
+  g_return_if_fail (self != NULL);
+  state = &self->shm->state;
+
+  write_begin (self->shm);
+
+  state->primary = -1;
+
+  for (l=devices; l!=NULL && n<INDICATOR_POWER_SHM_MAX_DEVICES; l=l->next)
+    {
+      copy_device (&state->devices[n], l->data);
+
+      if (l->data == primary)
+        state->primary = (int32_t) n;
+
+      ++n;
+    }
+
+  state->n_devices = n;
+
+  /* the primary may be a total that's not in the list, so it gets its own slot */
+  if (primary != NULL)
+    copy_device (&state->primary_device, primary);
+  else
+    memset (&state->primary_device, 0, sizeof (state->primary_device));
+  state->has_primary = primary != NULL ? 1 : 0;
+
+  write_end (self->shm);
+}
+
+void
+indicator_power_shm_writer_free (IndicatorPowerShmWriter * self)
+{
+  GStatBuf path_st;
+  struct stat fd_st;
+
+  if (self == NULL)
+    return;
+
+  write_begin (self->shm);
+  self->shm->state.flags |= INDICATOR_POWER_SHM_RETIRED;
+  write_end (self->shm);
+
+  /* remove it unless another writer's replaced it already */
+  if ((g_stat (self->path, &path_st) == 0) &&
+      (fstat (self->fd, &fd_st) == 0) &&
+      (path_st.st_dev == fd_st.st_dev) &&
+      (path_st.st_ino == fd_st.st_ino))
+    g_unlink (self->path);
+
+  munmap (self->shm, sizeof (struct indicator_power_shm));
+  close (self->fd);
+  g_free (self->path);
+  g_free (self);
+}
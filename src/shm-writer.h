@@ -0,0 +1,49 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_SHM_WRITER_H__
+#define __INDICATOR_POWER_SHM_WRITER_H__
+
+#include <glib.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Publishes the device list in the shared memory segment
+ * described in <indicator-power/battery-shm.h>
+ */
+typedef struct _IndicatorPowerShmWriter IndicatorPowerShmWriter;
+
+/* Returns: (transfer full): where readers look for the segment */
+gchar *                   indicator_power_shm_writer_get_default_path (void);
+
+/* Creates a new segment and atomically replaces any old one at path */
+IndicatorPowerShmWriter * indicator_power_shm_writer_new     (const gchar              * path,
+                                                              GError                  ** error);
+
+/* devices: (element-type IndicatorPowerDevice) */
+void                      indicator_power_shm_writer_publish (IndicatorPowerShmWriter  * self,
+                                                              GList                    * devices,
+                                                              IndicatorPowerDevice     * primary);
+
+/* Marks the segment as retired for any readers, and removes it */
+void                      indicator_power_shm_writer_free    (IndicatorPowerShmWriter  * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_SHM_WRITER_H__ */
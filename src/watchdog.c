@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.h"
+#include "watchdog.h"
+
+static GMainContext * watched_context = NULL;
+static GPollFunc real_poll = NULL;
+static gint64 threshold_usec = 0;
+
+/* when the last poll() returned, i.e. when this iteration's dispatch began */
+static gint64 dispatch_begin = 0;
+
+/* the first handler this iteration that went over the threshold on its own.
+   Nested handlers finish before their callers, so this is the innermost one */
+static const char * culprit_name = NULL;
+
+/* the slowest handler timed during this iteration */
+static const char * slowest_name = NULL;
+static gint64 slowest_usec = 0;
+
+static void
+check_iteration (gint64 now)
+{
+  const gint64 usec = now - dispatch_begin;
+
+  if ((dispatch_begin != 0) && (usec > threshold_usec))
+    {
+      const char * name;
+
+      if (culprit_name != NULL)
+        name = culprit_name;
+      else if (slowest_name != NULL)
+        name = slowest_name;
+      else
+        name = "(unattributed)";
+
+      indicator_power_metrics_record_stall (name, usec);
+      g_message ("main loop stalled for %" G_GINT64_FORMAT " ms in %s",
+                 usec / 1000,
+                 name);
+    }
+
+  culprit_name = NULL;
+  slowest_name = NULL;
+  slowest_usec = 0;
+}
+
+static gint
+watchdog_poll (GPollFD * fds, guint nfds, gint timeout)
+{
+  gint ret;
+
+  check_iteration (g_get_monotonic_time ());
+
+  ret = real_poll (fds, nfds, timeout);
+
+  dispatch_begin = g_get_monotonic_time ();
+  return ret;
+}
+
+/***
+****
+***/
+
+guint
+indicator_power_watchdog_parse_threshold (const gchar * str)
+{
+  gchar * end = NULL;
+  guint64 msec = 0;
+
+  if ((str != NULL) && g_ascii_isdigit (*str))
+    msec = g_ascii_strtoull (str, &end, 10);
+
+  if ((msec == 0) || (msec > G_MAXUINT) || (*end != '\0'))
+    {
+      g_warning ("Invalid stall threshold '%s'; using %u msec",
+                 str ? str : "(null)", INDICATOR_POWER_WATCHDOG_DEFAULT_MSEC);
+      return INDICATOR_POWER_WATCHDOG_DEFAULT_MSEC;
+    }
+
+  return (guint) msec;
+}
+
+void
+indicator_power_watchdog_start (GMainContext * context,
+                                guint          threshold_msec)
+{
+  g_return_if_fail (watched_context == NULL);
+  g_return_if_fail (threshold_msec > 0);
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  watched_context = g_main_context_ref (context);
+  threshold_usec = (gint64)threshold_msec * 1000;
+  dispatch_begin = 0;
+  culprit_name = NULL;
+  slowest_name = NULL;
+  slowest_usec = 0;
+
+  real_poll = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, watchdog_poll);
+}
+
+void
+indicator_power_watchdog_stop (void)
+{
+  if (watched_context == NULL)
+    return;
+
+  g_main_context_set_poll_func (watched_context, real_poll);
+  g_clear_pointer (&watched_context, g_main_context_unref);
+  real_poll = NULL;
+}
+
+void
+indicator_power_watchdog_note_handler (const char * handler_name,
+                                       gint64       usec)
+{
+  if (watched_context == NULL)
+    return;
+
+  if ((culprit_name == NULL) && (usec > threshold_usec))
+    culprit_name = handler_name;
+
+  if (usec > slowest_usec)
+    {
+      slowest_name = handler_name;
+      slowest_usec = usec;
+    }
+}
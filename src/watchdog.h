@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_WATCHDOG_H__
+#define __INDICATOR_POWER_WATCHDOG_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * An optional main-loop stall detector.
+ *
+ * It wraps the context's poll function to measure how long each main
+ * loop iteration spends outside of poll(), i.e. dispatching. When an
+ * iteration takes longer than the threshold, the stall is blamed on the
+ * innermost handler timed by metrics.h that was over the threshold by
+ * itself -- or failing that, the slowest one -- then counted in the
+ * Metrics interface's GetStalls and logged.
+ *
+ * The service starts it when INDICATOR_POWER_STALL_MSEC is set.
+ */
+
+#define INDICATOR_POWER_WATCHDOG_DEFAULT_MSEC 100
+
+void indicator_power_watchdog_start         (GMainContext * context,
+                                             guint          threshold_msec);
+
+/* parses INDICATOR_POWER_STALL_MSEC, falling back to the default
+   with a warning if it's not a positive number */
+guint indicator_power_watchdog_parse_threshold (const gchar * str);
+
+void indicator_power_watchdog_stop          (void);
+
+/* called by metrics.c whenever a handler's been timed */
+void indicator_power_watchdog_note_handler  (const char   * handler_name,
+                                             gint64         usec);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_WATCHDOG_H__ */
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alloc-counter.h"
+
+#include <cstddef> // size_t
+
+/* glibc's real allocator */
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t nmemb, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+}
+
+namespace
+{
+  // these must stay trivially-initialized, since they're
+  // touched from inside malloc() on every thread
+  thread_local int depth = 0;
+  thread_local guint64 n_allocs = 0;
+  thread_local guint64 n_bytes = 0;
+
+  inline void count(size_t size)
+  {
+    if (depth > 0)
+      {
+        ++n_allocs;
+        n_bytes += size;
+      }
+  }
+}
+
+extern "C"
+{
+  void* malloc(size_t size)
+  {
+    count(size);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t nmemb, size_t size)
+  {
+    count(nmemb * size);
+    return __libc_calloc(nmemb, size);
+  }
+
+  void* realloc(void* ptr, size_t size)
+  {
+    count(size);
+    return __libc_realloc(ptr, size);
+  }
+}
+
+/***
+****
+***/
+
+AllocCounter::AllocCounter()
+{
+  ++depth;
+  reset();
+}
+
+AllocCounter::~AllocCounter()
+{
+  --depth;
+}
+
+guint64
+AllocCounter::allocs() const
+{
+  return n_allocs - allocs_at_start_;
+}
+
+guint64
+AllocCounter::bytes() const
+{
+  return n_bytes - bytes_at_start_;
+}
+
+void
+AllocCounter::reset()
+{
+  allocs_at_start_ = n_allocs;
+  bytes_at_start_ = n_bytes;
+}
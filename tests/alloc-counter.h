@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/**
+ * Counts the heap allocations made by the current thread while it's alive.
+ *
+ * alloc-counter.cc interposes malloc(), calloc() and realloc(), so any
+ * executable that counts allocations must compile it in directly.
+ * GMemVTable can't be used for this: g_mem_set_vtable() has been a no-op
+ * since GLib 2.46. Set G_SLICE=always-malloc so that GSlice goes through
+ * malloc too.
+ *
+ * Counters nest, and only count the thread that created them.
+ */
+class AllocCounter
+{
+public:
+
+  AllocCounter();
+  ~AllocCounter();
+
+  AllocCounter(const AllocCounter&) =delete;
+  AllocCounter& operator=(const AllocCounter&) =delete;
+
+  /* number of allocations since construction or the last reset() */
+  guint64 allocs() const;
+
+  /* number of bytes requested since construction or the last reset() */
+  guint64 bytes() const;
+
+  void reset();
+
+private:
+
+  guint64 allocs_at_start_ {};
+  guint64 bytes_at_start_ {};
+};
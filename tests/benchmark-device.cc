@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks for the device.c functions that get called on every
+ * menu rebuild. Each one is run over every kind/state/percentage/time
+ * combination and reported as one JSON object per line.
+ *
+ * Run it with G_SLICE=always-malloc so that GSlice allocations get counted.
+ */
+
+#include "alloc-counter.h"
+
+#include "device.h"
+
+#include <gio/gio.h>
+
+#include <locale.h> // setlocale()
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace
+{
+  std::vector<IndicatorPowerDevice*> create_devices()
+  {
+    static const double percentages[] = { 0.0, 2.0, 5.0, 10.0, 33.0, 50.0, 75.0, 99.0, 100.0 };
+    static const time_t times[] = { 0, 59*60, 2*60*60, 30*60*60 };
+
+    std::vector<IndicatorPowerDevice*> devices;
+    for (int kind=UP_DEVICE_KIND_UNKNOWN; kind<UP_DEVICE_KIND_LAST; ++kind)
+      for (int state=UP_DEVICE_STATE_UNKNOWN; state<UP_DEVICE_STATE_LAST; ++state)
+        for (const auto& percentage : percentages)
+          for (const auto& time : times)
+            devices.push_back(indicator_power_device_new("/org/freedesktop/UPower/devices/test",
+                                                         UpDeviceKind(kind),
+                                                         percentage,
+                                                         UpDeviceState(state),
+                                                         time,
+                                                         true));
+    return devices;
+  }
+
+  void run(const char* name,
+           const std::vector<IndicatorPowerDevice*>& devices,
+           guint iterations,
+           const std::function<void(IndicatorPowerDevice*)>& func)
+  {
+    // warm up any lazily-created statics, e.g. GTypes and gettext
+    for (const auto& device : devices)
+      func(device);
+
+    AllocCounter counter;
+    const auto begin = g_get_monotonic_time();
+    for (guint i=0; i<iterations; ++i)
+      for (const auto& device : devices)
+        func(device);
+    const auto end = g_get_monotonic_time();
+    const auto allocs = counter.allocs();
+    const auto bytes = counter.bytes();
+
+    const double ops = double(iterations) * devices.size();
+    printf("{\"benchmark\":\"device\",\"function\":\"%s\",\"ops\":%.0f,"
+           "\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+           name,
+           ops,
+           (end - begin) * 1000.0 / ops,
+           allocs / ops,
+           bytes / ops);
+    fflush(stdout);
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  gint iterations {100};
+
+  GOptionEntry entries[] = {
+    { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Passes over all the devices (default: 100)", "N" },
+    { nullptr }
+  };
+
+  GError* error {};
+  auto context = g_option_context_new("- benchmark device.c's formatting and icon functions");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+      g_printerr("%s\n", error->message);
+      g_clear_error(&error);
+      g_option_context_free(context);
+      return 1;
+    }
+  g_option_context_free(context);
+
+  setlocale(LC_ALL, "C.UTF-8");
+
+  const auto devices = create_devices();
+  const auto n = guint(MAX(1, iterations));
+
+  run("get_icon_names", devices, n, [](IndicatorPowerDevice* device){
+    g_strfreev(indicator_power_device_get_icon_names(device));
+  });
+
+  run("get_gicon", devices, n, [](IndicatorPowerDevice* device){
+    auto gicon = indicator_power_device_get_gicon(device);
+    g_clear_object(&gicon);
+  });
+
+  run("get_readable_text", devices, n, [](IndicatorPowerDevice* device){
+    g_free(indicator_power_device_get_readable_text(device));
+  });
+
+  run("get_accessible_text", devices, n, [](IndicatorPowerDevice* device){
+    g_free(indicator_power_device_get_accessible_text(device));
+  });
+
+  run("get_readable_title", devices, n, [](IndicatorPowerDevice* device){
+    g_free(indicator_power_device_get_readable_title(device, true, false));
+    g_free(indicator_power_device_get_readable_title(device, false, true));
+    g_free(indicator_power_device_get_readable_title(device, true, true));
+  });
+
+  run("get_accessible_title", devices, n, [](IndicatorPowerDevice* device){
+    g_free(indicator_power_device_get_accessible_title(device, true, false));
+  });
+
+  for (auto& device : devices)
+    g_object_unref(device);
+  return 0;
+}
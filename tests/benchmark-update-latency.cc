@@ -0,0 +1,445 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how long it takes a UPower PropertiesChanged signal to show up
+ * as a change in the `indicator._header` action state and in the desktop
+ * menu, as seen by a client on the bus.
+ *
+ * Everything runs on a private bus: FakeUPower and the client each get
+ * their own thread, and the service runs on the main thread.
+ *
+ * Each event sets the battery's TimeToEmpty to a unique number of minutes,
+ * so the client can tell which event caused the "(H:MM)" header label
+ * and the "Battery (H:MM left)" menu item that it sees.
+ *
+ * Results are printed to stdout as one JSON object per line.
+ */
+
+#include "fake-upower.h"
+
+#include "dbus-shared.h"
+#include "device-provider-upower.h"
+#include "notifier.h"
+#include "service.h"
+
+#include <gio/gio.h>
+
+#include <sys/resource.h> // getrusage()
+
+#include <algorithm>
+#include <cmath> // std::ceil()
+#include <cstdio>
+#include <cstring> // strchr()
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // distinct "H:MM" values under 24 hours, which is as long as
+  // device.c considers a time-remaining estimate to be relevant
+  constexpr guint N_TOKENS {24*60 - 1};
+
+  gint64 token_to_seconds(guint token)
+  {
+    return gint64(token + 1) * 60;
+  }
+
+  bool label_to_token(const char* label, guint& setme)
+  {
+    const char* paren = label ? strchr(label, '(') : nullptr;
+    int hours, minutes;
+    if ((paren == nullptr) || (sscanf(paren+1, "%d:%d", &hours, &minutes) != 2))
+      return false;
+    const int total = hours*60 + minutes;
+    if ((total < 1) || (total > int(N_TOKENS)))
+      return false;
+    setme = guint(total - 1);
+    return true;
+  }
+
+  gint64 thread_cpu_usec()
+  {
+    struct rusage r;
+    getrusage(RUSAGE_THREAD, &r);
+    return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * G_USEC_PER_SEC
+         + (r.ru_utime.tv_usec + r.ru_stime.tv_usec);
+  }
+
+  /***
+  ****
+  ***/
+
+  struct Samples
+  {
+    std::vector<gint64> pending = std::vector<gint64>(N_TOKENS, 0);
+    std::vector<gint64> latencies;
+
+    void on_emitted(guint token, gint64 when)
+    {
+      pending[token] = when;
+    }
+
+    void on_seen(guint token, gint64 when)
+    {
+      if (pending[token] != 0)
+        {
+          latencies.push_back(when - pending[token]);
+          pending[token] = 0;
+        }
+    }
+
+    gint64 percentile(double p) const
+    {
+      if (latencies.empty())
+        return 0;
+      auto sorted = latencies;
+      std::sort(sorted.begin(), sorted.end());
+      const auto i = std::max(0, int(std::ceil(p * sorted.size())) - 1);
+      return sorted[std::min(size_t(i), sorted.size()-1)];
+    }
+
+    std::string to_json() const
+    {
+      auto tmp = g_strdup_printf("{\"matched\":%zu,\"p50_us\":%" G_GINT64_FORMAT
+                                 ",\"p99_us\":%" G_GINT64_FORMAT ",\"max_us\":%" G_GINT64_FORMAT "}",
+                                 latencies.size(), percentile(0.50), percentile(0.99), percentile(1.0));
+      std::string ret {tmp};
+      g_free(tmp);
+      return ret;
+    }
+  };
+
+  /**
+   * Listens to the service's actions and desktop menu from its own thread
+   */
+  class Client
+  {
+  public:
+
+    Client(const char* bus_address, GMutex* mutex, Samples* header, Samples* menu):
+      address_(bus_address), mutex_(mutex), header_(header), menu_(menu)
+    {
+      g_mutex_init(&ready_mutex_);
+      context_ = g_main_context_new();
+      loop_ = g_main_loop_new(context_, false);
+      thread_ = g_thread_new("client", thread_func, this);
+    }
+
+    ~Client()
+    {
+      g_main_context_invoke(context_, [](gpointer loop){
+        g_main_loop_quit(static_cast<GMainLoop*>(loop));
+        return G_SOURCE_REMOVE;
+      }, loop_);
+      g_thread_join(thread_);
+      g_main_loop_unref(loop_);
+      g_main_context_unref(context_);
+      g_mutex_clear(&ready_mutex_);
+    }
+
+    /* true once we've subscribed to the menus. Until then, the main
+       loop needs to keep running so that the service can answer us. */
+    bool is_ready()
+    {
+      g_mutex_lock(&ready_mutex_);
+      const auto ready = ready_;
+      g_mutex_unlock(&ready_mutex_);
+      return ready;
+    }
+
+  private:
+
+    static gpointer thread_func(gpointer gself)
+    {
+      auto self = static_cast<Client*>(gself);
+      g_main_context_push_thread_default(self->context_);
+
+      GError* error {};
+      auto bus = g_dbus_connection_new_for_address_sync(self->address_.c_str(),
+                                                        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|
+                                                                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                        nullptr, nullptr, &error);
+      g_assert_no_error(error);
+      g_dbus_connection_set_exit_on_close(bus, false);
+
+      const auto menu_path = std::string(BUS_PATH) + "/desktop";
+      const auto actions_tag = g_dbus_connection_signal_subscribe(bus, BUS_NAME, "org.gtk.Actions", "Changed",
+                                                                  BUS_PATH, nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  on_actions_changed, self, nullptr);
+      const auto menus_tag = g_dbus_connection_signal_subscribe(bus, BUS_NAME, "org.gtk.Menus", "Changed",
+                                                                menu_path.c_str(), nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                on_menus_changed, self, nullptr);
+
+      // subscribe to the root menu and to the submenu that holds the devices
+      auto reply = g_dbus_connection_call_sync(bus, BUS_NAME, menu_path.c_str(), "org.gtk.Menus", "Start",
+                                               g_variant_new_parsed("([uint32 0, 1],)"),
+                                               nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+      g_assert_no_error(error);
+      g_variant_unref(reply);
+
+      g_mutex_lock(&self->ready_mutex_);
+      self->ready_ = true;
+      g_mutex_unlock(&self->ready_mutex_);
+
+      g_main_loop_run(self->loop_);
+
+      g_dbus_connection_signal_unsubscribe(bus, menus_tag);
+      g_dbus_connection_signal_unsubscribe(bus, actions_tag);
+      g_dbus_connection_close_sync(bus, nullptr, nullptr);
+      g_object_unref(bus);
+      while (g_main_context_pending(self->context_))
+        g_main_context_iteration(self->context_, false);
+      g_main_context_pop_thread_default(self->context_);
+      return nullptr;
+    }
+
+    void on_label(Samples* samples, const char* label)
+    {
+      const auto now = g_get_monotonic_time();
+      guint token;
+      if (label_to_token(label, token))
+        {
+          g_mutex_lock(mutex_);
+          samples->on_seen(token, now);
+          g_mutex_unlock(mutex_);
+        }
+    }
+
+    /* (asa{sb}a{sv}a{s(bgav)}) */
+    static void on_actions_changed(GDBusConnection*, const gchar*, const gchar*, const gchar*,
+                                   const gchar*, GVariant* parameters, gpointer gself)
+    {
+      auto self = static_cast<Client*>(gself);
+      auto states = g_variant_get_child_value(parameters, 2);
+      auto state = g_variant_lookup_value(states, "_header", G_VARIANT_TYPE_VARDICT);
+      if (state != nullptr)
+        {
+          const char* label {};
+          if (g_variant_lookup(state, "label", "&s", &label))
+            self->on_label(self->header_, label);
+          g_variant_unref(state);
+        }
+      g_variant_unref(states);
+    }
+
+    /* (a(uuuuaa{sv})) */
+    static void on_menus_changed(GDBusConnection*, const gchar*, const gchar*, const gchar*,
+                                 const gchar*, GVariant* parameters, gpointer gself)
+    {
+      auto self = static_cast<Client*>(gself);
+      GVariantIter* changes;
+      guint group, menu, position, removed;
+      GVariantIter* items;
+
+      g_variant_get(parameters, "(a(uuuuaa{sv}))", &changes);
+      while (g_variant_iter_loop(changes, "(uuuuaa{sv})", &group, &menu, &position, &removed, &items))
+        {
+          GVariant* item;
+          while ((item = g_variant_iter_next_value(items)))
+            {
+              const char* label {};
+              if (g_variant_lookup(item, "label", "&s", &label))
+                self->on_label(self->menu_, label);
+              g_variant_unref(item);
+            }
+        }
+      g_variant_iter_free(changes);
+    }
+
+    std::string address_;
+    GMutex* mutex_;
+    Samples* header_;
+    Samples* menu_;
+    GMainContext* context_ {};
+    GMainLoop* loop_ {};
+    GThread* thread_ {};
+    GMutex ready_mutex_;
+    bool ready_ {};
+  };
+
+  /***
+  ****
+  ***/
+
+  gboolean quit_loop(gpointer loop)
+  {
+    g_main_loop_quit(static_cast<GMainLoop*>(loop));
+    return G_SOURCE_REMOVE;
+  }
+
+  void run_loop(GMainLoop* loop, guint msec)
+  {
+    g_timeout_add(msec, quit_loop, loop);
+    g_main_loop_run(loop);
+  }
+
+  template<typename Func>
+  bool run_loop_until(GMainLoop* loop, Func&& test, guint timeout_msec)
+  {
+    const auto end_time = g_get_monotonic_time() + timeout_msec*1000;
+    while (!test())
+      {
+        if (g_get_monotonic_time() >= end_time)
+          return false;
+        run_loop(loop, 10);
+      }
+    return true;
+  }
+
+  void run_benchmark(double rate, guint n_devices, guint duration_sec)
+  {
+    auto test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+    auto system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+    g_dbus_connection_set_exit_on_close(system_bus, false);
+    g_object_add_weak_pointer(G_OBJECT(system_bus), reinterpret_cast<gpointer*>(&system_bus));
+    auto loop = g_main_loop_new(nullptr, false);
+
+    // one battery to drive the header, plus peripherals to fill out the menu
+    std::unique_ptr<FakeUPower> upower(new FakeUPower(address));
+    const auto battery_path = upower->add_device(FakeUPower::battery(50.0));
+    for (guint i=1; i<n_devices; ++i)
+      upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_MOUSE, 80.0));
+
+    auto provider = indicator_power_device_provider_upower_new();
+    auto notifier = indicator_power_notifier_new();
+    auto service = indicator_power_service_new(provider, notifier);
+
+    GDBusConnection* service_bus {};
+    const auto have_devices = run_loop_until(loop, [&](){
+      if (service_bus == nullptr)
+        g_object_get(service, "bus", &service_bus, nullptr);
+      auto devices = indicator_power_device_provider_get_devices(provider);
+      const auto n = g_list_length(devices);
+      g_list_free_full(devices, g_object_unref);
+      return (service_bus != nullptr) && (n == n_devices);
+    }, 10000);
+    g_clear_object(&service_bus);
+    if (!have_devices)
+      g_error("timed out waiting for the service to see %u devices", n_devices);
+
+    GMutex mutex;
+    g_mutex_init(&mutex);
+    Samples header;
+    Samples menu;
+    std::unique_ptr<Client> client(new Client(address, &mutex, &header, &menu));
+    if (!run_loop_until(loop, [&client](){return client->is_ready();}, 5000))
+      g_error("timed out waiting for the client to subscribe");
+    run_loop(loop, 200); // let the initial menu and action state settle
+
+    // run the benchmark
+    const auto cpu_begin = thread_cpu_usec();
+    upower->start(rate, [&](guint64 n){
+      const auto token = guint(n % N_TOKENS);
+      auto device = FakeUPower::battery(50.0);
+      device.time_to_empty = token_to_seconds(token);
+      g_mutex_lock(&mutex);
+      const auto when = upower->set_device(battery_path, device);
+      header.on_emitted(token, when);
+      menu.on_emitted(token, when);
+      g_mutex_unlock(&mutex);
+    });
+    run_loop(loop, duration_sec*1000);
+    upower->stop();
+    run_loop(loop, 1000); // drain
+    const auto cpu_end = thread_cpu_usec();
+    const auto n_events = upower->get_event_count();
+
+    client.reset();
+    g_mutex_lock(&mutex);
+    printf("{\"benchmark\":\"update-latency\",\"rate\":%.0f,\"devices\":%u,\"events\":%" G_GUINT64_FORMAT
+           ",\"cpu_us_per_event\":%.1f,\"header\":%s,\"menu\":%s}\n",
+           rate,
+           n_devices,
+           n_events,
+           n_events ? double(cpu_end - cpu_begin) / n_events : 0.0,
+           header.to_json().c_str(),
+           menu.to_json().c_str());
+    fflush(stdout);
+    g_mutex_unlock(&mutex);
+    g_mutex_clear(&mutex);
+
+    // cleanup
+    g_object_unref(service);
+    g_object_unref(notifier);
+    g_object_unref(provider);
+    upower.reset();
+    g_object_unref(system_bus);
+    run_loop_until(loop, [&system_bus](){return system_bus == nullptr;}, 5000);
+    g_main_loop_unref(loop);
+    g_test_dbus_down(test_dbus);
+    g_object_unref(test_dbus);
+  }
+
+  std::vector<double> parse_list(const char* str)
+  {
+    std::vector<double> ret;
+    auto tokens = g_strsplit(str, ",", -1);
+    for (auto it=tokens; it && *it; ++it)
+      ret.push_back(g_ascii_strtod(*it, nullptr));
+    g_strfreev(tokens);
+    return ret;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  gchar* rates_str {};
+  gchar* devices_str {};
+  gint duration {5};
+
+  GOptionEntry entries[] = {
+    { "rates", 'r', 0, G_OPTION_ARG_STRING, &rates_str, "Comma-separated events per second (default: 1,100,1000)", "LIST" },
+    { "devices", 'n', 0, G_OPTION_ARG_STRING, &devices_str, "Comma-separated device counts (default: 1,10,100,500)", "LIST" },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Seconds to run each combination (default: 5)", "SEC" },
+    { nullptr }
+  };
+
+  GError* error {};
+  auto context = g_option_context_new("- measure indicator-power's update latency");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+      g_printerr("%s\n", error->message);
+      g_clear_error(&error);
+      g_option_context_free(context);
+      return 1;
+    }
+  g_option_context_free(context);
+
+  const auto rates = parse_list(rates_str ? rates_str : "1,100,1000");
+  const auto devices = parse_list(devices_str ? devices_str : "1,10,100,500");
+
+  // use local, temporary settings, with the time shown in the header
+  g_setenv("GSETTINGS_SCHEMA_DIR", SCHEMA_DIR, true);
+  g_setenv("GSETTINGS_BACKEND", "memory", true);
+  auto settings = g_settings_new("com.canonical.indicator.power");
+  g_settings_set_boolean(settings, "show-time", true);
+
+  for (const auto& n : devices)
+    for (const auto& rate : rates)
+      run_benchmark(rate, guint(n), guint(std::max(1, duration)));
+
+  g_object_unref(settings);
+  g_free(devices_str);
+  g_free(rates_str);
+  return 0;
+}
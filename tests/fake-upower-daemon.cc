@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Standalone wrapper around FakeUPower for poking at the service by hand:
+ *
+ *   $ fake-upower-daemon --batteries=2 --peripherals=50 --rate=100 --pattern=flap &
+ *   $ DBUS_SYSTEM_BUS_ADDRESS=<printed address> indicator-power-service
+ */
+
+#include "fake-upower.h"
+
+#include <glib.h>
+#include <glib-unix.h> // g_unix_signal_add()
+#include <gio/gio.h>
+
+#include <signal.h> // SIGINT, SIGTERM
+
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+  gboolean on_quit_signal(gpointer loop)
+  {
+    g_main_loop_quit(static_cast<GMainLoop*>(loop));
+    return G_SOURCE_REMOVE;
+  }
+
+  gboolean on_duration_elapsed(gpointer loop)
+  {
+    g_main_loop_quit(static_cast<GMainLoop*>(loop));
+    return G_SOURCE_REMOVE;
+  }
+
+  bool parse_pattern(const char* str, FakeUPower::Pattern& setme)
+  {
+    bool ok = true;
+
+    if (!g_strcmp0(str, "discharge"))
+      setme = FakeUPower::Pattern::SteadyDischarge;
+    else if (!g_strcmp0(str, "flap"))
+      setme = FakeUPower::Pattern::FlappingAC;
+    else if (!g_strcmp0(str, "resume"))
+      setme = FakeUPower::Pattern::ResumeStorm;
+    else if (!g_strcmp0(str, "hotplug"))
+      setme = FakeUPower::Pattern::Hotplug;
+    else
+      ok = false;
+
+    return ok;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  gint n_batteries {1};
+  gint n_peripherals {0};
+  gboolean line_power {false};
+  gdouble rate {0};
+  gchar* pattern_str {};
+  gint duration {0};
+  gchar* address {};
+
+  GOptionEntry entries[] = {
+    { "batteries", 'b', 0, G_OPTION_ARG_INT, &n_batteries, "Number of batteries (default: 1)", "N" },
+    { "peripherals", 'p', 0, G_OPTION_ARG_INT, &n_peripherals, "Number of peripherals, e.g. mice (default: 0)", "N" },
+    { "line-power", 'l', 0, G_OPTION_ARG_NONE, &line_power, "Add an AC adapter", nullptr },
+    { "rate", 'r', 0, G_OPTION_ARG_DOUBLE, &rate, "Scripted events per second (default: 0, idle)", "HZ" },
+    { "pattern", 'P', 0, G_OPTION_ARG_STRING, &pattern_str, "One of discharge, flap, resume, hotplug (default: discharge)", "NAME" },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Exit after this many seconds (default: run until interrupted)", "SEC" },
+    { "address", 'a', 0, G_OPTION_ARG_STRING, &address, "Bus address to use (default: start a private bus)", "ADDRESS" },
+    { nullptr }
+  };
+
+  GError* error {};
+  auto context = g_option_context_new("- stand-in UPower daemon for testing indicator-power");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+      g_printerr("%s\n", error->message);
+      g_clear_error(&error);
+      g_option_context_free(context);
+      return 1;
+    }
+  g_option_context_free(context);
+
+  auto pattern = FakeUPower::Pattern::SteadyDischarge;
+  if ((pattern_str != nullptr) && !parse_pattern(pattern_str, pattern))
+    {
+      g_printerr("Unknown pattern '%s'\n", pattern_str);
+      return 1;
+    }
+
+  // if we weren't given a bus, make our own
+  GTestDBus* test_dbus {};
+  if (address == nullptr)
+    {
+      test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+      g_test_dbus_up(test_dbus);
+      address = g_strdup(g_test_dbus_get_bus_address(test_dbus));
+    }
+  printf("%s\n", address);
+  fflush(stdout);
+
+  auto loop = g_main_loop_new(nullptr, false);
+  g_unix_signal_add(SIGINT, on_quit_signal, loop);
+  g_unix_signal_add(SIGTERM, on_quit_signal, loop);
+  if (duration > 0)
+    g_timeout_add_seconds(guint(duration), on_duration_elapsed, loop);
+
+  std::unique_ptr<FakeUPower> upower(new FakeUPower(address));
+  for (int i=0; i<n_batteries; ++i)
+    upower->add_device(FakeUPower::battery(100.0 - i));
+  for (int i=0; i<n_peripherals; ++i)
+    upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_MOUSE, 80.0));
+  if (line_power)
+    upower->add_device(FakeUPower::line_power(false));
+  if (rate > 0)
+    upower->start(pattern, rate);
+
+  g_main_loop_run(loop);
+
+  upower->stop();
+  g_message("emitted %" G_GUINT64_FORMAT " scripted events", upower->get_event_count());
+
+  // cleanup
+  upower.reset();
+  g_main_loop_unref(loop);
+  if (test_dbus != nullptr)
+    {
+      g_test_dbus_down(test_dbus);
+      g_object_unref(test_dbus);
+    }
+  g_free(address);
+  g_free(pattern_str);
+  return 0;
+}
@@ -0,0 +1,636 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fake-upower.h"
+
+#include <algorithm> // std::max()
+
+namespace
+{
+  constexpr char const * MGR_PATH {"/org/freedesktop/UPower"};
+  constexpr char const * MGR_IFACE {"org.freedesktop.UPower"};
+  constexpr char const * DEVICE_IFACE {"org.freedesktop.UPower.Device"};
+  constexpr char const * PROPERTIES_IFACE {"org.freedesktop.DBus.Properties"};
+
+  constexpr char const * INTROSPECTION_XML {
+    "<node>"
+    "  <interface name='org.freedesktop.UPower'>"
+    "    <method name='EnumerateDevices'>"
+    "      <arg name='devices' type='ao' direction='out'/>"
+    "    </method>"
+    "    <signal name='DeviceAdded'>"
+    "      <arg name='device' type='o'/>"
+    "    </signal>"
+    "    <signal name='DeviceRemoved'>"
+    "      <arg name='device' type='o'/>"
+    "    </signal>"
+    "    <property name='DaemonVersion' type='s' access='read'/>"
+    "    <property name='OnBattery' type='b' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.UPower.Device'>"
+    "    <property name='Type' type='u' access='read'/>"
+    "    <property name='State' type='u' access='read'/>"
+    "    <property name='Percentage' type='d' access='read'/>"
+    "    <property name='TimeToEmpty' type='x' access='read'/>"
+    "    <property name='TimeToFull' type='x' access='read'/>"
+    "    <property name='PowerSupply' type='b' access='read'/>"
+    "    <property name='Online' type='b' access='read'/>"
+    "    <property name='IsPresent' type='b' access='read'/>"
+    "  </interface>"
+    "</node>"
+  };
+
+  GVariant* create_device_property(const FakeUPower::Device& device, const char* name)
+  {
+    GVariant* ret {};
+
+    if (!g_strcmp0(name, "Type"))
+      ret = g_variant_new_uint32(device.kind);
+    else if (!g_strcmp0(name, "State"))
+      ret = g_variant_new_uint32(device.state);
+    else if (!g_strcmp0(name, "Percentage"))
+      ret = g_variant_new_double(device.percentage);
+    else if (!g_strcmp0(name, "TimeToEmpty"))
+      ret = g_variant_new_int64(device.time_to_empty);
+    else if (!g_strcmp0(name, "TimeToFull"))
+      ret = g_variant_new_int64(device.time_to_full);
+    else if (!g_strcmp0(name, "PowerSupply"))
+      ret = g_variant_new_boolean(device.power_supply);
+    else if (!g_strcmp0(name, "Online"))
+      ret = g_variant_new_boolean(device.online);
+    else if (!g_strcmp0(name, "IsPresent"))
+      ret = g_variant_new_boolean(true);
+
+    return ret;
+  }
+}
+
+/***
+****  Lifecycle
+***/
+
+FakeUPower::FakeUPower(const char* bus_address):
+  bus_address_(bus_address)
+{
+  g_mutex_init(&mutex_);
+  g_cond_init(&cond_);
+
+  node_info_ = g_dbus_node_info_new_for_xml(INTROSPECTION_XML, nullptr);
+  g_assert(node_info_ != nullptr);
+
+  context_ = g_main_context_new();
+  loop_ = g_main_loop_new(context_, false);
+  thread_ = g_thread_new("fake-upower", thread_func, this);
+
+  // don't return until we own the busname
+  const auto end_time = g_get_monotonic_time() + 5*G_TIME_SPAN_SECOND;
+  g_mutex_lock(&mutex_);
+  while (!name_acquired_)
+    if (!g_cond_wait_until(&cond_, &mutex_, end_time))
+      g_error("%s: timed out waiting to own %s", G_STRLOC, BUS_NAME);
+  g_mutex_unlock(&mutex_);
+}
+
+FakeUPower::~FakeUPower()
+{
+  stop();
+
+  g_main_loop_quit(loop_);
+  g_thread_join(thread_);
+
+  g_main_loop_unref(loop_);
+  g_main_context_unref(context_);
+  g_dbus_node_info_unref(node_info_);
+  g_cond_clear(&cond_);
+  g_mutex_clear(&mutex_);
+}
+
+gpointer
+FakeUPower::thread_func(gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+
+  g_main_context_push_thread_default(self->context_);
+
+  GError* error {};
+  self->bus_ = g_dbus_connection_new_for_address_sync(self->bus_address_.c_str(),
+                                                      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|
+                                                                           G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                      nullptr,
+                                                      nullptr,
+                                                      &error);
+  g_assert_no_error(error);
+  g_dbus_connection_set_exit_on_close(self->bus_, false);
+
+  static const GDBusInterfaceVTable manager_vtable = {
+    on_manager_method_call,
+    on_manager_get_property,
+    nullptr
+  };
+  self->manager_registration_id_ = g_dbus_connection_register_object(self->bus_,
+                                                                     MGR_PATH,
+                                                                     self->node_info_->interfaces[0],
+                                                                     &manager_vtable,
+                                                                     self,
+                                                                     nullptr,
+                                                                     &error);
+  g_assert_no_error(error);
+
+  self->own_id_ = g_bus_own_name_on_connection(self->bus_,
+                                               BUS_NAME,
+                                               G_BUS_NAME_OWNER_FLAGS_NONE,
+                                               on_name_acquired,
+                                               on_name_lost,
+                                               self,
+                                               nullptr);
+
+  g_main_loop_run(self->loop_);
+
+  // cleanup
+  g_bus_unown_name(self->own_id_);
+  for (const auto& it : self->registrations_)
+    g_dbus_connection_unregister_object(self->bus_, it.second);
+  self->registrations_.clear();
+  g_dbus_connection_unregister_object(self->bus_, self->manager_registration_id_);
+  g_dbus_connection_flush_sync(self->bus_, nullptr, nullptr);
+  g_dbus_connection_close_sync(self->bus_, nullptr, nullptr);
+  g_clear_object(&self->bus_);
+
+  // let any pending sources finish before the context goes away
+  while (g_main_context_pending(self->context_))
+    g_main_context_iteration(self->context_, false);
+
+  g_main_context_pop_thread_default(self->context_);
+  return nullptr;
+}
+
+void
+FakeUPower::on_name_acquired(GDBusConnection*, const gchar*, gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+
+  g_mutex_lock(&self->mutex_);
+  self->name_acquired_ = true;
+  g_cond_signal(&self->cond_);
+  g_mutex_unlock(&self->mutex_);
+}
+
+void
+FakeUPower::on_name_lost(GDBusConnection*, const gchar* name, gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+
+  if (!self->name_acquired_)
+    g_error("%s: unable to own %s", G_STRLOC, name);
+}
+
+/* run func in the FakeUPower thread and wait for it to finish */
+void
+FakeUPower::invoke_sync(std::function<void()> func)
+{
+  if (g_main_context_is_owner(context_))
+    {
+      func();
+      return;
+    }
+
+  struct Data
+  {
+    std::function<void()> func;
+    GMutex mutex;
+    GCond cond;
+    bool done;
+  };
+
+  Data data;
+  data.func = std::move(func);
+  data.done = false;
+  g_mutex_init(&data.mutex);
+  g_cond_init(&data.cond);
+
+  g_main_context_invoke(context_, [](gpointer gdata) -> gboolean {
+    auto d = static_cast<Data*>(gdata);
+    d->func();
+    g_mutex_lock(&d->mutex);
+    d->done = true;
+    g_cond_signal(&d->cond);
+    g_mutex_unlock(&d->mutex);
+    return G_SOURCE_REMOVE;
+  }, &data);
+
+  g_mutex_lock(&data.mutex);
+  while (!data.done)
+    g_cond_wait(&data.cond, &data.mutex);
+  g_mutex_unlock(&data.mutex);
+
+  g_cond_clear(&data.cond);
+  g_mutex_clear(&data.mutex);
+}
+
+/***
+****  D-Bus
+***/
+
+void
+FakeUPower::emit(const char* path, const char* interface, const char* signal, GVariant* parameters)
+{
+  GError* error {};
+  g_dbus_connection_emit_signal(bus_, nullptr, path, interface, signal, parameters, &error);
+  if (error != nullptr)
+    {
+      g_message("%s unable to emit %s.%s: %s", G_STRLOC, interface, signal, error->message);
+      g_clear_error(&error);
+    }
+}
+
+void
+FakeUPower::on_manager_method_call(GDBusConnection*,
+                                   const gchar*,
+                                   const gchar*,
+                                   const gchar*,
+                                   const gchar* method_name,
+                                   GVariant*,
+                                   GDBusMethodInvocation* invocation,
+                                   gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+
+  if (!g_strcmp0(method_name, "EnumerateDevices"))
+    {
+      GVariantBuilder b;
+      g_variant_builder_init(&b, G_VARIANT_TYPE("ao"));
+      for (const auto& it : self->devices_)
+        g_variant_builder_add(&b, "o", it.first.c_str());
+      g_dbus_method_invocation_return_value(invocation, g_variant_new("(ao)", &b));
+    }
+  else
+    {
+      g_dbus_method_invocation_return_error(invocation,
+                                            G_DBUS_ERROR,
+                                            G_DBUS_ERROR_UNKNOWN_METHOD,
+                                            "unknown method '%s'", method_name);
+    }
+}
+
+GVariant*
+FakeUPower::on_manager_get_property(GDBusConnection*,
+                                    const gchar*,
+                                    const gchar*,
+                                    const gchar*,
+                                    const gchar* property_name,
+                                    GError**,
+                                    gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+  GVariant* ret {};
+
+  if (!g_strcmp0(property_name, "DaemonVersion"))
+    {
+      ret = g_variant_new_string("0.99.4");
+    }
+  else if (!g_strcmp0(property_name, "OnBattery"))
+    {
+      bool on_battery = true;
+      for (const auto& it : self->devices_)
+        if ((it.second.kind == UP_DEVICE_KIND_LINE_POWER) && it.second.online)
+          on_battery = false;
+      ret = g_variant_new_boolean(on_battery);
+    }
+
+  return ret;
+}
+
+GVariant*
+FakeUPower::on_device_get_property(GDBusConnection*,
+                                   const gchar*,
+                                   const gchar* object_path,
+                                   const gchar*,
+                                   const gchar* property_name,
+                                   GError** error,
+                                   gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+  const auto it = self->devices_.find(object_path);
+
+  if (it == self->devices_.end())
+    {
+      g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT, "no such device '%s'", object_path);
+      return nullptr;
+    }
+
+  return create_device_property(it->second, property_name);
+}
+
+/***
+****  Devices
+***/
+
+std::string
+FakeUPower::add_device(const Device& device)
+{
+  std::string path;
+
+  invoke_sync([this, &device, &path](){
+    static const GDBusInterfaceVTable device_vtable = {
+      nullptr,
+      on_device_get_property,
+      nullptr
+    };
+
+    auto tmp = g_strdup_printf("%s/devices/fake_%u", MGR_PATH, ++next_device_id_);
+    path = tmp;
+    g_free(tmp);
+
+    GError* error {};
+    const auto id = g_dbus_connection_register_object(bus_,
+                                                      path.c_str(),
+                                                      node_info_->interfaces[1],
+                                                      &device_vtable,
+                                                      this,
+                                                      nullptr,
+                                                      &error);
+    g_assert_no_error(error);
+    registrations_[path] = id;
+    devices_[path] = device;
+
+    emit(MGR_PATH, MGR_IFACE, "DeviceAdded", g_variant_new("(o)", path.c_str()));
+  });
+
+  return path;
+}
+
+void
+FakeUPower::remove_device(const std::string& path)
+{
+  invoke_sync([this, &path](){
+    const auto it = registrations_.find(path);
+    g_return_if_fail(it != registrations_.end());
+
+    g_dbus_connection_unregister_object(bus_, it->second);
+    registrations_.erase(it);
+    devices_.erase(path);
+
+    emit(MGR_PATH, MGR_IFACE, "DeviceRemoved", g_variant_new("(o)", path.c_str()));
+  });
+}
+
+gint64
+FakeUPower::set_device(const std::string& path, const Device& device, bool force_all)
+{
+  gint64 emitted_at {};
+
+  invoke_sync([this, &path, &device, force_all, &emitted_at](){
+    const auto it = devices_.find(path);
+    g_return_if_fail(it != devices_.end());
+    const auto old = it->second;
+    it->second = device;
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    auto add = [&b, &device](const char* name){
+      g_variant_builder_add(&b, "{sv}", name, create_device_property(device, name));
+    };
+    if (force_all || (old.kind != device.kind))
+      add("Type");
+    if (force_all || (old.state != device.state))
+      add("State");
+    if (force_all || (old.percentage != device.percentage))
+      add("Percentage");
+    if (force_all || (old.time_to_empty != device.time_to_empty))
+      add("TimeToEmpty");
+    if (force_all || (old.time_to_full != device.time_to_full))
+      add("TimeToFull");
+    if (force_all || (old.power_supply != device.power_supply))
+      add("PowerSupply");
+    if (force_all || (old.online != device.online))
+      add("Online");
+
+    emitted_at = g_get_monotonic_time();
+    emit(path.c_str(), PROPERTIES_IFACE, "PropertiesChanged",
+         g_variant_new("(s@a{sv}@as)", DEVICE_IFACE,
+                                       g_variant_builder_end(&b),
+                                       g_variant_new_strv(nullptr, 0)));
+  });
+
+  return emitted_at;
+}
+
+FakeUPower::Device
+FakeUPower::get_device(const std::string& path)
+{
+  Device ret;
+
+  invoke_sync([this, &path, &ret](){
+    const auto it = devices_.find(path);
+    if (it != devices_.end())
+      ret = it->second;
+  });
+
+  return ret;
+}
+
+std::vector<std::string>
+FakeUPower::get_paths()
+{
+  std::vector<std::string> ret;
+
+  invoke_sync([this, &ret](){
+    for (const auto& it : devices_)
+      ret.push_back(it.first);
+  });
+
+  return ret;
+}
+
+FakeUPower::Device
+FakeUPower::battery(double percentage, UpDeviceState state)
+{
+  Device device;
+  device.kind = UP_DEVICE_KIND_BATTERY;
+  device.state = state;
+  device.percentage = percentage;
+  device.power_supply = true;
+  if (state == UP_DEVICE_STATE_DISCHARGING)
+    device.time_to_empty = gint64(percentage * 36); // 1 hour from full
+  else if (state == UP_DEVICE_STATE_CHARGING)
+    device.time_to_full = gint64((100.0 - percentage) * 36);
+  return device;
+}
+
+FakeUPower::Device
+FakeUPower::line_power(bool online)
+{
+  Device device;
+  device.kind = UP_DEVICE_KIND_LINE_POWER;
+  device.state = UP_DEVICE_STATE_UNKNOWN;
+  device.percentage = 0.0;
+  device.power_supply = true;
+  device.online = online;
+  return device;
+}
+
+FakeUPower::Device
+FakeUPower::peripheral(UpDeviceKind kind, double percentage)
+{
+  Device device;
+  device.kind = kind;
+  device.state = UP_DEVICE_STATE_DISCHARGING;
+  device.percentage = percentage;
+  return device;
+}
+
+/***
+****  Scripted events
+***/
+
+FakeUPower::Step
+FakeUPower::create_step(Pattern pattern)
+{
+  Step step;
+
+  switch (pattern)
+    {
+      case Pattern::SteadyDischarge:
+        step = [this](guint64 n){
+          std::vector<std::string> batteries;
+          for (const auto& it : devices_)
+            if (it.second.kind == UP_DEVICE_KIND_BATTERY)
+              batteries.push_back(it.first);
+          if (batteries.empty())
+            return;
+          const auto& path = batteries[n % batteries.size()];
+          auto device = devices_[path];
+          device.percentage -= 0.1;
+          if (device.percentage <= 0.0)
+            device.percentage = 100.0;
+          device = battery(device.percentage, UP_DEVICE_STATE_DISCHARGING);
+          set_device(path, device);
+        };
+        break;
+
+      case Pattern::FlappingAC:
+        step = [this](guint64 n){
+          const bool online = (n % 2) == 0;
+          bool have_line_power = false;
+          for (const auto& it : std::map<std::string,Device>(devices_))
+            {
+              if (it.second.kind == UP_DEVICE_KIND_LINE_POWER)
+                {
+                  set_device(it.first, line_power(online));
+                  have_line_power = true;
+                }
+              else if (it.second.kind == UP_DEVICE_KIND_BATTERY)
+                {
+                  set_device(it.first, battery(it.second.percentage, online ? UP_DEVICE_STATE_CHARGING
+                                                                            : UP_DEVICE_STATE_DISCHARGING));
+                }
+            }
+          if (!have_line_power)
+            add_device(line_power(online));
+        };
+        break;
+
+      case Pattern::ResumeStorm:
+        step = [this](guint64){
+          for (const auto& it : std::map<std::string,Device>(devices_))
+            set_device(it.first, it.second, true);
+        };
+        break;
+
+      case Pattern::Hotplug:
+        step = [this](guint64){
+          for (const auto& it : devices_)
+            {
+              if ((it.second.kind != UP_DEVICE_KIND_BATTERY) &&
+                  (it.second.kind != UP_DEVICE_KIND_LINE_POWER))
+                {
+                  const auto device = it.second;
+                  remove_device(std::string(it.first));
+                  add_device(device);
+                  return;
+                }
+            }
+          add_device(peripheral(UP_DEVICE_KIND_MOUSE, 80.0));
+        };
+        break;
+    }
+
+  return step;
+}
+
+gboolean
+FakeUPower::on_tick(gpointer gself)
+{
+  auto self = static_cast<FakeUPower*>(gself);
+
+  // catch up on however many events should have been emitted by now
+  const auto elapsed = g_get_monotonic_time() - self->start_time_;
+  const auto expected = guint64(self->events_per_second_ * elapsed / G_TIME_SPAN_SECOND);
+  while (self->scheduled_events_ < expected)
+    {
+      self->step_(self->scheduled_events_++);
+      ++self->event_count_;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+void
+FakeUPower::start(Pattern pattern, double events_per_second)
+{
+  invoke_sync([this, pattern, events_per_second](){
+    start(events_per_second, create_step(pattern));
+  });
+}
+
+void
+FakeUPower::start(double events_per_second, Step step)
+{
+  g_return_if_fail(events_per_second > 0);
+
+  invoke_sync([this, events_per_second, &step](){
+    stop();
+
+    step_ = std::move(step);
+    events_per_second_ = events_per_second;
+    start_time_ = g_get_monotonic_time();
+    scheduled_events_ = 0;
+
+    const auto interval_msec = std::max(1u, guint(1000.0 / events_per_second));
+    tick_source_ = g_timeout_source_new(interval_msec);
+    g_source_set_callback(tick_source_, on_tick, this, nullptr);
+    g_source_attach(tick_source_, context_);
+  });
+}
+
+void
+FakeUPower::stop()
+{
+  invoke_sync([this](){
+    if (tick_source_ != nullptr)
+      {
+        g_source_destroy(tick_source_);
+        g_source_unref(tick_source_);
+        tick_source_ = nullptr;
+      }
+  });
+}
+
+guint64
+FakeUPower::get_event_count() const
+{
+  return event_count_;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "device.h" // UpDeviceKind, UpDeviceState
+
+#include <gio/gio.h>
+
+#include <atomic>
+#include <functional> // std::function
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * A stand-in for the UPower daemon.
+ *
+ * It owns org.freedesktop.UPower on the bus at the given address and
+ * serves EnumerateDevices, DeviceAdded, DeviceRemoved and per-device
+ * GetAll / PropertiesChanged just like upowerd >= 0.99 does.
+ *
+ * It runs in its own thread with its own GMainContext, so it can keep
+ * emitting events at a steady rate while the code under test is busy.
+ * All the public methods are safe to call from any thread.
+ */
+class FakeUPower
+{
+public:
+
+  struct Device
+  {
+    UpDeviceKind kind = UP_DEVICE_KIND_BATTERY;
+    UpDeviceState state = UP_DEVICE_STATE_DISCHARGING;
+    double percentage = 50.0;
+    gint64 time_to_empty = 0;
+    gint64 time_to_full = 0;
+    bool power_supply = false;
+    bool online = false;
+  };
+
+  /* scripted load patterns for start() */
+  enum class Pattern
+  {
+    SteadyDischarge, // the batteries lose a little charge on every event
+    FlappingAC,      // the AC adapter is plugged or unplugged on every event
+    ResumeStorm,     // every device reports all its properties on every event
+    Hotplug          // a peripheral is removed and re-added on every event
+  };
+
+  /* called in the FakeUPower thread once per scripted event */
+  using Step = std::function<void(guint64 event_number)>;
+
+  explicit FakeUPower(const char* bus_address);
+  ~FakeUPower();
+
+  FakeUPower(const FakeUPower&) =delete;
+  FakeUPower& operator=(const FakeUPower&) =delete;
+
+  /* adds a device and emits DeviceAdded. Returns its object path. */
+  std::string add_device(const Device& device);
+
+  /* removes a device and emits DeviceRemoved */
+  void remove_device(const std::string& path);
+
+  /* updates a device and emits PropertiesChanged for the fields that
+     changed, or for all of them if force_all is true.
+     Returns the g_get_monotonic_time() of the emission. */
+  gint64 set_device(const std::string& path, const Device& device, bool force_all=false);
+
+  Device get_device(const std::string& path);
+  std::vector<std::string> get_paths();
+
+  /* emit events at the given rate until stop() is called */
+  void start(Pattern pattern, double events_per_second);
+  void start(double events_per_second, Step step);
+  void stop();
+
+  guint64 get_event_count() const;
+
+  static Device battery(double percentage, UpDeviceState state=UP_DEVICE_STATE_DISCHARGING);
+  static Device line_power(bool online);
+  static Device peripheral(UpDeviceKind kind, double percentage);
+
+  static constexpr char const * BUS_NAME {"org.freedesktop.UPower"};
+
+private:
+
+  static gpointer thread_func(gpointer gself);
+  static gboolean on_tick(gpointer gself);
+  static void on_name_acquired(GDBusConnection*, const gchar*, gpointer gself);
+  static void on_name_lost(GDBusConnection*, const gchar*, gpointer gself);
+  static void on_manager_method_call(GDBusConnection*, const gchar*, const gchar*,
+                                     const gchar*, const gchar*, GVariant*,
+                                     GDBusMethodInvocation*, gpointer);
+  static GVariant* on_manager_get_property(GDBusConnection*, const gchar*, const gchar*,
+                                           const gchar*, const gchar*, GError**, gpointer);
+  static GVariant* on_device_get_property(GDBusConnection*, const gchar*, const gchar*,
+                                          const gchar*, const gchar*, GError**, gpointer);
+
+  void invoke_sync(std::function<void()> func);
+  void emit(const char* path, const char* interface, const char* signal, GVariant* parameters);
+  Step create_step(Pattern pattern);
+
+  std::string bus_address_;
+  GMainContext* context_ {};
+  GMainLoop* loop_ {};
+  GThread* thread_ {};
+  GDBusConnection* bus_ {};
+  GDBusNodeInfo* node_info_ {};
+  guint own_id_ {};
+  guint manager_registration_id_ {};
+
+  GMutex mutex_;
+  GCond cond_;
+  bool name_acquired_ {};
+
+  std::map<std::string,Device> devices_;
+  std::map<std::string,guint> registrations_;
+  guint next_device_id_ {};
+
+  Step step_;
+  GSource* tick_source_ {};
+  double events_per_second_ {};
+  gint64 start_time_ {};
+  guint64 scheduled_events_ {};
+  std::atomic<guint64> event_count_ {};
+};
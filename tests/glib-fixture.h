@@ -19,6 +19,10 @@
 
 #pragma once
 
+#include "alloc-counter.h"
+#include "clock.h"
+#include "clock-mock.h"
+
 #include <chrono>
 #include <functional> // std::function
 #include <map>
@@ -51,17 +55,26 @@ class GlibFixture : public ::testing::Test
       g_assert(g_setenv("GSETTINGS_BACKEND", "memory", true));
       g_debug("SCHEMA_DIR is %s", SCHEMA_DIR);
 
+      // keep anything the service publishes out of the real runtime dir
+      g_assert(g_setenv("XDG_RUNTIME_DIR", XDG_RUNTIME_DIR, true));
+
       // fail on unexpected messages from this domain
       g_log_set_fatal_mask(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING);
 
       g_unsetenv("DISPLAY");
 
+      // the code under test gets a virtual clock that only moves when we say so
+      clock = indicator_power_clock_mock_new();
+      indicator_power_clock_set_default(clock);
     }
 
     virtual void TearDown() override
     {
       g_test_assert_expected_messages ();
 
+      indicator_power_clock_set_default(nullptr);
+      g_clear_object(&clock);
+
       g_clear_pointer(&loop, g_main_loop_unref);
     }
 
@@ -125,6 +138,46 @@ class GlibFixture : public ::testing::Test
       }
     }
 
+    struct Allocations
+    {
+      guint64 count;
+      guint64 bytes;
+    };
+
+    /* run func and tally the heap allocations this thread made meanwhile */
+    Allocations count_allocations(std::function<void()> func)
+    {
+      AllocCounter counter;
+      func();
+      return Allocations { counter.allocs(), counter.bytes() };
+    }
+
+    /* advance the virtual clock, then dispatch anything it made ready */
+    void advance_clock(std::chrono::milliseconds msec)
+    {
+      indicator_power_clock_mock_advance(INDICATOR_POWER_CLOCK_MOCK(clock), guint(msec.count()));
+      while (g_main_context_pending(nullptr))
+        g_main_context_iteration(nullptr, false);
+    }
+
+    /* like wait_for(), but fast-forwards the virtual clock by `step` on
+       every poll, so that the code's timers don't cost us real time */
+    bool wait_for_fast_forward(std::function<bool()> test_function,
+                               std::chrono::milliseconds step=std::chrono::milliseconds(500),
+                               guint timeout_msec=1000)
+    {
+      auto timer = std::shared_ptr<GTimer>(g_timer_new(), [](GTimer* t){g_timer_destroy(t);});
+      const auto timeout_sec = timeout_msec / 1000.0;
+      for (;;) {
+        if (test_function())
+          return true;
+        if (g_timer_elapsed(timer.get(), nullptr) >= timeout_sec)
+          return false;
+        wait_msec(5);
+        advance_clock(step);
+      }
+    }
+
     bool wait_for_name_owned(
         GDBusConnection* connection,
         const gchar* name,
@@ -224,5 +277,6 @@ class GlibFixture : public ::testing::Test
     }
 
     GMainLoop* loop {};
+    IndicatorPowerClock* clock {};
 };
 
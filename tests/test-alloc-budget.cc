@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+#include "fake-upower.h"
+
+#include "device-provider-upower.h"
+#include "notifier.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <memory>
+#include <string>
+
+/***
+****  Allocation budgets for one steady-state UPower update, measured on
+****  the main thread from the moment the PropertiesChanged signal is
+****  dispatched until the service, notifier, and exporters go idle.
+****
+****  When an optimization lowers the real numbers, lower these to match
+****  so the improvement can't silently regress.
+***/
+
+namespace
+{
+  constexpr guint64 MAX_ALLOCS_PER_UPDATE {1500};
+  constexpr guint64 MAX_BYTES_PER_UPDATE {128*1024};
+}
+
+class AllocBudgetFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* system_bus {};
+  std::unique_ptr<FakeUPower> upower;
+  std::string battery_path;
+  IndicatorPowerDeviceProvider* provider {};
+  IndicatorPowerNotifier* notifier {};
+  IndicatorPowerService* service {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // the service uses the session bus and UPower uses the system bus;
+    // point them both at the same private bus
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+    g_dbus_connection_set_exit_on_close(system_bus, false);
+    g_object_add_weak_pointer(G_OBJECT(system_bus), reinterpret_cast<gpointer*>(&system_bus));
+
+    upower.reset(new FakeUPower(address));
+    battery_path = upower->add_device(FakeUPower::battery(80.0));
+    upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_MOUSE, 70.0));
+    upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_KEYBOARD, 60.0));
+
+    provider = indicator_power_device_provider_upower_new();
+    notifier = indicator_power_notifier_new();
+    service = indicator_power_service_new(provider, notifier);
+
+    ASSERT_TRUE(wait_for_fast_forward([this](){
+      auto devices = indicator_power_device_provider_get_devices(provider);
+      const auto n = g_list_length(devices);
+      g_list_free_full(devices, g_object_unref);
+      return n == 3;
+    }));
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&service);
+    g_clear_object(&notifier);
+    g_clear_object(&provider);
+    upower.reset();
+
+    g_object_unref(system_bus);
+    EXPECT_TRUE(wait_for([this](){return system_bus == nullptr;}));
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  /* emit one battery update, then count the main thread's allocations
+     from when the provider sees it until everything's gone idle again */
+  Allocations measure_update(double percentage)
+  {
+    struct Data {
+      bool changed = false;
+    } data;
+
+    // connect after the service, so that we know it's finished its rebuild
+    const auto tag = g_signal_connect_after(provider, "devices-changed", G_CALLBACK(+[](gpointer, gpointer gdata){
+      static_cast<Data*>(gdata)->changed = true;
+    }), &data);
+
+    // wait for the signal to reach our bus connection's queue before counting,
+    // so that we're not counting the wait itself
+    upower->set_device(battery_path, FakeUPower::battery(percentage));
+    const auto timeout = g_get_monotonic_time() + 5*G_USEC_PER_SEC;
+    while (!g_main_context_pending(nullptr))
+      {
+        if (g_get_monotonic_time() > timeout)
+          g_error("%s: timed out waiting for PropertiesChanged", G_STRLOC);
+        g_usleep(1000);
+      }
+
+    const auto allocations = count_allocations([&data](){
+      while (!data.changed)
+        g_main_context_iteration(nullptr, true);
+      while (g_main_context_pending(nullptr))
+        g_main_context_iteration(nullptr, false);
+    });
+
+    g_signal_handler_disconnect(provider, tag);
+    return allocations;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(AllocBudgetFixture, SteadyStateBatteryUpdate)
+{
+  // warm up: the first updates build caches, types, and quarks that later ones reuse
+  double percentage = 79.0;
+  for (int i=0; i<3; ++i)
+    measure_update(percentage--);
+
+  const auto allocations = measure_update(percentage);
+  RecordProperty("allocs", int(allocations.count));
+  RecordProperty("bytes", int(allocations.bytes));
+  g_message("one battery update: %" G_GUINT64_FORMAT " allocations, %" G_GUINT64_FORMAT " bytes",
+            allocations.count, allocations.bytes);
+
+  EXPECT_LE(allocations.count, MAX_ALLOCS_PER_UPDATE);
+  EXPECT_LE(allocations.bytes, MAX_BYTES_PER_UPDATE);
+}
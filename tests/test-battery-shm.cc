@@ -0,0 +1,249 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "shm-writer.h"
+
+#include <indicator-power/battery-shm.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <climits> // PATH_MAX
+#include <string>
+
+class BatteryShmFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  std::string path;
+  GList* small {};  // three devices at 10%
+  GList* large {};  // five devices at 90%
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    char buf[PATH_MAX];
+    ASSERT_NE(nullptr, indicator_power_shm_get_path(buf, sizeof(buf)));
+    path = buf;
+
+    small = make_devices("/small/", 3, 10.0);
+    large = make_devices("/large/", 5, 90.0);
+  }
+
+  void TearDown() override
+  {
+    g_list_free_full(small, g_object_unref);
+    g_list_free_full(large, g_object_unref);
+
+    super::TearDown();
+  }
+
+  static GList* make_devices(const char* prefix, int n, double percentage)
+  {
+    GList* devices {};
+    for (int i=0; i<n; ++i)
+      {
+        const auto object_path = std::string(prefix) + std::to_string(i);
+        devices = g_list_append(devices, indicator_power_device_new(object_path.c_str(),
+                                                                    UP_DEVICE_KIND_BATTERY,
+                                                                    percentage,
+                                                                    UP_DEVICE_STATE_DISCHARGING,
+                                                                    60*i,
+                                                                    TRUE));
+      }
+    return devices;
+  }
+
+  // true iff the snapshot is exactly one of the two lists
+  static bool is_consistent(const struct indicator_power_shm_state& state)
+  {
+    const char* prefix;
+    double percentage;
+
+    if (state.n_devices == 3)
+      {
+        prefix = "/small/";
+        percentage = 10.0;
+      }
+    else if (state.n_devices == 5)
+      {
+        prefix = "/large/";
+        percentage = 90.0;
+      }
+    else
+      return false;
+
+    if (state.primary != int32_t(state.n_devices) - 1)
+      return false;
+
+    if (!state.has_primary || (std::string(state.primary_device.object_path) != state.devices[state.primary].object_path))
+      return false;
+
+    for (guint32 i=0; i<state.n_devices; ++i)
+      {
+        const auto& d = state.devices[i];
+        const auto object_path = std::string(prefix) + std::to_string(i);
+        if ((d.percentage != percentage) || (object_path != d.object_path) || (d.time != 60*int(i)))
+          return false;
+      }
+
+    return true;
+  }
+};
+
+TEST_F(BatteryShmFixture, PublishAndRead)
+{
+  GError* error {};
+  auto writer = indicator_power_shm_writer_new(path.c_str(), &error);
+  ASSERT_NE(nullptr, writer);
+  EXPECT_EQ(nullptr, error);
+
+  const struct indicator_power_shm* shm {};
+  ASSERT_EQ(0, indicator_power_shm_open(path.c_str(), &shm));
+
+  struct indicator_power_shm_state state;
+  ASSERT_EQ(0, indicator_power_shm_read(shm, &state));
+  EXPECT_EQ(0u, state.n_devices);
+  EXPECT_EQ(-1, state.primary);
+  EXPECT_EQ(0u, state.has_primary);
+  EXPECT_EQ(0u, state.flags);
+
+  indicator_power_shm_writer_publish(writer, small, static_cast<IndicatorPowerDevice*>(g_list_last(small)->data));
+  ASSERT_EQ(0, indicator_power_shm_read(shm, &state));
+  EXPECT_EQ(1u, state.generation);
+  EXPECT_EQ(3u, state.n_devices);
+  EXPECT_EQ(2, state.primary);
+  EXPECT_EQ(guint32(UP_DEVICE_KIND_BATTERY), state.devices[0].kind);
+  EXPECT_EQ(guint32(UP_DEVICE_STATE_DISCHARGING), state.devices[0].state);
+  EXPECT_EQ(1u, state.devices[0].power_supply);
+  EXPECT_TRUE(is_consistent(state));
+
+  // readers are told when the service goes away
+  indicator_power_shm_writer_free(writer);
+  ASSERT_EQ(0, indicator_power_shm_read(shm, &state));
+  EXPECT_TRUE(state.flags & INDICATOR_POWER_SHM_RETIRED);
+  EXPECT_FALSE(g_file_test(path.c_str(), G_FILE_TEST_EXISTS));
+
+  indicator_power_shm_close(shm);
+}
+
+TEST_F(BatteryShmFixture, TotalledPrimary)
+{
+  auto writer = indicator_power_shm_writer_new(path.c_str(), nullptr);
+  ASSERT_NE(nullptr, writer);
+
+  const struct indicator_power_shm* shm {};
+  ASSERT_EQ(0, indicator_power_shm_open(path.c_str(), &shm));
+
+  // with two batteries, the primary is their total, which isn't in the list
+  auto batteries = make_devices("/battery/", 2, 40.0);
+  auto total = indicator_power_device_new(nullptr, UP_DEVICE_KIND_BATTERY, 40.0, UP_DEVICE_STATE_DISCHARGING, 120, TRUE);
+  indicator_power_shm_writer_publish(writer, batteries, total);
+
+  struct indicator_power_shm_state state;
+  ASSERT_EQ(0, indicator_power_shm_read(shm, &state));
+  EXPECT_EQ(2u, state.n_devices);
+  EXPECT_EQ(-1, state.primary);
+  EXPECT_EQ(1u, state.has_primary);
+  EXPECT_EQ(guint32(UP_DEVICE_KIND_BATTERY), state.primary_device.kind);
+  EXPECT_EQ(40.0, state.primary_device.percentage);
+  EXPECT_EQ(120, state.primary_device.time);
+  EXPECT_STREQ("", state.primary_device.object_path);
+
+  g_object_unref(total);
+  g_list_free_full(batteries, g_object_unref);
+  indicator_power_shm_close(shm);
+  indicator_power_shm_writer_free(writer);
+}
+
+TEST_F(BatteryShmFixture, Replaced)
+{
+  auto old_writer = indicator_power_shm_writer_new(path.c_str(), nullptr);
+  ASSERT_NE(nullptr, old_writer);
+  auto new_writer = indicator_power_shm_writer_new(path.c_str(), nullptr);
+  ASSERT_NE(nullptr, new_writer);
+
+  // the old one mustn't remove its replacement
+  indicator_power_shm_writer_free(old_writer);
+  EXPECT_TRUE(g_file_test(path.c_str(), G_FILE_TEST_EXISTS));
+
+  indicator_power_shm_writer_free(new_writer);
+  EXPECT_FALSE(g_file_test(path.c_str(), G_FILE_TEST_EXISTS));
+}
+
+TEST_F(BatteryShmFixture, ConcurrentWriterAndReader)
+{
+  struct Data
+  {
+    IndicatorPowerShmWriter* writer;
+    GList* small;
+    GList* large;
+    std::atomic<bool> done;
+  };
+
+  auto writer = indicator_power_shm_writer_new(path.c_str(), nullptr);
+  ASSERT_NE(nullptr, writer);
+  indicator_power_shm_writer_publish(writer, small, static_cast<IndicatorPowerDevice*>(g_list_last(small)->data));
+
+  const struct indicator_power_shm* shm {};
+  ASSERT_EQ(0, indicator_power_shm_open(path.c_str(), &shm));
+
+  Data data {writer, small, large, {false}};
+  auto thread = g_thread_new("writer", [](gpointer gdata) -> gpointer {
+    auto d = static_cast<Data*>(gdata);
+    for (int i=0; i<100000; ++i)
+      {
+        auto devices = (i % 2) ? d->small : d->large;
+        indicator_power_shm_writer_publish(d->writer, devices, static_cast<IndicatorPowerDevice*>(g_list_last(devices)->data));
+      }
+    d->done = true;
+    return nullptr;
+  }, &data);
+
+  int reads = 0;
+  int inconsistent = 0;
+  guint64 generation = 0;
+  struct indicator_power_shm_state state;
+  while (!data.done)
+    {
+      if (indicator_power_shm_read(shm, &state) != 0)
+        continue;
+
+      ++reads;
+      if (!is_consistent(state) || (state.generation < generation))
+        ++inconsistent;
+      generation = state.generation;
+    }
+  g_thread_join(thread);
+
+  EXPECT_GT(reads, 0);
+  EXPECT_EQ(0, inconsistent);
+
+  ASSERT_EQ(0, indicator_power_shm_read(shm, &state));
+  EXPECT_EQ(100001u, state.generation);
+  EXPECT_TRUE(is_consistent(state));
+
+  indicator_power_shm_close(shm);
+  indicator_power_shm_writer_free(writer);
+}
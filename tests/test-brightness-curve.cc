@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "brightness-curve.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib> // abs()
+#include <memory>
+
+namespace
+{
+  const IndicatorPowerBrightnessCurveType all_types[] = {
+    BRIGHTNESS_CURVE_LINEAR,
+    BRIGHTNESS_CURVE_GAMMA,
+    BRIGHTNESS_CURVE_CIE_LIGHTNESS
+  };
+
+  struct Range { int lo; int hi; };
+
+  // a powerd-style range, and a couple of typical sysfs max_brightness values
+  const Range small_ranges[] = { {10, 255}, {1, 100}, {46, 937} };
+
+  std::unique_ptr<IndicatorPowerBrightnessCurve> make_curve(IndicatorPowerBrightnessCurveType type, Range range)
+  {
+    std::unique_ptr<IndicatorPowerBrightnessCurve> curve(new IndicatorPowerBrightnessCurve);
+    indicator_power_brightness_curve_init(curve.get(), type, 2.2, range.lo, range.hi);
+    return curve;
+  }
+}
+
+TEST(BrightnessCurve, Endpoints)
+{
+  for (const auto type : all_types)
+    {
+      for (const auto range : small_ranges)
+        {
+          auto curve = make_curve(type, range);
+          EXPECT_EQ(range.lo, indicator_power_brightness_curve_to_level(curve.get(), 0.0));
+          EXPECT_EQ(range.hi, indicator_power_brightness_curve_to_level(curve.get(), 1.0));
+          EXPECT_DOUBLE_EQ(0.0, indicator_power_brightness_curve_to_percentage(curve.get(), range.lo));
+          EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_curve_to_percentage(curve.get(), range.hi));
+
+          // out-of-range inputs get clamped
+          EXPECT_EQ(range.lo, indicator_power_brightness_curve_to_level(curve.get(), -0.5));
+          EXPECT_EQ(range.hi, indicator_power_brightness_curve_to_level(curve.get(), 1.5));
+          EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_curve_to_percentage(curve.get(), range.hi*2));
+        }
+    }
+}
+
+TEST(BrightnessCurve, LevelRoundTrip)
+{
+  // showing the hardware's level on the slider and writing it back
+  // mustn't change the brightness
+  for (const auto type : all_types)
+    {
+      for (const auto range : small_ranges)
+        {
+          auto curve = make_curve(type, range);
+          for (int level=range.lo; level<=range.hi; ++level)
+            {
+              const auto pct = indicator_power_brightness_curve_to_percentage(curve.get(), level);
+              EXPECT_EQ(level, indicator_power_brightness_curve_to_level(curve.get(), pct)) << type << ' ' << level;
+            }
+        }
+    }
+}
+
+TEST(BrightnessCurve, LargeRangeRoundTrip)
+{
+  // some panels have far more levels than the tables have steps,
+  // so just make sure we stay close
+  const Range range {6000, 120000};
+  const int tolerance {(range.hi - range.lo) / 1000};
+
+  for (const auto type : all_types)
+    {
+      auto curve = make_curve(type, range);
+      for (int level=range.lo; level<=range.hi; level+=7)
+        {
+          const auto pct = indicator_power_brightness_curve_to_percentage(curve.get(), level);
+          EXPECT_LE(std::abs(level - indicator_power_brightness_curve_to_level(curve.get(), pct)), tolerance) << type << ' ' << level;
+        }
+    }
+}
+
+TEST(BrightnessCurve, Monotonic)
+{
+  for (const auto type : all_types)
+    {
+      auto curve = make_curve(type, small_ranges[0]);
+      int prev = indicator_power_brightness_curve_to_level(curve.get(), 0.0);
+      for (int i=1; i<=1000; ++i)
+        {
+          const auto level = indicator_power_brightness_curve_to_level(curve.get(), i/1000.0);
+          EXPECT_LE(prev, level) << type << ' ' << i;
+          prev = level;
+        }
+    }
+}
+
+TEST(BrightnessCurve, PerceptualCurvesFavorTheDimEnd)
+{
+  const Range range {0, 1000};
+  auto linear = make_curve(BRIGHTNESS_CURVE_LINEAR, range);
+  auto gamma = make_curve(BRIGHTNESS_CURVE_GAMMA, range);
+  auto cie = make_curve(BRIGHTNESS_CURVE_CIE_LIGHTNESS, range);
+
+  EXPECT_EQ(500, indicator_power_brightness_curve_to_level(linear.get(), 0.5));
+  EXPECT_LT(indicator_power_brightness_curve_to_level(gamma.get(), 0.5), 250);
+  EXPECT_LT(indicator_power_brightness_curve_to_level(cie.get(), 0.5), 250);
+
+  // L*=50 is about 18% luminance
+  EXPECT_NEAR(184, indicator_power_brightness_curve_to_level(cie.get(), 0.5), 1);
+}
+
+TEST(BrightnessCurve, EmptyRange)
+{
+  auto curve = make_curve(BRIGHTNESS_CURVE_CIE_LIGHTNESS, Range{0, 0});
+  EXPECT_EQ(0, indicator_power_brightness_curve_to_level(curve.get(), 0.5));
+  EXPECT_DOUBLE_EQ(0.0, indicator_power_brightness_curve_to_percentage(curve.get(), 0));
+}
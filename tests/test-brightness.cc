@@ -0,0 +1,375 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "brightness.h"
+#include "brightness-curve.h"
+#include "dbus-powerd.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const guint SETTLE_MSEC {500}; // from brightness.c
+
+  const char* const INTROSPECTION_XML {
+    "<node>"
+    "  <interface name='com.canonical.Unity.Screen'>"
+    "    <method name='setUserBrightness'>"
+    "      <arg type='i' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.login1.Session'>"
+    "    <method name='SetBrightness'>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='u' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>"
+  };
+}
+
+/***
+****  Stand-ins for the system services that brightness.c writes to,
+****  on a private bus. Unity.Screen can hold its replies so that we
+****  can see what's sent while a call's in flight.
+***/
+
+class BrightnessFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+  static void on_method_call(GDBusConnection       * /*connection*/,
+                             const gchar           * /*sender*/,
+                             const gchar           * /*object_path*/,
+                             const gchar           * /*interface_name*/,
+                             const gchar           * method_name,
+                             GVariant              * parameters,
+                             GDBusMethodInvocation * invocation,
+                             gpointer                gself)
+  {
+    auto self = static_cast<BrightnessFixture*>(gself);
+
+    if (!g_strcmp0(method_name, "setUserBrightness"))
+      {
+        gint32 value {};
+        g_variant_get(parameters, "(i)", &value);
+        self->screen_values.push_back(value);
+        if (self->screen_holds_replies)
+          self->screen_held.push_back(invocation);
+        else
+          g_dbus_method_invocation_return_value(invocation, nullptr);
+      }
+    else if (!g_strcmp0(method_name, "SetBrightness"))
+      {
+        guint32 value {};
+        g_variant_get(parameters, "(&s&su)", nullptr, nullptr, &value);
+        self->logind_values.push_back(value);
+        if (self->logind_error.empty())
+          g_dbus_method_invocation_return_value(invocation, nullptr);
+        else
+          g_dbus_method_invocation_return_dbus_error(invocation, self->logind_error.c_str(), "Not here");
+      }
+  }
+
+  static gboolean on_get_brightness_params(DbusPowerd            * o,
+                                           GDBusMethodInvocation * invocation,
+                                           gpointer                gself)
+  {
+    auto self = static_cast<BrightnessFixture*>(gself);
+
+    ++self->powerd_calls;
+    if (self->powerd_params != nullptr)
+      dbus_powerd_complete_get_brightness_params(o, invocation, self->powerd_params);
+    else
+      self->powerd_held.push_back(invocation);
+    return TRUE;
+  }
+
+  void add_service(const char* name, const char* path, const char* interface)
+  {
+    static const GDBusInterfaceVTable vtable { on_method_call, nullptr, nullptr, {} };
+
+    GError* error {};
+    const auto id = g_dbus_connection_register_object(fake_bus, path,
+                                                      g_dbus_node_info_lookup_interface(node_info, interface),
+                                                      &vtable, this, nullptr, &error);
+    g_assert_no_error(error);
+    registrations.push_back(id);
+
+    own_ids.push_back(g_bus_own_name_on_connection(fake_bus, name, G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                   nullptr, nullptr, nullptr, nullptr));
+    ASSERT_TRUE(wait_for_name_owned(fake_bus, name));
+  }
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* fake_bus {};
+  GDBusNodeInfo* node_info {};
+  std::vector<guint> registrations;
+  std::vector<guint> own_ids;
+  GSettings* system_settings {};
+  GSettings* cache_settings {};
+
+  std::vector<gint32> screen_values;
+  bool screen_holds_replies {};
+  std::deque<GDBusMethodInvocation*> screen_held;
+
+  std::vector<guint32> logind_values;
+  std::string logind_error;
+
+  // powerd only has to answer if a test gives it params to answer with;
+  // otherwise brightness.c keeps using the cached ones
+  DbusPowerd* powerd {};
+  guint powerd_own_id {};
+  GVariant* powerd_params {};
+  int powerd_calls {};
+  std::deque<GDBusMethodInvocation*> powerd_held;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // the phone's system settings schema is only installed for this test
+    g_setenv("GSETTINGS_SCHEMA_DIR", BRIGHTNESS_SCHEMA_DIR, true);
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    fake_bus = g_dbus_connection_new_for_address_sync(address,
+                                                      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                      nullptr, nullptr, nullptr);
+    ASSERT_NE(nullptr, fake_bus);
+    g_dbus_connection_set_exit_on_close(fake_bus, false);
+
+    node_info = g_dbus_node_info_new_for_xml(INTROSPECTION_XML, nullptr);
+    ASSERT_NE(nullptr, node_info);
+    add_service("com.canonical.Unity.Screen", "/com/canonical/Unity/Screen", "com.canonical.Unity.Screen");
+    add_service("org.freedesktop.login1", "/org/freedesktop/login1/session/auto", "org.freedesktop.login1.Session");
+
+    powerd = dbus_powerd_skeleton_new();
+    g_signal_connect(powerd, "handle-get-brightness-params", G_CALLBACK(on_get_brightness_params), this);
+    ASSERT_TRUE(g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(powerd), fake_bus, "/com/canonical/powerd", nullptr));
+    powerd_own_id = g_bus_own_name_on_connection(fake_bus, "com.canonical.powerd", G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 nullptr, nullptr, nullptr, nullptr);
+    ASSERT_TRUE(wait_for_name_owned(fake_bus, "com.canonical.powerd"));
+
+    // start from a known state; the memory backend outlives each test
+    system_settings = g_settings_new("com.ubuntu.touch.system");
+    g_settings_reset(system_settings, "brightness");
+    g_settings_set_boolean(system_settings, "brightness-needs-hardware-default", false);
+
+    // give it a range to work with without needing powerd
+    cache_settings = g_settings_new("com.canonical.indicator.power");
+    g_settings_set_value(cache_settings, "powerd-brightness-params", g_variant_new("(iiiib)", 5, 10, 200, 100, FALSE));
+  }
+
+  void TearDown() override
+  {
+    for (auto invocation : screen_held)
+      g_dbus_method_invocation_return_value(invocation, nullptr);
+    screen_held.clear();
+
+    for (auto invocation : powerd_held)
+      dbus_powerd_complete_get_brightness_params(powerd, invocation, g_variant_new("(iiiib)", 5, 10, 200, 100, FALSE));
+    powerd_held.clear();
+    g_bus_unown_name(powerd_own_id);
+    g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(powerd));
+    g_clear_object(&powerd);
+    g_clear_pointer(&powerd_params, g_variant_unref);
+
+    g_settings_reset(cache_settings, "powerd-brightness-params");
+    g_clear_object(&cache_settings);
+    g_clear_object(&system_settings);
+
+    for (auto id : own_ids)
+      g_bus_unown_name(id);
+    for (auto id : registrations)
+      g_dbus_connection_unregister_object(fake_bus, id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_clear_object(&fake_bus);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  // No sysfs discovery, so the host's own backlight can't get in the way.
+  // It asks powerd for its params as soon as it has the system bus,
+  // so wait for that before we start moving the slider
+  IndicatorPowerBrightness* create_brightness(const char* backlight_name=nullptr, int backlight_max=0)
+  {
+    const auto calls_before = powerd_calls;
+    auto brightness = indicator_power_brightness_new_with_backlight(backlight_name, backlight_max);
+    EXPECT_TRUE(wait_for([this, calls_before](){return powerd_calls > calls_before;}));
+    return brightness;
+  }
+
+  void release_screen_reply()
+  {
+    ASSERT_FALSE(screen_held.empty());
+    g_dbus_method_invocation_return_value(screen_held.front(), nullptr);
+    screen_held.pop_front();
+  }
+
+  int applied_brightness() const
+  {
+    return g_settings_get_int(system_settings, "brightness");
+  }
+
+  void init_curve(IndicatorPowerBrightnessCurve* curve, int lo, int hi) const
+  {
+    indicator_power_brightness_curve_init(curve,
+                                          IndicatorPowerBrightnessCurveType(g_settings_get_enum(cache_settings, "brightness-curve")),
+                                          g_settings_get_double(cache_settings, "brightness-gamma"),
+                                          lo, hi);
+  }
+};
+
+TEST_F(BrightnessFixture, DragKeepsOneWriteInFlight)
+{
+  screen_holds_replies = true;
+  auto brightness = create_brightness();
+
+  // a drag moves the slider faster than the screen can answer...
+  for (int i=1; i<=9; ++i)
+    indicator_power_brightness_set_percentage(brightness, i/10.0);
+  EXPECT_TRUE(wait_for([this](){return screen_values.size() == 1;}));
+  wait_msec();
+  EXPECT_EQ(1u, screen_values.size());
+
+  // ...so when the first write returns, only the latest value goes next
+  release_screen_reply();
+  EXPECT_TRUE(wait_for([this](){return screen_values.size() == 2;}));
+  release_screen_reply();
+  wait_msec();
+  EXPECT_EQ(2u, screen_values.size());
+  EXPECT_NE(screen_values.front(), screen_values.back());
+
+  // and it's the value that gets saved
+  advance_clock(std::chrono::milliseconds(SETTLE_MSEC));
+  EXPECT_EQ(screen_values.back(), applied_brightness());
+
+  g_object_unref(brightness);
+}
+
+TEST_F(BrightnessFixture, SettingIsSavedOnceTheSliderSettles)
+{
+  auto brightness = create_brightness();
+  const auto before = applied_brightness();
+
+  // moving the slider again restarts the wait...
+  indicator_power_brightness_set_percentage(brightness, 0.3);
+  advance_clock(std::chrono::milliseconds(SETTLE_MSEC - 100));
+  indicator_power_brightness_set_percentage(brightness, 0.7);
+  advance_clock(std::chrono::milliseconds(SETTLE_MSEC - 100));
+  EXPECT_EQ(before, applied_brightness());
+
+  // ...and once it's been still long enough, the last value's saved
+  advance_clock(std::chrono::milliseconds(100));
+  EXPECT_NE(before, applied_brightness());
+  EXPECT_TRUE(wait_for([this](){return !screen_values.empty() && (screen_values.back() == applied_brightness());}));
+
+  g_object_unref(brightness);
+}
+
+TEST_F(BrightnessFixture, LogindErrorsFallBackToUnityScreen)
+{
+  // the made-up backlight's range, and the cached powerd one
+  IndicatorPowerBrightnessCurve sysfs_curve;
+  IndicatorPowerBrightnessCurve powerd_curve;
+  init_curve(&sysfs_curve, 1000/20, 1000);
+  init_curve(&powerd_curve, 10, 200);
+
+  // an old logind without session/auto, and a caller outside any session
+  for (const auto error_name : { "org.freedesktop.DBus.Error.UnknownObject",
+                                 "org.freedesktop.DBus.Error.AccessDenied" })
+    {
+      logind_error = error_name;
+      logind_values.clear();
+      screen_values.clear();
+
+      auto brightness = create_brightness("test_backlight", 1000);
+
+      // the value logind refused is resent through Unity.Screen,
+      // converted from the backlight's units to powerd's...
+      indicator_power_brightness_set_percentage(brightness, 0.5);
+      EXPECT_TRUE(wait_for([this](){return screen_values.size() == 1;})) << error_name;
+      ASSERT_EQ(1u, logind_values.size()) << error_name;
+      const auto percentage = indicator_power_brightness_curve_to_percentage(&sysfs_curve, gint(logind_values.front()));
+      EXPECT_EQ(indicator_power_brightness_curve_to_level(&powerd_curve, percentage), screen_values.front()) << error_name;
+
+      // ...and logind isn't asked again, nor are its units used
+      indicator_power_brightness_set_percentage(brightness, 0.6);
+      EXPECT_TRUE(wait_for([this](){return screen_values.size() == 2;})) << error_name;
+      EXPECT_EQ(1u, logind_values.size()) << error_name;
+      EXPECT_EQ(indicator_power_brightness_curve_to_level(&powerd_curve, 0.6), screen_values.back()) << error_name;
+
+      // ...and what's saved is in powerd's units too
+      advance_clock(std::chrono::milliseconds(SETTLE_MSEC));
+      EXPECT_EQ(screen_values.back(), applied_brightness()) << error_name;
+
+      g_object_unref(brightness);
+    }
+}
+
+TEST_F(BrightnessFixture, InvalidPowerdParamsAreIgnored)
+{
+  // a first session, so good params would set the hardware default
+  g_settings_set_boolean(system_settings, "brightness-needs-hardware-default", true);
+  g_settings_reset(cache_settings, "powerd-brightness-params");
+  auto cached_before = g_settings_get_value(cache_settings, "powerd-brightness-params");
+
+  // a powerd whose max is below its min
+  powerd_params = g_variant_ref_sink(g_variant_new("(iiiib)", 5, 200, 10, 0, FALSE));
+
+  // it's warned about, so don't let the warning be fatal here
+  int n_warnings = 0;
+  const auto old_mask = g_log_set_fatal_mask(G_LOG_DOMAIN, G_LOG_LEVEL_ERROR);
+  const auto handler_id = g_log_set_handler(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                                            [](const gchar*, GLogLevelFlags, const gchar*, gpointer gcount){
+                                              ++*static_cast<int*>(gcount);
+                                            }, &n_warnings);
+  auto brightness = create_brightness();
+  EXPECT_TRUE(wait_for([&n_warnings](){return n_warnings > 0;}));
+  wait_msec();
+  g_log_remove_handler(G_LOG_DOMAIN, handler_id);
+  g_log_set_fatal_mask(G_LOG_DOMAIN, old_mask);
+
+  // nothing's cached, the screen isn't blanked, and the default's still pending
+  auto cached_after = g_settings_get_value(cache_settings, "powerd-brightness-params");
+  EXPECT_TRUE(g_variant_equal(cached_before, cached_after));
+  EXPECT_TRUE(screen_values.empty());
+  EXPECT_TRUE(g_settings_get_boolean(system_settings, "brightness-needs-hardware-default"));
+
+  g_object_unref(brightness);
+  g_variant_unref(cached_after);
+  g_variant_unref(cached_before);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "clock.h"
+#include "clock-mock.h"
+#include "clock-real.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+class ClockFixture: public GlibFixture
+{
+protected:
+
+  IndicatorPowerClockMock* mock() const
+  {
+    return INDICATOR_POWER_CLOCK_MOCK(clock);
+  }
+
+  static gboolean on_timeout(gpointer gcalls)
+  {
+    auto calls = static_cast<std::vector<gint64>*>(gcalls);
+    calls->push_back(indicator_power_clock_get_monotonic_time(indicator_power_clock_get_default()));
+    return calls->size() < 3 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+  }
+};
+
+TEST_F(ClockFixture, FixtureSetsDefault)
+{
+  EXPECT_EQ(clock, indicator_power_clock_get_default());
+}
+
+TEST_F(ClockFixture, TimeOnlyMovesWhenAdvanced)
+{
+  const auto begin = indicator_power_clock_get_monotonic_time(clock);
+  wait_msec(20);
+  EXPECT_EQ(begin, indicator_power_clock_get_monotonic_time(clock));
+
+  indicator_power_clock_mock_advance(mock(), 1500);
+  EXPECT_EQ(begin + 1500*1000, indicator_power_clock_get_monotonic_time(clock));
+}
+
+TEST_F(ClockFixture, TimersFireInOrder)
+{
+  const auto begin = indicator_power_clock_get_monotonic_time(clock);
+
+  std::vector<gint64> calls;
+  indicator_power_clock_timeout_add(clock, 100, on_timeout, &calls);
+  EXPECT_EQ(1u, indicator_power_clock_mock_get_n_timers(mock()));
+
+  indicator_power_clock_mock_advance(mock(), 99);
+  EXPECT_TRUE(calls.empty());
+
+  // a repeating timer can fire several times in one advance,
+  // and sees the time at which it was due
+  indicator_power_clock_mock_advance(mock(), 1000);
+  ASSERT_EQ(3u, calls.size());
+  EXPECT_EQ(begin + 100*1000, calls[0]);
+  EXPECT_EQ(begin + 200*1000, calls[1]);
+  EXPECT_EQ(begin + 300*1000, calls[2]);
+  EXPECT_EQ(0u, indicator_power_clock_mock_get_n_timers(mock()));
+}
+
+TEST_F(ClockFixture, SourceRemove)
+{
+  std::vector<gint64> calls;
+  const auto tag = indicator_power_clock_timeout_add(clock, 100, on_timeout, &calls);
+  indicator_power_clock_source_remove(clock, tag);
+  EXPECT_EQ(0u, indicator_power_clock_mock_get_n_timers(mock()));
+
+  indicator_power_clock_mock_advance(mock(), 1000);
+  EXPECT_TRUE(calls.empty());
+}
+
+TEST_F(ClockFixture, RestoreRealClock)
+{
+  indicator_power_clock_set_default(nullptr);
+  EXPECT_TRUE(INDICATOR_IS_POWER_CLOCK_REAL(indicator_power_clock_get_default()));
+}
+
+TEST_F(ClockFixture, RealClockRemovesFromTheAddingContext)
+{
+  auto real = indicator_power_clock_real_new();
+  auto context = g_main_context_new();
+  std::vector<gint64> calls;
+
+  // add a timer on one context...
+  g_main_context_push_thread_default(context);
+  const auto tag = indicator_power_clock_timeout_add(real, 10, on_timeout, &calls);
+  g_main_context_pop_thread_default(context);
+
+  // ...and remove it while another's the thread-default
+  indicator_power_clock_source_remove(real, tag);
+
+  const auto deadline = g_get_monotonic_time() + 100*G_TIME_SPAN_MILLISECOND;
+  while (g_get_monotonic_time() < deadline)
+    if (!g_main_context_iteration(context, false))
+      g_usleep(G_TIME_SPAN_MILLISECOND);
+  EXPECT_TRUE(calls.empty());
+
+  g_main_context_unref(context);
+  g_object_unref(real);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "datafiles.h"
+
+#include <gtest/gtest.h>
+
+#include <glib/gstdio.h>
+
+#include <string>
+
+class DatafilesFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * SOUNDS_DIR {XDG_DATA_HOME "/" GETTEXT_PACKAGE "/sounds"};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    g_setenv ("XDG_DATA_HOME", XDG_DATA_HOME, TRUE);
+  }
+
+  void TearDown() override
+  {
+    datafile_clear_cache();
+
+    super::TearDown();
+  }
+
+  std::string find(const char* basename)
+  {
+    std::string ret;
+    auto filename = datafile_find(DATAFILE_TYPE_SOUND, basename);
+    if (filename != nullptr)
+      ret = filename;
+    g_free(filename);
+    return ret;
+  }
+};
+
+TEST_F(DatafilesFixture, Find)
+{
+  EXPECT_EQ(std::string(SOUNDS_DIR "/Low battery.ogg"), find("Low battery.ogg"));
+  EXPECT_EQ("", find("no-such-file.ogg"));
+
+  // repeated lookups come from the index
+  for (int i=0; i<3; ++i)
+    EXPECT_EQ(std::string(SOUNDS_DIR "/Low battery.ogg"), find("Low battery.ogg"));
+}
+
+TEST_F(DatafilesFixture, NoticesChanges)
+{
+  const std::string basename {"test-datafiles.ogg"};
+  const std::string path {std::string(SOUNDS_DIR) + "/" + basename};
+
+  EXPECT_EQ("", find(basename.c_str()));
+
+  ASSERT_TRUE(g_file_set_contents(path.c_str(), "", 0, nullptr));
+  EXPECT_TRUE(wait_for([this,&basename,&path](){return find(basename.c_str()) == path;}));
+
+  g_unlink(path.c_str());
+  EXPECT_TRUE(wait_for([this,&basename](){return find(basename.c_str()).empty();}));
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+#include "fake-upower.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-upower.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+class UPowerProviderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* system_bus {};
+  std::unique_ptr<FakeUPower> upower;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // the provider talks to the system bus, so point that at a private bus too
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+    g_dbus_connection_set_exit_on_close(system_bus, false);
+    g_object_add_weak_pointer(G_OBJECT(system_bus), reinterpret_cast<gpointer*>(&system_bus));
+
+    upower.reset(new FakeUPower(address));
+  }
+
+  void TearDown() override
+  {
+    upower.reset();
+
+    g_object_unref(system_bus);
+    EXPECT_TRUE(wait_for([this](){return system_bus == nullptr;}));
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  static IndicatorPowerDevice* find_device(IndicatorPowerDeviceProvider* provider,
+                                           const std::string& path)
+  {
+    IndicatorPowerDevice* ret {};
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    for (auto l=devices; l!=nullptr; l=l->next)
+    {
+      auto device = INDICATOR_POWER_DEVICE(l->data);
+      if (path == indicator_power_device_get_object_path(device))
+        ret = device;
+    }
+    if (ret != nullptr)
+      g_object_ref(ret);
+    g_list_free_full(devices, g_object_unref);
+    return ret;
+  }
+
+  static guint count_devices(IndicatorPowerDeviceProvider* provider)
+  {
+    auto devices = indicator_power_device_provider_get_devices(provider);
+    const auto n = g_list_length(devices);
+    g_list_free_full(devices, g_object_unref);
+    return n;
+  }
+
+  static double get_percentage(IndicatorPowerDeviceProvider* provider,
+                               const std::string& path)
+  {
+    double ret {-1.0};
+    auto device = find_device(provider, path);
+    if (device != nullptr)
+    {
+      ret = indicator_power_device_get_percentage(device);
+      g_object_unref(device);
+    }
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(UPowerProviderFixture, HelloWorld)
+{
+  EXPECT_TRUE(upower->get_paths().empty());
+}
+
+TEST_F(UPowerProviderFixture, EnumeratesDevices)
+{
+  const auto battery = upower->add_device(FakeUPower::battery(50.0));
+  const auto mouse = upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_MOUSE, 80.0));
+
+  auto provider = indicator_power_device_provider_upower_new();
+  EXPECT_TRUE(wait_for_fast_forward([provider](){return count_devices(provider) == 2;}));
+
+  auto device = find_device(provider, battery);
+  ASSERT_NE(nullptr, device);
+  EXPECT_EQ(UP_DEVICE_KIND_BATTERY, indicator_power_device_get_kind(device));
+  EXPECT_EQ(UP_DEVICE_STATE_DISCHARGING, indicator_power_device_get_state(device));
+  EXPECT_DOUBLE_EQ(50.0, indicator_power_device_get_percentage(device));
+  g_object_unref(device);
+
+  device = find_device(provider, mouse);
+  ASSERT_NE(nullptr, device);
+  EXPECT_EQ(UP_DEVICE_KIND_MOUSE, indicator_power_device_get_kind(device));
+  g_object_unref(device);
+
+  g_object_unref(provider);
+}
+
+TEST_F(UPowerProviderFixture, PropertiesChanged)
+{
+  const auto path = upower->add_device(FakeUPower::battery(50.0));
+
+  auto provider = indicator_power_device_provider_upower_new();
+  EXPECT_TRUE(wait_for_fast_forward([provider](){return count_devices(provider) == 1;}));
+
+  upower->set_device(path, FakeUPower::battery(42.0));
+  EXPECT_TRUE(wait_for([provider, path](){return get_percentage(provider, path) == 42.0;}));
+
+  upower->set_device(path, FakeUPower::battery(42.0, UP_DEVICE_STATE_CHARGING));
+  EXPECT_TRUE(wait_for([provider, path](){
+    auto device = find_device(provider, path);
+    const auto state = indicator_power_device_get_state(device);
+    g_object_unref(device);
+    return state == UP_DEVICE_STATE_CHARGING;
+  }));
+
+  g_object_unref(provider);
+}
+
+TEST_F(UPowerProviderFixture, AddAndRemove)
+{
+  auto provider = indicator_power_device_provider_upower_new();
+  wait_msec(100);
+  EXPECT_EQ(0u, count_devices(provider));
+
+  const auto path = upower->add_device(FakeUPower::peripheral(UP_DEVICE_KIND_KEYBOARD, 30.0));
+  EXPECT_TRUE(wait_for_fast_forward([provider](){return count_devices(provider) == 1;}));
+
+  upower->remove_device(path);
+  EXPECT_TRUE(wait_for([provider](){return count_devices(provider) == 0;}));
+
+  g_object_unref(provider);
+}
+
+TEST_F(UPowerProviderFixture, SteadyDischargeUnderLoad)
+{
+  static constexpr guint n_batteries {4};
+  static constexpr double events_per_second {200};
+
+  std::vector<std::string> paths;
+  for (guint i=0; i<n_batteries; ++i)
+    paths.push_back(upower->add_device(FakeUPower::battery(100.0)));
+
+  auto provider = indicator_power_device_provider_upower_new();
+  EXPECT_TRUE(wait_for_fast_forward([provider](){return count_devices(provider) == n_batteries;}));
+
+  upower->start(FakeUPower::Pattern::SteadyDischarge, events_per_second);
+  wait_msec(1000);
+  upower->stop();
+  EXPECT_LT(events_per_second/2, upower->get_event_count());
+
+  // once the fake quiets down, the provider should agree with it
+  EXPECT_TRUE(wait_for([this, provider, paths](){
+    for (const auto& path : paths)
+      if (get_percentage(provider, path) != upower->get_device(path).percentage)
+        return false;
+    return true;
+  }, 2000));
+
+  g_object_unref(provider);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "icon-theme.h"
+
+#include <gtest/gtest.h>
+
+#include <glib/gstdio.h>
+
+#include <string>
+#include <vector>
+
+class IconThemeFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+  std::vector<std::string> m_created;
+
+protected:
+
+  static constexpr char const * ICONS_DIR {XDG_DATA_HOME "/icons"};
+
+  IndicatorPowerIconTheme * theme = nullptr;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    g_setenv ("XDG_DATA_HOME", XDG_DATA_HOME, TRUE);
+
+    make_dir(ICONS_DIR);
+    make_dir(theme_path("test-child"));
+    make_dir(theme_path("test-child/scalable"));
+    make_file(theme_path("test-child/index.theme"),
+              "[Icon Theme]\nName=Child\nInherits=test-parent\nDirectories=scalable\n");
+    make_file(theme_path("test-child/scalable/child-only.svg"));
+    make_file(theme_path("test-child/scalable/shared.svg"));
+
+    make_dir(theme_path("test-parent"));
+    make_dir(theme_path("test-parent/24x24"));
+    make_file(theme_path("test-parent/index.theme"),
+              "[Icon Theme]\nName=Parent\nDirectories=24x24\n");
+    make_file(theme_path("test-parent/24x24/parent-only.png"));
+    make_file(theme_path("test-parent/24x24/shared.png"));
+
+    theme = indicator_power_icon_theme_new("test-child");
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&theme);
+
+    for (auto it=m_created.rbegin(), end=m_created.rend(); it!=end; ++it)
+      g_remove(it->c_str());
+
+    super::TearDown();
+  }
+
+  std::string theme_path(const char* relative)
+  {
+    return std::string(ICONS_DIR) + "/" + relative;
+  }
+
+  void make_dir(const std::string& path)
+  {
+    if (!g_file_test(path.c_str(), G_FILE_TEST_IS_DIR))
+      {
+        ASSERT_EQ(0, g_mkdir_with_parents(path.c_str(), 0700));
+        m_created.push_back(path);
+      }
+  }
+
+  void make_file(const std::string& path, const char* contents="")
+  {
+    ASSERT_TRUE(g_file_set_contents(path.c_str(), contents, -1, nullptr));
+    m_created.push_back(path);
+  }
+
+  std::string choose(std::vector<const char*> names)
+  {
+    std::string ret;
+    names.push_back(nullptr);
+    auto icon = indicator_power_icon_theme_choose_icon(theme, names.data());
+    if (icon != nullptr)
+      {
+        ret = g_themed_icon_get_names(G_THEMED_ICON(icon))[0];
+        g_object_unref(icon);
+      }
+    return ret;
+  }
+};
+
+TEST_F(IconThemeFixture, HasIcon)
+{
+  EXPECT_TRUE(indicator_power_icon_theme_has_icon(theme, "child-only"));
+  EXPECT_TRUE(indicator_power_icon_theme_has_icon(theme, "parent-only"));
+  EXPECT_TRUE(indicator_power_icon_theme_has_icon(theme, "shared"));
+  EXPECT_FALSE(indicator_power_icon_theme_has_icon(theme, "no-such-icon"));
+}
+
+TEST_F(IconThemeFixture, ChoosesLikeClients)
+{
+  // the theme itself is searched for every name before its parent is
+  EXPECT_EQ("child-only", choose({"no-such-icon", "parent-only", "child-only"}));
+  EXPECT_EQ("parent-only", choose({"no-such-icon", "parent-only"}));
+  EXPECT_EQ("", choose({"no-such-icon"}));
+  EXPECT_EQ("", choose({}));
+}
+
+TEST_F(IconThemeFixture, NoticesChanges)
+{
+  int changes = 0;
+  auto on_changed = +[](IndicatorPowerIconTheme*, gpointer gchanges) {
+    ++*static_cast<int*>(gchanges);
+  };
+  g_signal_connect(theme, INDICATOR_POWER_ICON_THEME_SIGNAL_CHANGED, G_CALLBACK(on_changed), &changes);
+
+  EXPECT_EQ("parent-only", choose({"new-icon", "parent-only"}));
+
+  // installing icons ends with the theme's cache being updated
+  make_file(theme_path("test-child/scalable/new-icon.svg"));
+  make_file(theme_path("test-child/icon-theme.cache"));
+  EXPECT_TRUE(wait_for([&changes](){return changes > 0;}));
+  EXPECT_EQ("new-icon", choose({"new-icon", "parent-only"}));
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "low-battery.h"
+
+#include <gtest/gtest.h>
+
+class LowBatteryFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  IndicatorPowerLowBattery lb;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    indicator_power_low_battery_init(&lb);
+  }
+
+  IndicatorPowerLowBatteryAction update(double percentage, bool discharging=true)
+  {
+    return indicator_power_low_battery_update(&lb,
+                                              percentage,
+                                              discharging,
+                                              indicator_power_clock_get_monotonic_time(clock));
+  }
+};
+
+TEST_F(LowBatteryFixture, LevelsForPercentage)
+{
+  EXPECT_EQ(POWER_LEVEL_CRITICAL, indicator_power_low_battery_get_level_for_percentage(0.0));
+  EXPECT_EQ(POWER_LEVEL_CRITICAL, indicator_power_low_battery_get_level_for_percentage(2.0));
+  EXPECT_EQ(POWER_LEVEL_VERY_LOW, indicator_power_low_battery_get_level_for_percentage(2.1));
+  EXPECT_EQ(POWER_LEVEL_VERY_LOW, indicator_power_low_battery_get_level_for_percentage(5.0));
+  EXPECT_EQ(POWER_LEVEL_LOW, indicator_power_low_battery_get_level_for_percentage(10.0));
+  EXPECT_EQ(POWER_LEVEL_OK, indicator_power_low_battery_get_level_for_percentage(10.1));
+}
+
+TEST_F(LowBatteryFixture, NoisyReadingsAtThreshold)
+{
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(50.0));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(10.0));
+  EXPECT_EQ(POWER_LEVEL_LOW, lb.level);
+
+  // hovering around 10% neither clears nor re-shows
+  for (const auto pct : {10.3, 9.8, 10.6, 9.9, 10.9, 10.0})
+    {
+      EXPECT_EQ(LOW_BATTERY_ACTION_NONE, update(pct)) << pct;
+      EXPECT_EQ(POWER_LEVEL_LOW, lb.level) << pct;
+    }
+
+  // clearing the band does clear it
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(11.0));
+  EXPECT_EQ(POWER_LEVEL_OK, lb.level);
+}
+
+TEST_F(LowBatteryFixture, WorseningIsImmediate)
+{
+  update(50.0);
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(9.0));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(4.0));
+  EXPECT_EQ(POWER_LEVEL_VERY_LOW, lb.level);
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(1.0));
+  EXPECT_EQ(POWER_LEVEL_CRITICAL, lb.level);
+
+  // improving climbs back up one band at a time
+  update(5.5);
+  EXPECT_EQ(POWER_LEVEL_VERY_LOW, lb.level);
+  update(6.0);
+  EXPECT_EQ(POWER_LEVEL_LOW, lb.level);
+}
+
+TEST_F(LowBatteryFixture, FlappingAdapter)
+{
+  update(50.0);
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(8.0));
+
+  // plugging in always clears, but unplugging again doesn't re-show right away
+  for (int i=0; i<5; ++i)
+    {
+      advance_clock(std::chrono::seconds(10));
+      EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(8.0, false));
+      EXPECT_EQ(LOW_BATTERY_ACTION_NONE, update(8.0, true));
+    }
+
+  // ...unless the level gets worse
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(4.0));
+
+  // ...or enough time has passed
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(4.0, false));
+  advance_clock(std::chrono::seconds(LOW_BATTERY_DEFAULT_RENOTIFY_SEC - 1));
+  EXPECT_EQ(LOW_BATTERY_ACTION_NONE, update(4.0, true));
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(4.0, false));
+  advance_clock(std::chrono::seconds(1));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(4.0, true));
+}
+
+TEST_F(LowBatteryFixture, Configurable)
+{
+  lb.hysteresis = 0.0;
+  lb.renotify_usec = 0;
+
+  update(50.0);
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(10.0));
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(10.1));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(10.0));
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(10.0, false));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(10.0, true));
+}
+
+TEST_F(LowBatteryFixture, ForecastNeedsTwoSamples)
+{
+  const auto now = indicator_power_clock_get_monotonic_time(clock);
+  indicator_power_low_battery_sample(&lb, 20.0, true, now);
+  EXPECT_EQ(-1, indicator_power_low_battery_get_time_until(&lb, POWER_LEVEL_LOW, now));
+
+  // same charge again doesn't give us a rate either
+  advance_clock(std::chrono::seconds(60));
+  indicator_power_low_battery_sample(&lb, 20.0, true, indicator_power_clock_get_monotonic_time(clock));
+  EXPECT_EQ(-1, indicator_power_low_battery_get_time_until(&lb, POWER_LEVEL_LOW, now));
+}
+
+TEST_F(LowBatteryFixture, ForecastCrossings)
+{
+  // one percent per minute
+  for (int pct=20; pct>=18; --pct)
+    {
+      indicator_power_low_battery_sample(&lb, pct, true, indicator_power_clock_get_monotonic_time(clock));
+      advance_clock(std::chrono::seconds(60));
+    }
+  const auto now = indicator_power_clock_get_monotonic_time(clock);
+  EXPECT_DOUBLE_EQ(1.0/60.0, lb.rate);
+
+  // 18% a minute ago --> 17% now
+  EXPECT_DOUBLE_EQ(17.0, indicator_power_low_battery_get_forecast_percentage(&lb, now));
+  EXPECT_NEAR(7*60*G_USEC_PER_SEC, indicator_power_low_battery_get_time_until(&lb, POWER_LEVEL_LOW, now), 1);
+  EXPECT_NEAR(15*60*G_USEC_PER_SEC, indicator_power_low_battery_get_time_until(&lb, POWER_LEVEL_CRITICAL, now), 1);
+
+  // the rate is smoothed rather than jumping to the latest sample
+  indicator_power_low_battery_sample(&lb, 15.0, true, now);
+  EXPECT_GT(lb.rate, 1.0/60.0);
+  EXPECT_LT(lb.rate, 3.0/60.0);
+
+  // plugging in forgets it
+  indicator_power_low_battery_sample(&lb, 15.0, false, now);
+  EXPECT_EQ(-1, indicator_power_low_battery_get_time_until(&lb, POWER_LEVEL_LOW, now));
+}
+
+TEST_F(LowBatteryFixture, IsRelevant)
+{
+  update(50.0);
+
+  // ticking down between thresholds can't change anything...
+  EXPECT_FALSE(indicator_power_low_battery_is_relevant(&lb, 49.0, true));
+  EXPECT_FALSE(indicator_power_low_battery_is_relevant(&lb, 10.1, true));
+
+  // ...but crossing one or changing state can
+  EXPECT_TRUE(indicator_power_low_battery_is_relevant(&lb, 10.0, true));
+  EXPECT_TRUE(indicator_power_low_battery_is_relevant(&lb, 49.0, false));
+}
+
+TEST_F(LowBatteryFixture, ForecastDoesNotHoldTheLevel)
+{
+  update(12.0);
+
+  // the forecast says we've crossed 10%...
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, indicator_power_low_battery_update_from_forecast(&lb, 10.0, indicator_power_clock_get_monotonic_time(clock)));
+  EXPECT_EQ(POWER_LEVEL_LOW, lb.level);
+
+  // ...but the discharge slowed, and the battery says it hasn't.
+  // The hysteresis band mustn't keep us at a level we never reached
+  EXPECT_TRUE(indicator_power_low_battery_is_relevant(&lb, 10.5, true));
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(10.5));
+  EXPECT_EQ(POWER_LEVEL_OK, lb.level);
+
+  // once the battery confirms a forecast, hysteresis applies as usual
+  advance_clock(std::chrono::seconds(300));
+  indicator_power_low_battery_update_from_forecast(&lb, 10.0, indicator_power_clock_get_monotonic_time(clock));
+  EXPECT_TRUE(indicator_power_low_battery_is_relevant(&lb, 9.9, true));
+  update(9.9);
+  EXPECT_FALSE(indicator_power_low_battery_is_relevant(&lb, 10.5, true));
+  EXPECT_EQ(POWER_LEVEL_LOW, lb.level);
+}
+
+TEST_F(LowBatteryFixture, ClearedForecastDoesNotDelayRenotify)
+{
+  update(12.0);
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, indicator_power_low_battery_update_from_forecast(&lb, 10.0, indicator_power_clock_get_monotonic_time(clock)));
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(10.5));
+
+  // the forecast's warning was taken back, so the real one isn't held up
+  advance_clock(std::chrono::seconds(10));
+  EXPECT_EQ(LOW_BATTERY_ACTION_SHOW, update(10.0));
+
+  // but a real warning that's cleared still counts
+  EXPECT_EQ(LOW_BATTERY_ACTION_CLEAR, update(10.0, false));
+  EXPECT_EQ(LOW_BATTERY_ACTION_NONE, update(10.0));
+}
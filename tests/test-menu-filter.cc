@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "menu-filter.h"
+
+#include <gtest/gtest.h>
+
+class MenuFilterFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GMenu * base = nullptr;
+  GMenuModel * filter = nullptr;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    base = g_menu_new();
+    auto item = g_menu_item_new("Battery", nullptr);
+    g_menu_item_set_action_and_target(item, "indicator.activate-statistics", "s", "/battery");
+    g_menu_append_item(base, item);
+    g_object_unref(item);
+
+    const gchar * hidden[] = { G_MENU_ATTRIBUTE_ACTION, G_MENU_ATTRIBUTE_TARGET, nullptr };
+    filter = indicator_power_menu_filter_new(G_MENU_MODEL(base), hidden);
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&filter);
+    g_clear_object(&base);
+
+    super::TearDown();
+  }
+
+  bool has_attribute(GMenuModel * model, int i, const char * name)
+  {
+    auto value = g_menu_model_get_item_attribute_value(model, i, name, nullptr);
+    const bool found = value != nullptr;
+    g_clear_pointer(&value, g_variant_unref);
+    return found;
+  }
+};
+
+TEST_F(MenuFilterFixture, HidesAttributes)
+{
+  ASSERT_EQ(1, g_menu_model_get_n_items(filter));
+  EXPECT_TRUE(has_attribute(filter, 0, G_MENU_ATTRIBUTE_LABEL));
+  EXPECT_FALSE(has_attribute(filter, 0, G_MENU_ATTRIBUTE_ACTION));
+  EXPECT_FALSE(has_attribute(filter, 0, G_MENU_ATTRIBUTE_TARGET));
+
+  // the base model is untouched
+  EXPECT_TRUE(has_attribute(G_MENU_MODEL(base), 0, G_MENU_ATTRIBUTE_ACTION));
+}
+
+TEST_F(MenuFilterFixture, FollowsBase)
+{
+  int changes = 0;
+  auto on_changed = +[](GMenuModel*, gint, gint, gint, gpointer gchanges) {
+    ++*static_cast<int*>(gchanges);
+  };
+  g_signal_connect(filter, "items-changed", G_CALLBACK(on_changed), &changes);
+
+  // changes to the base show through
+  g_menu_append(base, "Mouse", nullptr);
+  EXPECT_EQ(1, changes);
+  EXPECT_EQ(2, g_menu_model_get_n_items(filter));
+
+  // swapping the base is one change
+  auto other = g_menu_new();
+  indicator_power_menu_filter_set_base(INDICATOR_POWER_MENU_FILTER(filter), G_MENU_MODEL(other));
+  EXPECT_EQ(2, changes);
+  EXPECT_EQ(0, g_menu_model_get_n_items(filter));
+
+  // and the old base is no longer followed
+  g_menu_append(base, "Keyboard", nullptr);
+  EXPECT_EQ(2, changes);
+
+  indicator_power_menu_filter_set_base(INDICATOR_POWER_MENU_FILTER(filter), nullptr);
+  g_object_unref(other);
+}
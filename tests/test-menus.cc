@@ -0,0 +1,258 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-powerd.h"
+#include "dbus-shared.h"
+#include "device-provider-mock.h"
+#include "metrics.h"
+#include "notifier.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <string>
+#include <vector>
+
+/***
+****  The service only builds a profile's menu sections
+****  while a client has that profile's menu open.
+***/
+
+class MenusFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* client {};
+  IndicatorPowerDevice* battery {};
+  IndicatorPowerDeviceProvider* provider {};
+  IndicatorPowerNotifier* notifier {};
+  IndicatorPowerService* service {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // point the session and system buses at the same private bus
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    client = g_dbus_connection_new_for_address_sync(address,
+                                                    GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                    nullptr, nullptr, nullptr);
+    ASSERT_NE(nullptr, client);
+    g_dbus_connection_set_exit_on_close(client, false);
+
+    battery = indicator_power_device_new("/some/path", UP_DEVICE_KIND_BATTERY, 50.0, UP_DEVICE_STATE_DISCHARGING, 3600, TRUE);
+    provider = indicator_power_device_provider_mock_new();
+    indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), battery);
+    notifier = indicator_power_notifier_new();
+    service = indicator_power_service_new(provider, notifier);
+    ASSERT_TRUE(wait_for_name_owned(client, BUS_NAME));
+
+    indicator_power_metrics_reset();
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&service);
+    g_clear_object(&notifier);
+    g_clear_object(&provider);
+    g_clear_object(&battery);
+    g_clear_object(&client);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  GVariant* call_menus(GDBusConnection* connection, const char* profile, const char* method, std::vector<guint32> groups)
+  {
+    struct Data {
+      GVariant* reply = nullptr;
+      bool done = false;
+    } data;
+
+    const auto path = std::string(BUS_PATH) + "/" + profile;
+    auto args = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, groups.data(), groups.size(), sizeof(guint32));
+    g_dbus_connection_call(connection, BUS_NAME, path.c_str(), "org.gtk.Menus", method,
+                           g_variant_new_tuple(&args, 1), nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr,
+                           [](GObject* o, GAsyncResult* res, gpointer gdata){
+                             auto d = static_cast<Data*>(gdata);
+                             d->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(o), res, nullptr);
+                             d->done = true;
+                           }, &data);
+    EXPECT_TRUE(wait_for([&data](){return data.done;}));
+    return data.reply;
+  }
+
+  // how many items are in the given group/menu of a Start() reply
+  static int count_items(GVariant* reply, guint32 want_group, guint32 want_menu)
+  {
+    int n = -1;
+    guint32 group, menu;
+    GVariantIter* items {};
+    GVariantIter* iter {};
+
+    g_variant_get(reply, "(a(uuaa{sv}))", &iter);
+    while (g_variant_iter_loop(iter, "(uuaa{sv})", &group, &menu, &items))
+      if ((group == want_group) && (menu == want_menu))
+        n = int(g_variant_iter_n_children(items));
+    g_variant_iter_free(iter);
+
+    return n;
+  }
+
+  // change the battery and wait for the service to process it
+  void tick()
+  {
+    const auto before = indicator_power_metrics_get(METRIC_REBUILDS_HEADER);
+    g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, indicator_power_device_get_percentage(battery) - 1.0, nullptr);
+    EXPECT_TRUE(wait_for([before](){return indicator_power_metrics_get(METRIC_REBUILDS_HEADER) > before;}));
+  }
+};
+
+TEST_F(MenusFixture, NotBuiltUntilSubscribed)
+{
+  // nobody's looking, so only the header gets rebuilt
+  tick();
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  // subscribing builds the desktop menu's devices and settings sections
+  auto reply = call_menus(client, "desktop", "Start", {0, 1});
+  ASSERT_NE(nullptr, reply);
+  EXPECT_EQ(2, count_items(reply, 1, 0));
+  g_variant_unref(reply);
+
+  tick();
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  // closing it leaves it cold
+  reply = call_menus(client, "desktop", "End", {0, 1});
+  g_clear_pointer(&reply, g_variant_unref);
+  wait_msec();
+  tick();
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+}
+
+TEST_F(MenusFixture, SubscriberVanishes)
+{
+  auto other = g_dbus_connection_new_for_address_sync(g_test_dbus_get_bus_address(test_dbus),
+                                                      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                      nullptr, nullptr, nullptr);
+  ASSERT_NE(nullptr, other);
+  g_dbus_connection_set_exit_on_close(other, false);
+
+  auto reply = call_menus(other, "desktop_greeter", "Start", {0, 1});
+  g_clear_pointer(&reply, g_variant_unref);
+  tick();
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  // a client that exits without calling End() stops counting too
+  g_dbus_connection_close_sync(other, nullptr, nullptr);
+  g_object_unref(other);
+  wait_msec(200);
+  tick();
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+}
+
+TEST_F(MenusFixture, HeaderIsNotOpen)
+{
+  // panels subscribe to group 0 for as long as they show the header
+  auto reply = call_menus(client, "desktop", "Start", {0});
+  ASSERT_NE(nullptr, reply);
+  g_variant_unref(reply);
+
+  tick();
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_REBUILDS_SETTINGS));
+}
+
+TEST_F(MenusFixture, ColdSectionsCatchUpOnce)
+{
+  auto reply = call_menus(client, "desktop", "Start", {0, 1});
+  g_clear_pointer(&reply, g_variant_unref);
+  reply = call_menus(client, "desktop", "End", {1});
+  g_clear_pointer(&reply, g_variant_unref);
+  wait_msec();
+
+  // changes while it's closed are only noted...
+  for (int i=0; i<3; ++i)
+    tick();
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  // ...and caught up in one pass when it's reopened
+  reply = call_menus(client, "desktop", "Start", {1});
+  ASSERT_NE(nullptr, reply);
+  EXPECT_EQ(2, count_items(reply, 1, 0));
+  g_variant_unref(reply);
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_REBUILDS_SETTINGS));
+}
+
+TEST_F(MenusFixture, DisplayOffDefersWork)
+{
+  // a stand-in for powerd
+  auto powerd = dbus_powerd_skeleton_new();
+  g_signal_connect(powerd, "handle-get-brightness-params",
+                   G_CALLBACK(+[](DbusPowerd* o, GDBusMethodInvocation* inv, gpointer) {
+                     dbus_powerd_complete_get_brightness_params(o, inv, g_variant_new("(iiiib)", 5, 10, 200, 100, FALSE));
+                     return TRUE;
+                   }), nullptr);
+  ASSERT_TRUE(g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(powerd), client, "/com/canonical/powerd", nullptr));
+  const auto own_id = g_bus_own_name_on_connection(client, "com.canonical.powerd", G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                   nullptr, nullptr, nullptr, nullptr);
+  ASSERT_TRUE(wait_for_name_owned(client, "com.canonical.powerd"));
+  wait_msec();
+
+  auto reply = call_menus(client, "desktop", "Start", {0, 1});
+  g_clear_pointer(&reply, g_variant_unref);
+
+  // while the display's off, battery changes don't touch the header or menus...
+  dbus_powerd_emit_sys_power_state_change(powerd, 0);
+  wait_msec();
+  const auto header_before = indicator_power_metrics_get(METRIC_REBUILDS_HEADER);
+  const auto devices_before = indicator_power_metrics_get(METRIC_REBUILDS_DEVICES);
+  for (int i=0; i<3; ++i)
+    {
+      g_object_set(battery, INDICATOR_POWER_DEVICE_PERCENTAGE, 20.0 - i, nullptr);
+      wait_msec();
+    }
+  EXPECT_EQ(header_before, indicator_power_metrics_get(METRIC_REBUILDS_HEADER));
+  EXPECT_EQ(devices_before, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  // turning it back on catches up in one pass
+  dbus_powerd_emit_sys_power_state_change(powerd, 1);
+  EXPECT_TRUE(wait_for([header_before](){return indicator_power_metrics_get(METRIC_REBUILDS_HEADER) > header_before;}));
+  wait_msec();
+  EXPECT_EQ(header_before+1, indicator_power_metrics_get(METRIC_REBUILDS_HEADER));
+  EXPECT_EQ(devices_before+1, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+
+  g_bus_unown_name(own_id);
+  g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(powerd));
+  g_object_unref(powerd);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+class MetricsFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* bus {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    indicator_power_metrics_reset();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    bus = g_dbus_connection_new_for_address_sync(g_test_dbus_get_bus_address(test_dbus),
+                                                 GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|
+                                                                      G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                 nullptr, nullptr, nullptr);
+    ASSERT_NE(nullptr, bus);
+    g_dbus_connection_set_exit_on_close(bus, false);
+  }
+
+  void TearDown() override
+  {
+    indicator_power_metrics_set_bus(nullptr);
+    g_dbus_connection_close_sync(bus, nullptr, nullptr);
+    g_clear_object(&bus);
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  GVariant* call(const char* method)
+  {
+    GVariant* ret {};
+    auto on_response = [](GObject* o, GAsyncResult* res, gpointer gret){
+      *static_cast<GVariant**>(gret) = g_dbus_connection_call_finish(G_DBUS_CONNECTION(o), res, nullptr);
+    };
+    g_dbus_connection_call(bus,
+                           g_dbus_connection_get_unique_name(bus),
+                           BUS_PATH"/Metrics",
+                           "com.canonical.indicator.power.Metrics",
+                           method,
+                           nullptr,
+                           nullptr,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           nullptr,
+                           on_response,
+                           &ret);
+    EXPECT_TRUE(wait_for([&ret](){return ret != nullptr;}));
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(MetricsFixture, Counters)
+{
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_GET_ALL_CALLS));
+  indicator_power_metrics_inc(METRIC_GET_ALL_CALLS);
+  indicator_power_metrics_inc(METRIC_GET_ALL_CALLS);
+  EXPECT_EQ(2u, indicator_power_metrics_get(METRIC_GET_ALL_CALLS));
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_DEVICES_CHANGED));
+
+  indicator_power_metrics_reset();
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_GET_ALL_CALLS));
+}
+
+TEST_F(MetricsFixture, ExportedOverDBus)
+{
+  indicator_power_metrics_set_bus(bus);
+
+  indicator_power_metrics_inc(METRIC_PROVIDER_SIGNALS);
+  indicator_power_metrics_record_handler("on_foo", 10);   // bucket 0
+  indicator_power_metrics_record_handler("on_foo", 100);  // bucket 3
+  indicator_power_metrics_record_handler("on_foo", G_USEC_PER_SEC*60); // the last bucket
+
+  // counters
+  auto ret = call("GetCounters");
+  ASSERT_NE(nullptr, ret);
+  auto dict = g_variant_get_child_value(ret, 0);
+  guint64 n {};
+  EXPECT_TRUE(g_variant_lookup(dict, "provider-signals", "t", &n));
+  EXPECT_EQ(1u, n);
+  EXPECT_TRUE(g_variant_lookup(dict, "notifications-shown", "t", &n));
+  EXPECT_EQ(0u, n);
+  g_variant_unref(dict);
+  g_variant_unref(ret);
+
+  // histograms
+  ret = call("GetHistograms");
+  ASSERT_NE(nullptr, ret);
+  dict = g_variant_get_child_value(ret, 0);
+  auto h = g_variant_lookup_value(dict, "on_foo", G_VARIANT_TYPE("(tttat)"));
+  ASSERT_NE(nullptr, h);
+  guint64 calls {}, total {}, max {};
+  GVariant* buckets {};
+  g_variant_get(h, "(ttt@at)", &calls, &total, &max, &buckets);
+  EXPECT_EQ(3u, calls);
+  EXPECT_EQ(110u + G_USEC_PER_SEC*60, total);
+  EXPECT_EQ(guint64(G_USEC_PER_SEC*60), max);
+  gsize n_buckets {};
+  auto b = static_cast<const guint64*>(g_variant_get_fixed_array(buckets, &n_buckets, sizeof(guint64)));
+  ASSERT_EQ(gsize(METRICS_N_BUCKETS), n_buckets);
+  EXPECT_EQ(1u, b[0]);
+  EXPECT_EQ(1u, b[3]);
+  EXPECT_EQ(1u, b[METRICS_N_BUCKETS-1]);
+  g_variant_unref(buckets);
+  g_variant_unref(h);
+  g_variant_unref(dict);
+  g_variant_unref(ret);
+
+  // reset
+  ret = call("Reset");
+  ASSERT_NE(nullptr, ret);
+  g_variant_unref(ret);
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_PROVIDER_SIGNALS));
+  EXPECT_EQ(0u, indicator_power_metrics_get_handler_calls("on_foo"));
+}
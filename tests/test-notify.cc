@@ -28,8 +28,6 @@
 
 #include <libdbustest/dbus-test.h>
 
-#include <libnotify/notify.h>
-
 #include <glib.h>
 #include <gio/gio.h>
 
@@ -132,14 +130,10 @@ protected:
     bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
     g_dbus_connection_set_exit_on_close(bus, FALSE);
     g_object_add_weak_pointer(G_OBJECT(bus), reinterpret_cast<gpointer*>(&bus));
-
-    notify_init(SERVICE_EXEC);
   }
 
   virtual void TearDown()
   {
-    notify_uninit();
-
     g_clear_object(&mock);
     g_clear_object(&service);
     g_object_unref(bus);
@@ -162,15 +156,20 @@ protected:
   ****
   ***/
 
-  int get_notify_call_count() const
+  int get_method_call_count(const char* method) const
   {
     guint len {0u};
     GError* error {nullptr};
-    dbus_test_dbus_mock_object_get_method_calls(mock, obj, METHOD_NOTIFY, &len, &error);
+    dbus_test_dbus_mock_object_get_method_calls(mock, obj, method, &len, &error);
     g_assert_no_error(error);
     return len;
   }
 
+  int get_notify_call_count() const
+  {
+    return get_method_call_count(METHOD_NOTIFY);
+  }
+
   std::string get_notify_call_sound_file(int call_number)
   {
     std::string ret;
@@ -195,6 +194,21 @@ protected:
     return ret;
   }
 
+  // GetCapabilities isn't registered in SetUp() because
+  // some tests need the server to support actions and some don't
+  void add_get_caps_method(const char* ret)
+  {
+    GError* error {nullptr};
+    auto str = g_strdup_printf("ret = %s", ret);
+    dbus_test_dbus_mock_object_add_method(mock, obj, METHOD_GET_CAPS,
+                                          nullptr,
+                                          G_VARIANT_TYPE_STRING_ARRAY,
+                                          str,
+                                          &error);
+    g_assert_no_error(error);
+    g_free(str);
+  }
+
   void clear_method_calls()
   {
     GError* error{nullptr};
@@ -373,15 +387,7 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
 {
   // GetCapabilities returns an array containing 'actions', so that we'll
   // get snap decisions and the 'IsWarning' property
-  GError * error = nullptr;
-  dbus_test_dbus_mock_object_add_method (mock,
-                                         obj,
-                                         METHOD_GET_CAPS,
-                                         nullptr,
-                                         G_VARIANT_TYPE_STRING_ARRAY,
-                                         "ret = ['actions', 'body']",
-                                         &error);
-  g_assert_no_error (error);
+  add_get_caps_method ("['actions', 'body']");
 
   auto battery = indicator_power_device_new ("/object/path",
                                              UP_DEVICE_KIND_BATTERY,
@@ -422,7 +428,7 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   // b) we get a notification
   changed_params = ChangedParams();
   set_battery_percentage (battery, percent_low);
-  wait_msec();
+  EXPECT_TRUE (wait_for([&changed_params](){return changed_params.is_warning;}));
   EXPECT_EQ (FIELD_POWER_LEVEL|FIELD_IS_WARNING, changed_params.fields);
   EXPECT_EQ (indicator_power_notifier_get_power_level(battery), changed_params.power_level);
   EXPECT_TRUE (changed_params.is_warning);
@@ -433,6 +439,7 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   // now test that the warning changes if the level goes down even lower...
   changed_params = ChangedParams();
   set_battery_percentage (battery, percent_very_low);
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 1;}));
   wait_msec();
   EXPECT_EQ (FIELD_POWER_LEVEL, changed_params.fields);
   EXPECT_STREQ (POWER_LEVEL_STR_VERY_LOW, changed_params.power_level.c_str());
@@ -448,10 +455,20 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   EXPECT_FALSE (changed_params.is_warning);
   EXPECT_EQ (0, get_notify_call_count());
 
-  // ...and that it comes back if we unplug again...
+  // ...that it doesn't come right back if the AC adapter flaps...
   changed_params = ChangedParams();
   g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING, nullptr);
   wait_msec();
+  EXPECT_EQ (0, changed_params.fields);
+  EXPECT_EQ (0, get_notify_call_count());
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  wait_msec();
+
+  // ...but that it does come back if we unplug again later...
+  advance_clock(std::chrono::seconds(300));
+  changed_params = ChangedParams();
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING, nullptr);
+  EXPECT_TRUE (wait_for([&changed_params](){return changed_params.is_warning;}));
   EXPECT_EQ (FIELD_IS_WARNING, changed_params.fields);
   EXPECT_TRUE (changed_params.is_warning);
   EXPECT_EQ (1, get_notify_call_count());
@@ -472,3 +489,164 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   g_object_unref (notifier);
   g_object_unref (battery);
 }
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, BurstsAreCoalesced)
+{
+  add_get_caps_method ("['body']");
+
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             percent_low + 1.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  wait_msec();
+
+  // let it connect to the notification server first; until then,
+  // the whole burst would wait for the capabilities and become one Notify
+  advance_clock(std::chrono::seconds(60));
+  EXPECT_TRUE (wait_for([this](){return get_method_call_count(METHOD_GET_CAPS) == 1;}));
+  wait_msec();
+
+  // a burst of changes without returning to the main loop:
+  // the first one's Notify is in flight, and the rest get folded together
+  set_battery_percentage (battery, percent_low);
+  set_battery_percentage (battery, percent_very_low);
+  set_battery_percentage (battery, percent_critical);
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 2;}));
+  wait_msec();
+  EXPECT_EQ (2, get_notify_call_count());
+  clear_method_calls();
+
+  // show-then-clear in a burst shouldn't leave anything up
+  advance_clock(std::chrono::seconds(300));
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING, nullptr);
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  wait_msec(200);
+  EXPECT_EQ (0, get_notify_call_count());
+
+  // cleanup
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, ForecastWarnsOnTime)
+{
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             20.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  wait_msec();
+
+  // discharge at one percent per minute
+  for (int i=0; i<2; ++i)
+    {
+      advance_clock(std::chrono::seconds(60));
+      set_battery_percentage (battery, 19.0-i);
+    }
+  EXPECT_EQ (0, get_notify_call_count());
+
+  // the battery hasn't reported crossing 10% yet,
+  // but the forecast says it has, so warn now
+  advance_clock(std::chrono::seconds(8*60 + 1));
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 1;}));
+
+  // cleanup
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+TEST_F(NotifyFixture, ForecastIsCorrectedBySamples)
+{
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             20.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  wait_msec();
+
+  // discharge at one percent per minute, and let the forecast warn
+  for (int i=0; i<2; ++i)
+    {
+      advance_clock(std::chrono::seconds(60));
+      set_battery_percentage (battery, 19.0-i);
+    }
+  advance_clock(std::chrono::seconds(8*60 + 1));
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 1;}));
+  wait_msec();
+
+  // the discharge slowed down, and the battery never got to 10%,
+  // so the warning shouldn't be held up by the hysteresis band
+  set_battery_percentage (battery, percent_low + 0.5);
+  EXPECT_TRUE (wait_for([this](){return get_method_call_count(METHOD_CLOSE) == 1;}));
+
+  // the warning that was closed doesn't count against renotifying,
+  // so when the battery really gets there, it's shown again right away
+  advance_clock(std::chrono::seconds(10));
+  set_battery_percentage (battery, percent_low);
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 2;}));
+
+  // cleanup
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, WarmsUpLazily)
+{
+  add_get_caps_method ("['body']");
+
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             50.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  // a healthy battery shouldn't make us talk to the notification server
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  wait_msec();
+  EXPECT_EQ (0, get_method_call_count(METHOD_GET_CAPS));
+
+  // ...until startup's well over
+  advance_clock(std::chrono::seconds(60));
+  EXPECT_TRUE (wait_for([this](){return get_method_call_count(METHOD_GET_CAPS) == 1;}));
+
+  // and a low battery shouldn't make us do it twice
+  set_battery_percentage (battery, percent_low);
+  EXPECT_TRUE (wait_for([this](){return get_notify_call_count() == 1;}));
+  EXPECT_EQ (1, get_method_call_count(METHOD_GET_CAPS));
+
+  // cleanup
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "recorder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+class RecorderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    indicator_power_recorder_clear();
+  }
+
+  static std::vector<IndicatorPowerRecord> dump()
+  {
+    auto bytes = indicator_power_recorder_dump();
+    gsize len {};
+    auto data = static_cast<const guint8*>(g_bytes_get_data(bytes, &len));
+
+    IndicatorPowerRecorderHeader header;
+    EXPECT_LE(sizeof(header), len);
+    memcpy(&header, data, sizeof(header));
+    EXPECT_EQ(RECORDER_MAGIC, header.magic);
+    EXPECT_EQ(RECORDER_VERSION, header.version);
+    EXPECT_EQ(sizeof(header) + header.n_records*sizeof(IndicatorPowerRecord), len);
+
+    std::vector<IndicatorPowerRecord> records(header.n_records);
+    memcpy(records.data(), data+sizeof(header), header.n_records*sizeof(IndicatorPowerRecord));
+    g_bytes_unref(bytes);
+    return records;
+  }
+};
+
+TEST_F(RecorderFixture, Empty)
+{
+  EXPECT_TRUE(dump().empty());
+}
+
+TEST_F(RecorderFixture, OldestFirst)
+{
+  indicator_power_recorder_record(RECORD_GET_ALL_SENT, 1);
+  indicator_power_recorder_record(RECORD_GET_ALL_RECEIVED, 1);
+  indicator_power_recorder_record(RECORD_REBUILD, 3);
+
+  const auto records = dump();
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ(guint32(RECORD_GET_ALL_SENT), records[0].event);
+  EXPECT_EQ(guint32(RECORD_GET_ALL_RECEIVED), records[1].event);
+  EXPECT_EQ(guint32(RECORD_REBUILD), records[2].event);
+  EXPECT_EQ(3u, records[2].arg);
+  EXPECT_LE(records[0].usec, records[1].usec);
+  EXPECT_LE(records[1].usec, records[2].usec);
+  EXPECT_STREQ("rebuild", indicator_power_recorder_event_name(records[2].event));
+}
+
+TEST_F(RecorderFixture, Wraps)
+{
+  const guint32 n = RECORDER_N_RECORDS + 10;
+  for (guint32 i=0; i<n; ++i)
+    indicator_power_recorder_record(RECORD_BRIGHTNESS_REQUEST, i);
+
+  // only the newest N survive
+  const auto records = dump();
+  ASSERT_EQ(RECORDER_N_RECORDS, records.size());
+  EXPECT_EQ(n-RECORDER_N_RECORDS, records.front().arg);
+  EXPECT_EQ(n-1, records.back().arg);
+}
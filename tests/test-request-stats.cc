@@ -0,0 +1,147 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "request-stats.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+class RequestStatsFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  struct Request
+  {
+    const char* owner;
+    const char* name;
+    guint64 active_usec;
+    guint64 active_since;
+  };
+
+  IndicatorPowerRequestStats* stats {};
+  int changes {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    stats = indicator_power_request_stats_new();
+    changes = 0;
+    auto on_changed = +[](IndicatorPowerRequestStats*, gpointer gchanges) {
+      ++*static_cast<int*>(gchanges);
+    };
+    g_signal_connect(stats, INDICATOR_POWER_REQUEST_STATS_SIGNAL_CHANGED, G_CALLBACK(on_changed), &changes);
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&stats);
+
+    super::TearDown();
+  }
+
+  void add_sample(const std::vector<Request>& requests, gint64 now)
+  {
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE("a(ssuttt)"));
+    for (const auto& r : requests)
+      g_variant_builder_add(&b, "(ssuttt)", r.owner, r.name, 1u, r.active_usec, r.active_usec, r.active_since);
+    auto v = g_variant_ref_sink(g_variant_builder_end(&b));
+    indicator_power_request_stats_add_sample(stats, v, now);
+    g_variant_unref(v);
+  }
+
+  // "name:seconds[*]" for each of the top holders, with * if it's active now
+  std::vector<std::string> top(guint max=5)
+  {
+    std::vector<std::string> ret;
+    auto holders = indicator_power_request_stats_get_top(stats, max);
+    for (guint i=0; i<holders->len; ++i)
+      {
+        auto h = static_cast<IndicatorPowerRequestHolder*>(g_ptr_array_index(holders, i));
+        ret.push_back(std::string(h->name) + ":" + std::to_string(h->active_usec / G_USEC_PER_SEC) + (h->active ? "*" : ""));
+      }
+    g_ptr_array_unref(holders);
+    return ret;
+  }
+
+  static constexpr guint64 SEC {G_USEC_PER_SEC};
+};
+
+TEST_F(RequestStatsFixture, LongestFirst)
+{
+  add_sample({{":1.1", "music", 30*SEC, 0},
+              {":1.2", "sync", 90*SEC, 0},
+              {":1.3", "idle", 0, 0},
+              {":1.4", "alarm", 10*SEC, 0}}, 1000*SEC);
+  EXPECT_EQ(1, changes);
+
+  // clients that never held anything aren't listed
+  EXPECT_EQ((std::vector<std::string>{"sync:90", "music:30", "alarm:10"}), top());
+  EXPECT_EQ((std::vector<std::string>{"sync:90", "music:30"}), top(2));
+}
+
+TEST_F(RequestStatsFixture, CountsHeldRequests)
+{
+  // powerd only adds the time when a request's released,
+  // so the time since active_since has to be added in
+  add_sample({{":1.1", "music", 30*SEC, 900*SEC}}, 1000*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:130*"}), top());
+
+  add_sample({{":1.1", "music", 30*SEC, 900*SEC}}, 1010*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:140*"}), top());
+
+  // released
+  add_sample({{":1.1", "music", 145*SEC, 0}}, 1020*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:145"}), top());
+  EXPECT_EQ(3, changes);
+}
+
+TEST_F(RequestStatsFixture, OnlyChangesSignal)
+{
+  const std::vector<Request> requests {{":1.1", "music", 30*SEC, 0}};
+
+  add_sample(requests, 1000*SEC);
+  EXPECT_EQ(1, changes);
+
+  // nothing's different, so nothing to rebuild
+  add_sample(requests, 1010*SEC);
+  add_sample(requests, 1020*SEC);
+  EXPECT_EQ(1, changes);
+}
+
+TEST_F(RequestStatsFixture, SurvivesRestarts)
+{
+  add_sample({{":1.1", "music", 30*SEC, 0}}, 1000*SEC);
+
+  // powerd restarted, so its totals started over
+  add_sample({{":1.1", "music", 5*SEC, 0}}, 1010*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:35"}), top());
+
+  // a client that's gone isn't holding anything now
+  add_sample({{":1.1", "music", 5*SEC, 1005*SEC}}, 1010*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:40*"}), top());
+  add_sample({}, 1020*SEC);
+  EXPECT_EQ((std::vector<std::string>{"music:40"}), top());
+}
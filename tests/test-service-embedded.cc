@@ -0,0 +1,197 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "device-provider-mock.h"
+#include "metrics.h"
+#include "notifier.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <functional>
+
+/***
+****  A service embedded in a host process, running on the host's
+****  GMainContext with its menus and actions used directly
+***/
+
+class EmbeddedFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  GTestDBus* test_dbus {};
+  GDBusConnection* client {};
+  GMainContext* context {};
+  IndicatorPowerDevice* battery {};
+  IndicatorPowerDeviceProvider* provider {};
+  IndicatorPowerNotifier* notifier {};
+  IndicatorPowerService* service {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // point the session and system buses at the same private bus
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    client = g_dbus_connection_new_for_address_sync(address,
+                                                    GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT|G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                                    nullptr, nullptr, nullptr);
+    ASSERT_NE(nullptr, client);
+    g_dbus_connection_set_exit_on_close(client, false);
+
+    context = g_main_context_new();
+    battery = indicator_power_device_new("/some/path", UP_DEVICE_KIND_BATTERY, 50.0, UP_DEVICE_STATE_DISCHARGING, 3600, TRUE);
+    provider = indicator_power_device_provider_mock_new();
+    indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), battery);
+    notifier = indicator_power_notifier_new();
+    service = indicator_power_service_new_embedded(provider, notifier, context);
+    iterate_until([](){return false;}, 50);
+
+    indicator_power_metrics_reset();
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&service);
+    iterate_until([](){return false;}, 50);
+    g_clear_object(&notifier);
+    g_clear_object(&provider);
+    g_clear_object(&battery);
+    g_clear_pointer(&context, g_main_context_unref);
+    g_clear_object(&client);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+
+  // run the host's context, as the host would, until test_function passes
+  bool iterate_until(std::function<bool()> test_function, guint timeout_msec=1000)
+  {
+    const auto deadline = g_get_monotonic_time() + gint64(timeout_msec) * G_TIME_SPAN_MILLISECOND;
+
+    g_main_context_push_thread_default(context);
+    while (!test_function() && (g_get_monotonic_time() < deadline))
+      if (!g_main_context_iteration(context, false))
+        g_usleep(G_TIME_SPAN_MILLISECOND);
+    g_main_context_pop_thread_default(context);
+
+    return test_function();
+  }
+
+  static GMenuModel* get_submenu(GMenuModel* menu)
+  {
+    return g_menu_model_get_item_link(menu, 0, G_MENU_LINK_SUBMENU);
+  }
+};
+
+TEST_F(EmbeddedFixture, NotOnTheBus)
+{
+  EXPECT_NAME_NOT_OWNED_EVENTUALLY(client, BUS_NAME, 200);
+
+  GDBusConnection* bus {};
+  g_object_get(service, "bus", &bus, nullptr);
+  EXPECT_EQ(nullptr, bus);
+}
+
+TEST_F(EmbeddedFixture, MenuAndActions)
+{
+  auto actions = indicator_power_service_get_action_group(service);
+  ASSERT_NE(nullptr, actions);
+  EXPECT_TRUE(g_action_group_has_action(actions, "_header"));
+
+  auto menu = indicator_power_service_get_menu(service, "desktop");
+  ASSERT_NE(nullptr, menu);
+  EXPECT_EQ(1, g_menu_model_get_n_items(menu));
+
+  // the devices and settings sections are built right away...
+  auto submenu = get_submenu(menu);
+  ASSERT_NE(nullptr, submenu);
+  EXPECT_EQ(2, g_menu_model_get_n_items(submenu));
+  auto devices = g_menu_model_get_item_link(submenu, 0, G_MENU_LINK_SECTION);
+  EXPECT_EQ(1, g_menu_model_get_n_items(devices));
+  g_clear_object(&devices);
+
+  // ...and kept up to date, since there's no telling when the host shows them
+  auto other = indicator_power_device_new("/some/other/path", UP_DEVICE_KIND_MOUSE, 80.0, UP_DEVICE_STATE_DISCHARGING, 0, TRUE);
+  indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider), other);
+  indicator_power_device_provider_emit_devices_changed(provider);
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_REBUILDS_DEVICES));
+  devices = g_menu_model_get_item_link(submenu, 0, G_MENU_LINK_SECTION);
+  EXPECT_EQ(2, g_menu_model_get_n_items(devices));
+  g_clear_object(&devices);
+
+  g_object_unref(other);
+  g_object_unref(submenu);
+}
+
+TEST_F(EmbeddedFixture, RunsInTheHostContext)
+{
+  auto settings = g_settings_new("com.canonical.indicator.power");
+  const auto before = indicator_power_metrics_get(METRIC_REBUILDS_HEADER);
+  g_settings_set_boolean(settings, "show-percentage", !g_settings_get_boolean(settings, "show-percentage"));
+
+  // running the default context doesn't reach the service...
+  wait_msec();
+  EXPECT_EQ(before, indicator_power_metrics_get(METRIC_REBUILDS_HEADER));
+
+  // ...but running the host's does
+  EXPECT_TRUE(iterate_until([before](){return indicator_power_metrics_get(METRIC_REBUILDS_HEADER) > before;}));
+
+  g_object_unref(settings);
+}
+
+TEST_F(EmbeddedFixture, RequestStatsSectionToggles)
+{
+  auto settings = g_settings_new("com.canonical.indicator.power");
+  auto menu = indicator_power_service_get_menu(service, "phone");
+  ASSERT_NE(nullptr, menu);
+  auto submenu = get_submenu(menu);
+  ASSERT_NE(nullptr, submenu);
+  const auto n = g_menu_model_get_n_items(submenu);
+
+  // showing the stats adds their section at the end...
+  g_settings_set_boolean(settings, "show-request-stats", true);
+  EXPECT_TRUE(iterate_until([submenu, n](){return g_menu_model_get_n_items(submenu) == n+1;}));
+  gchar* label {};
+  EXPECT_TRUE(g_menu_model_get_item_attribute(submenu, n, G_MENU_ATTRIBUTE_LABEL, "s", &label));
+  EXPECT_STREQ("What's using power", label);
+  g_free(label);
+
+  // ...and hiding them takes only that section away
+  g_settings_set_boolean(settings, "show-request-stats", false);
+  EXPECT_TRUE(iterate_until([submenu, n](){return g_menu_model_get_n_items(submenu) == n;}));
+  wait_msec();
+  EXPECT_EQ(n, g_menu_model_get_n_items(submenu));
+
+  g_settings_reset(settings, "show-request-stats");
+  g_object_unref(submenu);
+  g_object_unref(settings);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "metrics.h"
+#include "watchdog.h"
+
+#include <gtest/gtest.h>
+
+class WatchdogFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr guint THRESHOLD_MSEC {50};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    indicator_power_metrics_reset();
+    indicator_power_watchdog_start(nullptr, THRESHOLD_MSEC);
+  }
+
+  void TearDown() override
+  {
+    indicator_power_watchdog_stop();
+
+    super::TearDown();
+  }
+
+  static void slow_inner(guint msec)
+  {
+    const auto begin = indicator_power_metrics_handler_begin();
+    g_usleep(msec*1000);
+    indicator_power_metrics_handler_end("slow_inner", begin);
+  }
+
+  static gboolean slow_outer(gpointer gmsec)
+  {
+    const auto begin = indicator_power_metrics_handler_begin();
+    slow_inner(GPOINTER_TO_UINT(gmsec));
+    indicator_power_metrics_handler_end("slow_outer", begin);
+    return G_SOURCE_REMOVE;
+  }
+};
+
+TEST_F(WatchdogFixture, FastIterationsAreIgnored)
+{
+  g_idle_add(slow_outer, GUINT_TO_POINTER(1));
+  wait_msec(100);
+
+  EXPECT_EQ(0u, indicator_power_metrics_get(METRIC_MAIN_LOOP_STALLS));
+}
+
+TEST_F(WatchdogFixture, StallIsBlamedOnInnermostSlowHandler)
+{
+  g_idle_add(slow_outer, GUINT_TO_POINTER(THRESHOLD_MSEC*2));
+  wait_msec(100);
+
+  EXPECT_EQ(1u, indicator_power_metrics_get(METRIC_MAIN_LOOP_STALLS));
+  EXPECT_EQ(1u, indicator_power_metrics_get_stalls("slow_inner"));
+  EXPECT_EQ(0u, indicator_power_metrics_get_stalls("slow_outer"));
+}
+
+TEST_F(WatchdogFixture, UntimedStallIsUnattributed)
+{
+  g_idle_add([](gpointer) -> gboolean {
+    g_usleep(THRESHOLD_MSEC*2*1000);
+    return G_SOURCE_REMOVE;
+  }, nullptr);
+  wait_msec(100);
+
+  EXPECT_EQ(1u, indicator_power_metrics_get_stalls("(unattributed)"));
+}
+
+TEST_F(WatchdogFixture, BadThresholdsFallBackToTheDefault)
+{
+  EXPECT_EQ(250u, indicator_power_watchdog_parse_threshold("250"));
+
+  // bad values are warned about, so don't let the warning be fatal here
+  int n_warnings = 0;
+  const auto old_mask = g_log_set_fatal_mask(G_LOG_DOMAIN, G_LOG_LEVEL_ERROR);
+  const auto handler_id = g_log_set_handler(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                                            [](const gchar*, GLogLevelFlags, const gchar*, gpointer gcount){
+                                              ++*static_cast<int*>(gcount);
+                                            }, &n_warnings);
+
+  for (const auto str : { "", "0", "abc", "-5", "10ms", "99999999999" })
+    EXPECT_EQ(guint(INDICATOR_POWER_WATCHDOG_DEFAULT_MSEC), indicator_power_watchdog_parse_threshold(str)) << str;
+  EXPECT_EQ(6, n_warnings);
+
+  g_log_remove_handler(G_LOG_DOMAIN, handler_id);
+  g_log_set_fatal_mask(G_LOG_DOMAIN, old_mask);
+}